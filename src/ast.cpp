@@ -378,6 +378,10 @@ CharLiteral *CharLiteral::New(const Token *tok, int tag, unsigned val)
 /*
  * String Literal
  */
+std::atomic<size_t> StringLiteral::s_next_id(0);
+thread_local size_t StringLiteral::t_next_id = 0;
+thread_local size_t StringLiteral::t_end_id = 0;
+
 StringLiteral *StringLiteral::New(const std::string &val)
 {
   auto ret = new (stringPool.Alloc()) StringLiteral(val);
@@ -385,6 +389,14 @@ StringLiteral *StringLiteral::New(const std::string &val)
   return ret;
 }
 
+StringLiteral *StringLiteral::New(const std::string &val,
+                                  const std::string &label)
+{
+  auto ret = new (stringPool.Alloc()) StringLiteral(val, label);
+  ret->m_pool = &stringPool;
+  return ret;
+}
+
 StringLiteral *StringLiteral::New(const Token *tok)
 {
   auto ret = new (stringPool.Alloc()) StringLiteral(tok);
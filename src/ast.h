@@ -6,6 +6,7 @@
 #include "token.h"
 #include "type.h"
 
+#include <atomic>
 #include <cassert>
 #include <list>
 #include <memory>
@@ -775,6 +776,10 @@ protected:
         m_isconst = true;
         break;
       case DIV:
+        if (rhs->m_val == 0) {
+          m_isconst = false;  // left for the run time
+          break;
+        }
         m_val = lhs->m_val / rhs->m_val;
         m_isconst = true;
         break;
@@ -1003,6 +1008,8 @@ class StringLiteral : public ASTNode {
 public:
   static StringLiteral *New(const std::string &val);
   static StringLiteral *New(const Token *tok);
+  // a string named `label`, made up by the code generator
+  static StringLiteral *New(const std::string &val, const std::string &label);
   virtual ~StringLiteral() {}
   virtual void Accept(Visitor *v);
   virtual bool IsLVal()
@@ -1018,18 +1025,40 @@ public:
 
   const std::string Label() const
   {
+    if (!m_label.empty()) {
+      return m_label;
+    }
     return "strlabel_" + std::to_string(m_id);
   }
 
   std::string SValRepr() const;
 
-  size_t GenId()
+  /*
+   * Ids follow creation order. A thread parsing one function body is
+   * handed the ids its strings get in a sequential parse beforehand.
+   */
+  static size_t ReserveIds(size_t n)
+  {
+    return s_next_id.fetch_add(n);
+  }
+  static void SetIdRange(size_t begin, size_t end)
   {
-    static size_t id = 0;
-    return id++;
+    t_next_id = begin;
+    t_end_id = end;
+  }
+  static size_t GenId()
+  {
+    if (t_next_id < t_end_id) {
+      return t_next_id++;
+    }
+    return s_next_id++;
   }
 
 protected:
+  StringLiteral(const std::string &val, const std::string &label)
+    : m_sval(val), m_id(0), m_label(label)
+  {
+  }
   StringLiteral(const Token *tok) : m_sval(tok->m_value), m_id(GenId()) {}
   StringLiteral(const std::string &val) : m_sval(val), m_id(GenId()) {}
   StringLiteral(const Token *tok, SourceLocation loc)
@@ -1044,6 +1073,11 @@ protected:
   SourceLocation m_loc;
   std::string m_sval;
   size_t m_id;
+  std::string m_label;  // if not numbered by m_id
+
+  static std::atomic<size_t> s_next_id;
+  static thread_local size_t t_next_id;
+  static thread_local size_t t_end_id;
 };
 
 class IntegerLiteral : public Expr {
@@ -1307,6 +1341,10 @@ public:
   {
     m_name = name;
   }
+  Identifier *Ident() const
+  {
+    return m_name;
+  }
 
   enum Linkage Linkage()
   {
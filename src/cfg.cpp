@@ -0,0 +1,269 @@
+#include "cfg.h"
+#include "debug.h"
+
+#include <algorithm>
+
+static void link(BasicBlock *from, BasicBlock *to)
+{
+  auto &succs = from->m_succs;
+  if (std::find(succs.begin(), succs.end(), to) == succs.end()) {
+    succs.push_back(to);
+    to->m_preds.push_back(from);
+  }
+}
+
+FlowGraph::FlowGraph(FuncInfo *func) : m_func(func)
+{
+  m_exit = new BasicBlock();
+  m_exit->m_id = -1;
+  Split();
+  Link();
+  Order();
+  FindDominators();
+  FindLoops();
+}
+
+FlowGraph::~FlowGraph()
+{
+  for (auto loop : m_loops) {
+    delete loop;
+  }
+  for (auto bb : m_blocks) {
+    delete bb;
+  }
+  delete m_exit;
+}
+
+BasicBlock *FlowGraph::NewBlock()
+{
+  auto bb = new BasicBlock();
+  bb->m_id = m_blocks.size();
+  m_blocks.push_back(bb);
+  return bb;
+}
+
+/**
+ * @brief A block starts at the first quad, at every label and after every
+ *   branch, goto or return. The entry is left empty rather than start
+ *   with a label, so that no edge enters it.
+ */
+void FlowGraph::Split()
+{
+  BasicBlock *bb = NewBlock();
+  for (auto quad : m_func->m_quads) {
+    if (quad->m_op == QO_LABEL && (!bb->m_quads.empty() || bb == Entry())) {
+      bb = NewBlock();
+    }
+    if (quad->m_op == QO_LABEL) {
+      m_labels[JumpTarget(quad)] = bb;
+    }
+    bb->m_quads.push_back(quad);
+    if (IsCondBranch(quad->m_op) || IsJump(quad->m_op)) {
+      bb = NewBlock();
+    }
+  }
+  // the block opened after a trailing jump
+  if (bb->m_quads.empty() && m_blocks.size() > 1) {
+    m_blocks.pop_back();
+    delete bb;
+  }
+}
+
+void FlowGraph::Link()
+{
+  for (size_t i = 0; i < m_blocks.size(); ++i) {
+    auto bb = m_blocks[i];
+    auto next = i + 1 < m_blocks.size() ? m_blocks[i + 1] : m_exit;
+    auto term = bb->Terminator();
+    if (term) {
+      link(bb, Target(term));
+    }
+    if (!term || IsCondBranch(term->m_op)) {
+      link(bb, next);
+    }
+  }
+}
+
+BasicBlock *FlowGraph::Target(const Quadruple *quad) const
+{
+  if (quad->m_op == QO_RETURN) {
+    return m_exit;
+  }
+  auto it = m_labels.find(JumpTarget(quad));
+  assert(it != m_labels.end());
+  return it != m_labels.end() ? it->second : m_exit;
+}
+
+// reverse postorder of the blocks reachable from the entry
+void FlowGraph::Order()
+{
+  std::vector<BasicBlock *> post;
+  std::vector<std::pair<BasicBlock *, size_t>> stack;
+  std::vector<bool> seen(m_blocks.size() + 1);
+  auto visit = [&](BasicBlock *bb) {
+    seen[bb->m_id + 1] = true;
+    stack.emplace_back(bb, 0);
+  };
+
+  visit(Entry());
+  while (!stack.empty()) {
+    auto &top = stack.back();
+    if (top.second < top.first->m_succs.size()) {
+      auto succ = top.first->m_succs[top.second++];
+      if (!seen[succ->m_id + 1]) {
+        visit(succ);
+      }
+    }
+    else {
+      post.push_back(top.first);
+      stack.pop_back();
+    }
+  }
+  m_rpo.assign(post.rbegin(), post.rend());
+  for (size_t i = 0; i < m_rpo.size(); ++i) {
+    m_rpo[i]->m_rpo = i;
+  }
+}
+
+/**
+ * @brief Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm":
+ *   iterate over the reverse postorder, meeting the dominators of the
+ *   processed predecessors, until nothing changes.
+ */
+void FlowGraph::FindDominators()
+{
+  auto intersect = [](BasicBlock *a, BasicBlock *b) {
+    while (a != b) {
+      while (a->m_rpo > b->m_rpo) {
+        a = a->m_idom;
+      }
+      while (b->m_rpo > a->m_rpo) {
+        b = b->m_idom;
+      }
+    }
+    return a;
+  };
+
+  Entry()->m_idom = Entry();
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = 1; i < m_rpo.size(); ++i) {
+      auto bb = m_rpo[i];
+      BasicBlock *idom = nullptr;
+      for (auto pred : bb->m_preds) {
+        if (!pred->m_idom) {
+          continue;
+        }
+        idom = idom ? intersect(pred, idom) : pred;
+      }
+      if (bb->m_idom != idom) {
+        bb->m_idom = idom;
+        changed = true;
+      }
+    }
+  }
+  for (auto bb : m_blocks) {
+    if (bb->IsReachable() && bb != Entry()) {
+      bb->m_idom->m_children.push_back(bb);
+    }
+  }
+}
+
+bool FlowGraph::Dominates(const BasicBlock *a, const BasicBlock *b) const
+{
+  if (!a->IsReachable() || !b->IsReachable()) {
+    return false;
+  }
+  while (b != a && b != Entry()) {
+    b = b->m_idom;
+  }
+  return b == a;
+}
+
+/**
+ * @brief An edge to a dominator is a back edge. The loop of a header is
+ *   found walking the predecessors back from its back edges, and loops
+ *   are nested by size: a loop inside another is a smaller one.
+ */
+void FlowGraph::FindLoops()
+{
+  std::map<int, std::vector<bool>> bodies;  // by header, in block order
+  for (auto bb : m_rpo) {
+    for (auto head : bb->m_succs) {
+      if (!Dominates(head, bb)) {
+        continue;
+      }
+      auto &body = bodies[head->m_id];
+      body.resize(m_blocks.size());
+      body[head->m_id] = true;
+      std::vector<BasicBlock *> work{bb};
+      while (!work.empty()) {
+        auto cur = work.back();
+        work.pop_back();
+        if (body[cur->m_id]) {
+          continue;
+        }
+        body[cur->m_id] = true;
+        for (auto pred : cur->m_preds) {
+          if (pred->IsReachable()) {
+            work.push_back(pred);
+          }
+        }
+      }
+    }
+  }
+
+  for (auto &entry : bodies) {
+    auto loop = new Loop();
+    loop->m_header = m_blocks[entry.first];
+    loop->m_blocks.push_back(loop->m_header);
+    for (auto bb : m_blocks) {
+      if (entry.second[bb->m_id] && bb != loop->m_header) {
+        loop->m_blocks.push_back(bb);
+      }
+    }
+    m_loops.push_back(loop);
+  }
+  std::stable_sort(m_loops.begin(), m_loops.end(), [](Loop *a, Loop *b) {
+    return a->m_blocks.size() > b->m_blocks.size();
+  });
+  for (auto loop : m_loops) {
+    loop->m_parent = loop->m_header->m_loop;
+    loop->m_depth = loop->m_parent ? loop->m_parent->m_depth + 1 : 1;
+    for (auto bb : loop->m_blocks) {
+      bb->m_loop = loop;
+    }
+  }
+}
+
+void FlowGraph::Flatten()
+{
+  m_func->m_quads.clear();
+  for (auto bb : m_blocks) {
+    m_func->m_quads.insert(m_func->m_quads.end(), bb->m_quads.begin(),
+                           bb->m_quads.end());
+  }
+}
+
+std::string FlowGraph::Str(const BasicBlock *bb) const
+{
+  auto name = [](const BasicBlock *bb) {
+    return bb->m_id < 0 ? std::string("exit") : "B" + std::to_string(bb->m_id);
+  };
+
+  auto ret = ".block " + name(bb) + " (" + std::to_string(bb->m_quads.size()) +
+             " quads)";
+  if (!bb->IsReachable()) {
+    return ret + " unreachable";
+  }
+  ret += " ->";
+  for (auto succ : bb->m_succs) {
+    ret += " " + name(succ);
+  }
+  ret += ", idom " + name(bb->m_idom);
+  if (bb->m_loop) {
+    ret += ", loop " + name(bb->m_loop->m_header) + " depth " +
+           std::to_string(bb->m_loop->m_depth);
+  }
+  return ret;
+}
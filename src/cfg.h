@@ -0,0 +1,141 @@
+#ifndef C0C_CFG_H
+#define C0C_CFG_H
+
+#include "quad_generator.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct Loop;
+
+inline bool IsCondBranch(QuadOp op)
+{
+  return op >= QO_BNZ && op <= QO_BZ && op != QO_LABEL;
+}
+
+// quads after which control does not fall through
+inline bool IsJump(QuadOp op)
+{
+  return op == QO_GOTO || op == QO_RETURN;
+}
+
+inline LabelStmt *JumpTarget(const Quadruple *quad)
+{
+  return reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
+}
+
+/**
+ * A run of quads entered only at the first one and left only after the
+ * last one. The quads belong to the block while the graph is alive and
+ * are written back to the function by FlowGraph::Flatten().
+ */
+struct BasicBlock {
+  using BlockList = std::vector<BasicBlock *>;
+
+  // label the block starts with, nullptr if it has none
+  LabelStmt *Label() const
+  {
+    return !m_quads.empty() && m_quads.front()->m_op == QO_LABEL ?
+             JumpTarget(m_quads.front()) :
+             nullptr;
+  }
+  // branch, goto or return ending the block, nullptr if it falls through
+  Quadruple *Terminator() const
+  {
+    if (m_quads.empty()) {
+      return nullptr;
+    }
+    auto op = m_quads.back()->m_op;
+    return IsCondBranch(op) || IsJump(op) ? m_quads.back() : nullptr;
+  }
+  bool IsReachable() const
+  {
+    return m_rpo >= 0;
+  }
+
+  int m_id;
+  FuncInfo::QuadList m_quads;
+  BlockList m_preds;
+  BlockList m_succs;  // taken target of a branch first, then fall through
+  BasicBlock *m_idom{nullptr};  // entry is its own
+  BlockList m_children;         // blocks it immediately dominates
+  Loop *m_loop{nullptr};        // innermost loop holding the block
+  int m_rpo{-1};                // reverse postorder number, -1 if unreachable
+};
+
+/**
+ * A natural loop: the blocks reaching a back edge into the header without
+ * passing it. Back edges into the same header make one loop.
+ */
+struct Loop {
+  bool Contains(const BasicBlock *bb) const
+  {
+    for (auto loop = bb->m_loop; loop; loop = loop->m_parent) {
+      if (loop == this) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  BasicBlock *m_header;
+  BasicBlock::BlockList m_blocks;  // header first, then in block order
+  Loop *m_parent{nullptr};
+  int m_depth{1};
+};
+
+/**
+ * Control flow graph of a function, built from the labels, branches and
+ * returns of FuncInfo::m_quads: blocks in quad order with their edges,
+ * immediate dominators and loop nesting. No edge enters the entry block. A
+ * return goes to the exit block, which holds no quads and is not in
+ * m_blocks.
+ */
+class FlowGraph {
+public:
+  explicit FlowGraph(FuncInfo *func);
+  ~FlowGraph();
+  FlowGraph(const FlowGraph &other) = delete;
+  FlowGraph &operator=(const FlowGraph &other) = delete;
+
+  BasicBlock *Entry() const
+  {
+    return m_blocks.front();
+  }
+  BasicBlock *Exit() const
+  {
+    return m_exit;
+  }
+  // block a branch or goto jumps to
+  BasicBlock *Target(const Quadruple *quad) const;
+  bool Dominates(const BasicBlock *a, const BasicBlock *b) const;
+  int LoopDepth(const BasicBlock *bb) const
+  {
+    return bb->m_loop ? bb->m_loop->m_depth : 0;
+  }
+
+  // put the quads of the blocks back into the function, in block order
+  void Flatten();
+  // edges, dominator and loop of a block, one line
+  std::string Str(const BasicBlock *bb) const;
+
+  FuncInfo *m_func;
+  BasicBlock::BlockList m_blocks;  // in quad order, entry first
+  BasicBlock::BlockList m_rpo;     // reachable blocks, exit too, in rpo
+  std::vector<Loop *> m_loops;     // outer loops before inner ones
+
+private:
+  void Split();
+  void Link();
+  void Order();
+  void FindDominators();
+  void FindLoops();
+
+  BasicBlock *NewBlock();
+
+  BasicBlock *m_exit;
+  std::map<LabelStmt *, BasicBlock *> m_labels;
+};
+
+#endif  // !C0C_CFG_H
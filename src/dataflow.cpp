@@ -0,0 +1,84 @@
+#include "dataflow.h"
+#include "debug.h"
+
+void NumberLocals(FlowGraph *cfg, std::map<QuadAddr *, int> &ids)
+{
+  std::vector<QuadAddr *> uses;
+  for (auto bb : cfg->m_blocks) {
+    for (auto quad : bb->m_quads) {
+      uses.clear();
+      quad->Uses(uses);
+      uses.push_back(quad->Def());
+      for (auto qa : uses) {
+        if (qa && qa->IsLocal() && !ids.count(qa)) {
+          auto id = ids.size();
+          ids[qa] = id;
+        }
+      }
+    }
+  }
+}
+
+BitSet BitVectorFlow::Boundary()
+{
+  return BitSet(m_nbits);
+}
+
+BitSet BitVectorFlow::Initial()
+{
+  BitSet set(m_nbits);
+  if (m_must) {
+    set.Fill();
+  }
+  return set;
+}
+
+void BitVectorFlow::Meet(BitSet &state, const BitSet &other)
+{
+  if (m_must) {
+    state.Intersect(other);
+  }
+  else {
+    state.Union(other);
+  }
+}
+
+BitSet BitVectorFlow::Transfer(BasicBlock *bb, const BitSet &state)
+{
+  auto ret = state;
+  m_kill[bb->m_id].Each([&ret](int i) { ret.Set(i, false); });
+  ret.Union(m_gen[bb->m_id]);
+  return ret;
+}
+
+// gen: read before written in the block, kill: written in it
+Liveness::Liveness(FlowGraph *cfg, const std::map<QuadAddr *, int> &ids)
+  : BitVectorFlow(cfg, ids.size(), FD_BACKWARD, false), m_ids(ids)
+{
+  std::vector<QuadAddr *> uses;
+  for (auto bb : m_cfg->m_blocks) {
+    auto &gen = m_gen[bb->m_id];
+    auto &kill = m_kill[bb->m_id];
+    for (auto quad : bb->m_quads) {
+      uses.clear();
+      quad->Uses(uses);
+      for (auto qa : uses) {
+        auto id = Id(qa);
+        if (id >= 0 && !kill.Test(id)) {
+          gen.Set(id);
+        }
+      }
+      auto id = Id(quad->Def());
+      if (id >= 0) {
+        kill.Set(id);
+      }
+    }
+  }
+  Solve();
+}
+
+int Liveness::Id(QuadAddr *qa) const
+{
+  auto it = m_ids.find(qa);
+  return it == m_ids.end() ? -1 : it->second;
+}
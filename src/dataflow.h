@@ -0,0 +1,250 @@
+#ifndef C0C_DATAFLOW_H
+#define C0C_DATAFLOW_H
+
+#include "cfg.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+// fixed size set of small integers
+class BitSet {
+public:
+  BitSet() {}
+  explicit BitSet(size_t n) : m_words((n + 63) / 64) {}
+
+  bool Test(int i) const
+  {
+    return (m_words[i >> 6] >> (i & 63)) & 1;
+  }
+  void Set(int i, bool val = true)
+  {
+    if (val) {
+      m_words[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+    else {
+      m_words[i >> 6] &= ~(uint64_t(1) << (i & 63));
+    }
+  }
+  void Fill()
+  {
+    for (auto &word : m_words) {
+      word = ~uint64_t(0);
+    }
+  }
+  void Union(const BitSet &other)
+  {
+    for (size_t w = 0; w < m_words.size(); ++w) {
+      m_words[w] |= other.m_words[w];
+    }
+  }
+  void Intersect(const BitSet &other)
+  {
+    for (size_t w = 0; w < m_words.size(); ++w) {
+      m_words[w] &= other.m_words[w];
+    }
+  }
+  bool Intersects(const BitSet &other) const
+  {
+    for (size_t w = 0; w < m_words.size(); ++w) {
+      if (m_words[w] & other.m_words[w]) {
+        return true;
+      }
+    }
+    return false;
+  }
+  template <typename Func>
+  void Each(Func func) const
+  {
+    for (size_t w = 0; w < m_words.size(); ++w) {
+      for (auto bits = m_words[w]; bits; bits &= bits - 1) {
+        func(int(w * 64 + __builtin_ctzll(bits)));
+      }
+    }
+  }
+  bool operator==(const BitSet &other) const
+  {
+    return m_words == other.m_words;
+  }
+  bool operator!=(const BitSet &other) const
+  {
+    return m_words != other.m_words;
+  }
+
+private:
+  std::vector<uint64_t> m_words;
+};
+
+// number the locals and temporaries of the quads in order of appearance
+void NumberLocals(FlowGraph *cfg, std::map<QuadAddr *, int> &ids);
+
+enum FlowDirection {
+  FD_FORWARD,
+  FD_BACKWARD,
+};
+
+/**
+ * A dataflow problem over the blocks of a flow graph, solved by a worklist
+ * in (reverse for backward problems) reverse postorder. m_in and m_out of
+ * a block are the states before its first quad and after its last one;
+ * a block is revisited whenever the state flowing into it changes.
+ *
+ * A problem gives the state at the boundary, entry or exit, the state
+ * every block starts from, how states meet and how a block transfers one.
+ * An edge not taken is left out of the meet.
+ */
+template <typename State>
+class DataFlow {
+public:
+  DataFlow(FlowGraph *cfg, FlowDirection dir) : m_cfg(cfg), m_dir(dir) {}
+  virtual ~DataFlow() {}
+
+  void Solve();
+
+  std::vector<State> m_in;   // by block id
+  std::vector<State> m_out;  // by block id
+
+protected:
+  virtual State Boundary() = 0;
+  virtual State Initial() = 0;
+  virtual void Meet(State &state, const State &other) = 0;
+  // from the state flowing into the block, in its direction
+  virtual State Transfer(BasicBlock *bb, const State &state) = 0;
+  virtual bool Executable(BasicBlock *from, BasicBlock *to)
+  {
+    return true;
+  }
+
+  FlowGraph *m_cfg;
+  FlowDirection m_dir;
+};
+
+template <typename State>
+void DataFlow<State>::Solve()
+{
+  auto forward = m_dir == FD_FORWARD;
+  auto nblocks = m_cfg->m_blocks.size();
+  m_in.assign(nblocks, Initial());
+  m_out.assign(nblocks, Initial());
+
+  std::deque<BasicBlock *> work;
+  std::vector<bool> queued(nblocks);
+  auto order = m_cfg->m_rpo;
+  if (!forward) {
+    // unreachable blocks may still reach the exit
+    order.clear();
+    for (auto it = m_cfg->m_blocks.rbegin(); it != m_cfg->m_blocks.rend();
+         ++it) {
+      order.push_back(*it);
+    }
+  }
+  for (auto bb : order) {
+    if (bb == m_cfg->Exit()) {
+      continue;
+    }
+    work.push_back(bb);
+    queued[bb->m_id] = true;
+  }
+
+  while (!work.empty()) {
+    auto bb = work.front();
+    work.pop_front();
+    queued[bb->m_id] = false;
+
+    auto &from = forward ? bb->m_preds : bb->m_succs;
+    auto &in = forward ? m_in[bb->m_id] : m_out[bb->m_id];
+    auto boundary = forward ? bb == m_cfg->Entry() : false;
+    State state = boundary ? Boundary() : Initial();
+    for (auto other : from) {
+      if (other == m_cfg->Exit()) {
+        Meet(state, Boundary());
+      }
+      else if (forward ? Executable(other, bb) : Executable(bb, other)) {
+        Meet(state, forward ? m_out[other->m_id] : m_in[other->m_id]);
+      }
+    }
+    in = state;
+
+    auto result = Transfer(bb, in);
+    auto &out = forward ? m_out[bb->m_id] : m_in[bb->m_id];
+    if (result == out) {
+      continue;
+    }
+    out = result;
+    for (auto other : forward ? bb->m_succs : bb->m_preds) {
+      if (other != m_cfg->Exit() && !queued[other->m_id]) {
+        work.push_back(other);
+        queued[other->m_id] = true;
+      }
+    }
+  }
+}
+
+/**
+ * A problem over sets of bits: out = gen + (in - kill) in its direction,
+ * meeting by union for a may problem and by intersection for a must one.
+ */
+class BitVectorFlow : public DataFlow<BitSet> {
+public:
+  BitVectorFlow(FlowGraph *cfg, size_t nbits, FlowDirection dir, bool must)
+    : DataFlow(cfg, dir), m_gen(cfg->m_blocks.size(), BitSet(nbits)),
+      m_kill(cfg->m_blocks.size(), BitSet(nbits)), m_nbits(nbits),
+      m_must(must)
+  {
+  }
+
+  std::vector<BitSet> m_gen;   // by block id
+  std::vector<BitSet> m_kill;  // by block id
+
+protected:
+  virtual BitSet Boundary();
+  virtual BitSet Initial();
+  virtual void Meet(BitSet &state, const BitSet &other);
+  virtual BitSet Transfer(BasicBlock *bb, const BitSet &state);
+
+  size_t m_nbits;
+  bool m_must;
+};
+
+/**
+ * Live variables: the locals and temporaries numbered in `ids` that may be
+ * read before they are written again.
+ */
+class Liveness : public BitVectorFlow {
+public:
+  Liveness(FlowGraph *cfg, const std::map<QuadAddr *, int> &ids);
+
+  // live after each quad of a block, from the last one back
+  template <typename Func>
+  void EachQuad(BasicBlock *bb, Func func);
+
+private:
+  int Id(QuadAddr *qa) const;
+
+  const std::map<QuadAddr *, int> &m_ids;
+};
+
+template <typename Func>
+void Liveness::EachQuad(BasicBlock *bb, Func func)
+{
+  auto live = m_out[bb->m_id];
+  std::vector<QuadAddr *> uses;
+  for (auto it = bb->m_quads.rbegin(); it != bb->m_quads.rend(); ++it) {
+    func(*it, live);
+    auto def = Id((*it)->Def());
+    if (def >= 0) {
+      live.Set(def, false);
+    }
+    uses.clear();
+    (*it)->Uses(uses);
+    for (auto qa : uses) {
+      auto id = Id(qa);
+      if (id >= 0) {
+        live.Set(id);
+      }
+    }
+  }
+}
+
+#endif  // !C0C_DATAFLOW_H
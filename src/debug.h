@@ -47,9 +47,23 @@ void _debug(const char *file, int line, const char *format, ...);
 #endif  // NDEBUG
 
 /* Optimization */
+#define INLINE_FUNCTIONS
+#define TAIL_CALLS
 #define CONST_PROPAGATION
-// #define INLINE_EPILOG
-// #define GLOBAL_REG_ALLOCATION
-// #define REG_ARGS
+#define DEAD_CODE_ELIMINATION
+#define SSA_FORM
+#define VALUE_NUMBERING    // needs SSA_FORM
+#define LOOP_OPTIMIZATION  // needs SSA_FORM
+#define BLOCK_LAYOUT
+#define MULDIV_BY_CONST
+#define IMM_OPERANDS
+#define INLINE_EPILOG
+#define SHRINK_WRAP
+#define SLOT_COLORING
+#define STRING_POOL
+#define PRINT_BATCHING  // needs STRING_POOL
+#define REG_ARGS
+#define PEEPHOLE
+#define SCHEDULING
 
 #endif  // !C0C_DEBUG_H
@@ -4,66 +4,302 @@
 #include "iobase.h"
 #include "token.h"
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
+#include <set>
 #include <string>
+#include <tuple>
 
 #ifdef PRINT_ERROR
 extern std::ofstream errstream;
 #endif  // PRINT_ERROR
 
 int error_flag;
+int error_count;  // errors committed, with a course code or not
 
-void Error(const char *format, ...)
+static thread_local ErrorBuffer *error_buffer;
+static thread_local bool error_muted;
+
+static DiagnosticList diagnostics;  // kept for rendering
+static std::set<std::tuple<unsigned, unsigned, std::string>> reported;
+static unsigned suppressed;  // reported beyond the limit
+static unsigned error_limit = 20;
+static DiagnosticFormat diagnostic_format = DF_TEXT;
+
+void SetErrorLimit(unsigned limit)
 {
-  fprintf(stderr, "error: ");
+  error_limit = limit;
+}
 
-  va_list args;
-  va_start(args, format);
-  vfprintf(stderr, format, args);
-  va_end(args);
+void SetDiagnosticFormat(DiagnosticFormat format)
+{
+  diagnostic_format = format;
+}
+
+static void Commit(const Diagnostic &diag)
+{
+  if (!reported.emplace(diag.line, diag.column, diag.message).second) {
+    return;  // duplicate
+  }
+  error_flag = 1;
+  ++error_count;
+  diagnostics.push_back(diag);
+}
+
+/**
+ * @brief Put the diagnostics in source order, whatever order they were
+ *   reported in, so that a parallel parse renders them as a serial one
+ *   does. One with no location stays after the one it followed.
+ */
+static void SortDiagnostics()
+{
+  std::vector<std::pair<unsigned, unsigned>> pos(diagnostics.size());
+  for (size_t i = 0; i < diagnostics.size(); ++i) {
+    auto &diag = diagnostics[i];
+    if (diag.length) {
+      pos[i] = {diag.line, diag.column};
+    }
+    else if (i) {
+      pos[i] = pos[i - 1];
+    }
+  }
+  std::vector<size_t> order(diagnostics.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return pos[a] < pos[b]; });
+  DiagnosticList sorted;
+  sorted.reserve(order.size());
+  for (auto i : order) {
+    sorted.push_back(std::move(diagnostics[i]));
+  }
+  diagnostics.swap(sorted);
+}
 
-  fprintf(stderr, "\n");
+void SetErrorBuffer(ErrorBuffer *buf)
+{
+  error_buffer = buf;
 }
 
-static void VError(const SourceLocation &loc, const char *format, va_list args)
+void FlushErrorBuffer(const ErrorBuffer &buf)
 {
-  fprintf(stderr, "%d:%d: error: ", loc.line, loc.column);
-  vfprintf(stderr, format, args);
-  fprintf(stderr, "\n    ");
+  for (auto &diag : buf.diags) {
+    Commit(diag);
+  }
+}
 
-  bool saw_no_space = false;
-  int nspaces = 0;
-  for (auto p = loc.line_begin; *p != '\n' && *p != 0; p++) {
-    if (!saw_no_space && (*p == ' ' || *p == '\t')) {
-      ++nspaces;
+void ReplayErrors(const ErrorBuffer &buf)
+{
+  if (error_muted) {
+    return;
+  }
+  for (auto &diag : buf.diags) {
+    if (error_buffer != nullptr) {
+      error_buffer->diags.push_back(diag);
     }
     else {
-      saw_no_space = true;
-      fputc(*p, stderr);
+      Commit(diag);
+    }
+  }
+}
+
+void MuteErrors(bool mute)
+{
+  error_muted = mute;
+}
+
+static std::string VFormat(const char *format, va_list args)
+{
+  va_list copy;
+  va_copy(copy, args);
+  auto len = vsnprintf(nullptr, 0, format, copy);
+  va_end(copy);
+  std::string str(len + 1, '\0');
+  vsnprintf(&str[0], len + 1, format, args);
+  str.pop_back();
+  return str;
+}
+
+/**
+ * @brief Record an error on `length` bytes at `loc`, or with no location.
+ *   The source line is copied right away, its buffer may not outlive us.
+ */
+static void Report(const SourceLocation *loc,
+                   unsigned length,
+                   char code,
+                   std::string &&message)
+{
+  if (error_muted) {
+    return;
+  }
+  Diagnostic diag{"", 0, 0, 0, code, std::move(message), "", 0};
+  if (loc != nullptr) {
+    diag.filename = loc->filename ? loc->filename : "";
+    diag.line = loc->line;
+    diag.column = loc->column;
+    diag.length = length > 0 ? length : 1;
+
+    auto p = loc->line_begin;
+    for (; *p == ' ' || *p == '\t'; ++p) {
+      ++diag.indent;
+    }
+    auto end = p;
+    while (*end != '\n' && *end != 0) {
+      ++end;
+    }
+    diag.source.assign(p, end);
+  }
+
+  if (error_buffer != nullptr) {
+    error_buffer->diags.push_back(std::move(diag));
+  }
+  else {
+    Commit(diag);
+  }
+}
+
+static std::string JsonString(const std::string &str)
+{
+  std::string ret = "\"";
+  for (unsigned char c : str) {
+    switch (c) {
+    case '"':
+      ret += "\\\"";
+      break;
+    case '\\':
+      ret += "\\\\";
+      break;
+    case '\n':
+      ret += "\\n";
+      break;
+    case '\t':
+      ret += "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        ret += buf;
+      }
+      else {
+        ret.push_back(c);
+      }
+      break;
+    }
+  }
+  return ret + "\"";
+}
+
+/*
+ * 12:5: error: <message>
+ *     <source line>
+ *         ^~~~
+ */
+static void RenderText(std::string &out)
+{
+  for (auto &diag : diagnostics) {
+    if (diag.length == 0) {
+      out += "error: " + diag.message + "\n";
+      continue;
+    }
+    out += std::to_string(diag.line) + ":" + std::to_string(diag.column) +
+           ": error: " + diag.message + "\n    " + diag.source + "\n    ";
+    unsigned pos =
+      diag.column > diag.indent + 1 ? diag.column - diag.indent - 1 : 0;
+    unsigned length = diag.length;
+    if (pos + length > diag.source.size()) {
+      length = pos < diag.source.size() ? diag.source.size() - pos : 1;
     }
+    out.append(pos, ' ');
+    out += "^";
+    out.append(length - 1, '~');
+    out += "\n";
+  }
+  if (suppressed) {
+    out += "error: too many errors emitted, " + std::to_string(suppressed) +
+           " more not shown [-ferror-limit=" + std::to_string(error_limit) +
+           "]\n";
+  }
+}
+
+/*
+ * {"diagnostics": [{"file": .., "line": .., "column": .., "length": ..,
+ *   "code": .., "message": .., "source": ..}, ..], "suppressed": ..}
+ */
+static void RenderJson(std::string &out)
+{
+  out += "{\"diagnostics\": [";
+  for (size_t i = 0; i < diagnostics.size(); ++i) {
+    auto &diag = diagnostics[i];
+    out += i ? ",\n  " : "\n  ";
+    out += "{\"file\": " + JsonString(diag.filename) +
+           ", \"line\": " + std::to_string(diag.line) +
+           ", \"column\": " + std::to_string(diag.column) +
+           ", \"length\": " + std::to_string(diag.length) + ", \"code\": " +
+           (diag.code ? JsonString(std::string(1, diag.code)) : "null") +
+           ", \"message\": " + JsonString(diag.message) +
+           ", \"source\": " + JsonString(diag.source) + "}";
+  }
+  out += "],\n \"suppressed\": " + std::to_string(suppressed) + "}\n";
+}
+
+void RenderDiagnostics()
+{
+  SortDiagnostics();
+  std::string error_codes;  // what goes to error.txt
+  for (auto &diag : diagnostics) {
+    if (diag.code) {
+      error_codes += std::to_string(diag.line) + " " + diag.code + "\n";
+    }
+  }
+  if (error_limit && diagnostics.size() > error_limit) {
+    suppressed = diagnostics.size() - error_limit;
+    diagnostics.resize(error_limit);
   }
 
-  fprintf(stderr, "\n    ");
-  for (unsigned i = 1; i + nspaces < loc.column; ++i)
-    fputc(' ', stderr);
-  fprintf(stderr, "^\n");
+  std::string out;
+  if (diagnostic_format == DF_JSON) {
+    RenderJson(out);
+  }
+  else {
+    RenderText(out);
+  }
+  fputs(out.c_str(), stderr);
+#ifdef PRINT_ERROR
+  errstream << error_codes;
+  errstream.flush();
+#endif  // PRINT_ERROR
+
+  diagnostics.clear();
+  reported.clear();
+  suppressed = 0;
+}
+
+void Error(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  Report(nullptr, 0, 0, VFormat(format, args));
+  va_end(args);
 }
 
 void Error(const SourceLocation &loc, const char *format, ...)
 {
   va_list args;
   va_start(args, format);
-  VError(loc, format, args);
+  Report(&loc, 1, 0, VFormat(format, args));
   va_end(args);
 }
 
 void Error(const Expr *expr, const char *format, ...)
 {
+  auto tok = expr->Tok();
   va_list args;
   va_start(args, format);
-  VError(expr->Tok()->m_loc, format, args);
+  Report(&tok->m_loc, tok->m_value.size(), 0, VFormat(format, args));
   va_end(args);
 }
 
@@ -71,10 +307,19 @@ void Error(const Token *tok, const char *format, ...)
 {
   va_list args;
   va_start(args, format);
-  VError(tok->m_loc, format, args);
+  Report(&tok->m_loc, tok->m_value.size(), 0, VFormat(format, args));
   va_end(args);
 }
 
+static std::string Format(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  auto str = VFormat(format, args);
+  va_end(args);
+  return str;
+}
+
 void Error(const Token *tok, const char _errno)
 {
   if (tok->m_loc.line < 1 || _errno < 'a' || _errno > 'o') {
@@ -82,59 +327,57 @@ void Error(const Token *tok, const char _errno)
           _errno);
   }
 
-#ifdef PRINT_ERROR
-  errstream << tok->m_loc.line << " " << _errno << std::endl;
-#endif  // PRINT_ERROR
-  error_flag = 1;
+  std::string message;
   switch (_errno) {
   case 'a':  // 非法符号或不符合词法
-    Error(tok, "unrecognized token \'%s\'", tok->m_value.c_str());
+    message = Format("unrecognized token \'%s\'", tok->m_value.c_str());
     break;
   case 'b':  // 名字重定义
-    Error(tok, "redefinition of identifier \'%s\'", tok->m_value.c_str());
+    message = Format("redefinition of identifier \'%s\'", tok->m_value.c_str());
     break;
   case 'c':  // 未定义的名字
-    Error(tok, "used undeclared identifier \'%s\'", tok->m_value.c_str());
+    message = Format("used undeclared identifier \'%s\'", tok->m_value.c_str());
     break;
   case 'd':  // 函数参数个数不匹配
-    Error(tok, "too many(or less) parameters in call");
+    message = Format("too many(or less) parameters in call");
     break;
   case 'e':  // 函数参数类型不匹配
-    Error(tok, "imcompatible parameter type");
+    message = Format("imcompatible parameter type");
     break;
   case 'f':  // 条件判断中出现不合法的类型
-    Error(tok, "illegal type in condition expression");
+    message = Format("illegal type in condition expression");
     break;
   case 'g':  // 无返回值的函数存在不匹配的return语句
-    Error(tok, "void function cannot return a value");
+    message = Format("void function cannot return a value");
     break;
   case 'h':  // 有返回值的函数缺少return语句或存在不匹配的return语句
-    Error(tok, "non-void function should return a proper value");
+    message = Format("non-void function should return a proper value");
     break;
   case 'i':  // 数组的下标只能是整型表达式
-    Error(tok, "subscript of array must be \'int\' type");
+    message = Format("subscript of array must be \'int\' type");
     break;
   case 'j':  // 不能改变常量的值
-    Error(tok, "cannot assign to constant variable");
+    message = Format("cannot assign to constant variable");
     break;
   case 'k':  // 应为分号
-    Error(tok, "expected \';\' after %s.", tokenlist[tok->m_type]);
+    message = Format("expected \';\' after %s.", tokenlist[tok->m_type]);
     break;
   case 'l':  // 应为右小括号’)’
-    Error(tok, "expected \')\', we got %s.", tok->m_value.c_str());
+    message = Format("expected \')\', we got %s.", tok->m_value.c_str());
     break;
   case 'm':  // 应为右中括号’]’
-    Error(tok, "expected \']\', we got %s.", tok->m_value.c_str());
+    message = Format("expected \']\', we got %s.", tok->m_value.c_str());
     break;
   case 'n':  // do-while语句中缺少 while
-    Error(tok, "expected \'while\' in do/while loop");
+    message = Format("expected \'while\' in do/while loop");
     break;
   case 'o':  // 常量定义中=后面只能是整型或字符型常量
-    Error(tok, "const variable definition must be initialized with \'int\' "
-               "or \'char\' type");
+    message = Format("const variable definition must be initialized with "
+                     "\'int\' or \'char\' type");
     break;
   default:
     Error("unsupported error type!");
-    break;
+    return;
   }
+  Report(&tok->m_loc, tok->m_value.size(), _errno, std::move(message));
 }
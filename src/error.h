@@ -1,10 +1,62 @@
 #ifndef C0C_ERROR_H
 #define C0C_ERROR_H
 
+#include <string>
+#include <vector>
+
 struct SourceLocation;
 struct Token;
 class Expr;
 
+/**
+ * Errors are not printed when reported. They are collected as diagnostics,
+ * duplicates dropped, and printed at once by RenderDiagnostics().
+ */
+struct Diagnostic {
+  std::string filename;
+  unsigned line;
+  unsigned column;
+  unsigned length;  // of the source range, 0 if there is no location
+  char code;        // course error code 'a'~'o', 0 for other errors
+  std::string message;
+  std::string source;  // line of the range, leading blanks dropped
+  unsigned indent;     // number of leading blanks dropped
+};
+using DiagnosticList = std::vector<Diagnostic>;
+
+enum DiagnosticFormat {
+  DF_TEXT,
+  DF_JSON,
+};
+
+/**
+ * Errors reported by a thread with a buffer set are held back in it and
+ * only take effect once flushed, so that they come out in source order.
+ */
+struct ErrorBuffer {
+  DiagnosticList diags;
+};
+void SetErrorBuffer(ErrorBuffer *buf);
+void FlushErrorBuffer(const ErrorBuffer &buf);
+// report the errors held in `buf` again, as if raised right now
+void ReplayErrors(const ErrorBuffer &buf);
+
+/**
+ * Errors reported by a thread while muted are dropped. The parser mutes
+ * them from a syntax error until it has resynchronised, so that the one
+ * error does not cascade.
+ */
+void MuteErrors(bool mute);
+
+// 0 for no limit
+void SetErrorLimit(unsigned limit);
+void SetDiagnosticFormat(DiagnosticFormat format);
+/**
+ * Print the diagnostics collected so far to stderr in source order, and
+ * their codes to error.txt, then forget them.
+ */
+void RenderDiagnostics();
+
 void Error(const SourceLocation &loc, const char *format, ...);
 void Error(const char *format, ...);
 void Error(const Token *tok, const char *format, ...);
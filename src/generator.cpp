@@ -1,23 +1,49 @@
 #include "generator.h"
+#include "cfg.h"
 #include "debug.h"
 #include "mips_isa.h"
 #include "parser.h"
 #include "quad_generator.h"
+#include "schedule.h"
+#include "thread_pool.h"
 #include "token.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cstdarg>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <set>
 
-void Generator::EmitComment(const char *format, ...)
+void Generator::Emit(const std::string &str, unsigned indent)
 {
-  fprintf(m_outstream, "\n    # ");
+  std::string line;
+  for (; indent > 0; indent = indent - 4) {
+    line += "    ";
+  }
+  if (line.empty() && !str.empty() && str.back() == ':') {
+    Put(MInst::Line(MO_LABEL, str.substr(0, str.size() - 1)));
+  }
+  else {
+    Put(MInst::Line(MO_TEXT, line + str));
+  }
+}
 
+void Generator::EmitComment(const char *format, ...)
+{
   va_list args;
   va_start(args, format);
-  vfprintf(m_outstream, format, args);
+  auto len = vsnprintf(nullptr, 0, format, args);
+  va_end(args);
+
+  std::string text(len + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&text[0], text.size(), format, args);
   va_end(args);
+  text.pop_back();
 
-  fputc('\n', m_outstream);
+  Put(MInst::Line(MO_NOTE, "\n    # " + text));
 }
 
 void CodeGenerator::EmitDirective(int dir)
@@ -39,13 +65,13 @@ void CodeGenerator::EmitPush(Gpr reg)
 {
   EmitComment("push %s", regs[reg]);
   EmitStore(reg, Gpr::sp);
-  Emit("addiu", sp, sp, -4);
+  Emit(MO_ADDIU, sp, sp, -4);
 }
 
 void CodeGenerator::EmitPop(Gpr reg)
 {
   EmitComment("pop %s", regs[reg]);
-  Emit("addiu", sp, sp, 4);
+  Emit(MO_ADDIU, sp, sp, 4);
   EmitLoad(reg, Gpr::sp);
 }
 
@@ -62,12 +88,12 @@ void CodeGenerator::EmitSyscall(unsigned service_no)
   if (service_no == SC_EXIT) {
     EmitComment("Exit(10): terminate execution");
   }
-  Emit("li", Gpr::v0, service_no);
-  Emit("syscall");
+  Emit(MO_LI, Gpr::v0, service_no);
+  Emit(MO_SYSCALL);
   EmitBlankLine();
 }
 
-void CodeGenerator::EmitSyscall(unsigned service_no, const std::string &arg0)
+void CodeGenerator::EmitSyscall(unsigned service_no, Gpr arg0)
 {
   // EmitBlankLine();
   switch (service_no) {
@@ -76,68 +102,85 @@ void CodeGenerator::EmitSyscall(unsigned service_no, const std::string &arg0)
     // move vs. add:
     //   move 2nd operand can only be reg, add 3rd op is extended to reg &
     //   imm
-    // if (isdigit(arg0[0]) || arg0[0] == '$')
-    Emit("add", regs[Gpr::a0], regs[Gpr::zero], arg0);
-    // else if (isalpha(arg0[0]) || arg0[0] == '_')
-    //     Emit("lw", regs[Gpr::a0], arg0);
+    Emit(MO_ADD, Gpr::a0, Gpr::zero, arg0);
     // Emit("la", Gpr::a0, "__builtin_line_feed__");
     // Emit("li", Gpr::v0, service_no);
     // Emit("syscall");
-    Emit("li", regs[Gpr::v0], service_no);
-    Emit("syscall");
+    Emit(MO_LI, Gpr::v0, service_no);
+    Emit(MO_SYSCALL);
     // EmitSyscall(4, "__builtin_line_feed__");
     break;
   }
-  case SC_PRINT_STR: {
-    EmitComment("print string(4), $a0 = string addr");
-    Emit("la", regs[Gpr::a0], arg0);
-    Emit("li", regs[Gpr::v0], service_no);
-    Emit("syscall");
-    break;
-  }
   case SC_READ_INT: {
     EmitComment("read int(5), $v0 contains integer read");
-    Emit("li", Gpr::v0, service_no);
-    Emit("syscall");
-    // EmitStore(Gpr::v0, arg0);
+    Emit(MO_LI, Gpr::v0, service_no);
+    Emit(MO_SYSCALL);
     break;
   }
   case SC_PRINT_CHAR: {
     EmitComment("print char(11), $a0 = character to print");
-    Emit("addu", regs[Gpr::a0], regs[Gpr::zero], arg0);
-    Emit("li", Gpr::v0, service_no);
-    Emit("syscall");
+    Emit(MO_ADDU, Gpr::a0, Gpr::zero, arg0);
+    Emit(MO_LI, Gpr::v0, service_no);
+    Emit(MO_SYSCALL);
     break;
   }
   case SC_READ_CHAR: {
     EmitComment("read char(12), $v0 contains char read");
-    Emit("li", regs[Gpr::v0], service_no);
-    Emit("syscall");
-    // EmitStore(Gpr::v0, arg0);
+    Emit(MO_LI, Gpr::v0, service_no);
+    Emit(MO_SYSCALL);
     break;
   }
   default:
+    assert(0);
     break;
   }
+}
 
-  // if (isalpha(arg0[0]) || arg0[0] == '_') {
-  //     EmitStore(Gpr::v0, arg0);
-  // }
-  // else {
-  //     Emit("move", arg0, Gpr::v0);
-  // }
-  // EmitBlankLine();
+void CodeGenerator::EmitSyscall(unsigned service_no, const std::string &label)
+{
+  assert(service_no == SC_PRINT_STR);
+  EmitComment("print string(4), $a0 = string addr");
+  Emit(MO_LA, Gpr::a0, label);
+  Emit(MO_LI, Gpr::v0, service_no);
+  Emit(MO_SYSCALL);
+}
+
+static bool isliteral(QuadAddr *qa)
+{
+  return qa->m_type == QuadAddr::AT_INTL || qa->m_type == QuadAddr::AT_CHARL;
+}
+
+#ifdef IMM_OPERANDS
+// a literal that fits the immediate of an instruction, times `sign`
+static bool isimm(QuadAddr *qa, long sign = 1)
+{
+  return isliteral(qa) && IsImm16(sign * qa->m_data);
+}
+
+// the offset of an element at a literal index, from the array or the
+// label of a global one, if it fits an instruction
+static bool constindex(QuadAddr *qa, long &off)
+{
+  if (!isliteral(qa->m_minion)) {
+    return false;
+  }
+  off = qa->m_scaled ? qa->m_minion->m_data : qa->m_minion->m_data * 4;
+  return off >= 0 && (qa->m_isglb || IsImm16(qa->m_offset + off));
 }
+#endif  // IMM_OPERANDS
 
 Gpr CodeGenerator::VisitQuadAddr(QuadAddr *qa)
 {
-  static int reg = Gpr::t8;
+  auto &reg = m_reg;
 
-#ifdef GLOBAL_REG_ALLOCATION
-  if (m_curfunc->m_isleaf && qa->m_bind) {
+  if (qa->m_bind != Gpr::zero) {
     return qa->m_bind;
   }
-#endif  // GLOBAL_REG_ALLOCATION
+#ifdef IMM_OPERANDS
+  if (isliteral(qa) && qa->m_data == 0) {
+    return Gpr::zero;
+  }
+#endif  // IMM_OPERANDS
   reg += 1;
   if (reg > Gpr::t9) {
     reg = Gpr::t8;
@@ -145,7 +188,7 @@ Gpr CodeGenerator::VisitQuadAddr(QuadAddr *qa)
   switch (qa->m_type) {
   case QuadAddr::AT_CHARL:
   case QuadAddr::AT_INTL:
-    Emit("li", (Gpr)reg, qa->m_data);
+    Emit(MO_LI, (Gpr)reg, qa->m_data);
     break;
   case QuadAddr::AT_IDENT:
     if (qa->m_isglb) {
@@ -166,27 +209,46 @@ Gpr CodeGenerator::VisitQuadAddr(QuadAddr *qa)
 
     break;
   case QuadAddr::AT_ARRAY: {
+#ifdef IMM_OPERANDS
+    long off;
+    if (!qa->m_islval && constindex(qa, off)) {
+      // lw $t_dst, off+array or off+offset($sp)
+      if (qa->m_isglb) {
+        auto glbarr = reinterpret_cast<Identifier *>(qa->m_data);
+        EmitLoad((Gpr)reg, Gpr::zero, glbarr->Name(), off);
+      }
+      else {
+        EmitLoad((Gpr)reg, Gpr::sp, qa->m_offset + off);
+      }
+      break;
+    }
+#endif  // IMM_OPERANDS
     auto reg_idx = VisitQuadAddr(qa->m_minion);
-    Emit("sll", (Gpr)reg, reg_idx, 2);
+    // an index in bytes already is the offset
+    auto reg_off = reg_idx;
+    if (!qa->m_scaled) {
+      Emit(MO_SLL, (Gpr)reg, reg_idx, 2);
+      reg_off = (Gpr)reg;
+    }
     if (qa->m_islval) {
       // maybe changed
-      EmitComment(qa->Str().c_str());
-      debug(qa->Str().c_str());
+      EmitComment("%s", qa->Str().c_str());
+      debug("%s", qa->Str().c_str());
       assert(0);
     }
     // sll $t_idx, $t_idx, 2
     // lw $t_dst, array($t_idx) #array + $t_idx * 4
     else if (qa->m_isglb) {
       auto glbarr = reinterpret_cast<Identifier *>(qa->m_data);
-      EmitLoad((Gpr)reg, glbarr->Name() + "(" + regs[reg] + ")");
+      EmitLoad((Gpr)reg, reg_off, glbarr->Name());
     }
     //  sll $t_idx, $t_idx, 2
     //  addiu $t_dst, $t_idx, offset
     //  addu $t_idx, $t_dst, $sp
     //  lw $t_dst, ($t_idx)    # array + $t_idx * 4
     else {
-      Emit("addiu", (Gpr)reg, (Gpr)reg, qa->m_offset);
-      Emit("addu", (Gpr)reg, (Gpr)reg, Gpr::sp);
+      Emit(MO_ADDIU, (Gpr)reg, reg_off, qa->m_offset);
+      Emit(MO_ADDU, (Gpr)reg, (Gpr)reg, Gpr::sp);
       EmitLoad((Gpr)reg, (Gpr)reg);
     }
     break;
@@ -201,50 +263,79 @@ Gpr CodeGenerator::VisitQuadAddr(QuadAddr *qa)
   return (Gpr)reg;
 }
 
+Gpr CodeGenerator::DstReg(QuadAddr *dst)
+{
+  return dst->m_bind != Gpr::zero ? dst->m_bind : Gpr::t8;
+}
+
+// put `src` into `dst`, which is not an array element
+void CodeGenerator::GenWriteBack(QuadAddr *dst, Gpr src)
+{
+  if (dst->m_bind != Gpr::zero) {
+    if (dst->m_bind != src) {
+      Emit(MO_MOVE, dst->m_bind, src);
+    }
+  }
+  else if (dst->m_type == QuadAddr::AT_IDENT && dst->m_isglb) {
+    auto glbvar = reinterpret_cast<Identifier *>(dst->m_data);
+    EmitStore(src, glbvar->Name());
+  }
+  else {
+    EmitStore(src, Gpr::sp, dst->m_offset);
+  }
+}
+
 void CodeGenerator::GenAssign(QuadAddr *dst, QuadAddr *arg1)
 {
   // EmitLoad(Gpr::t0, Gpr::sp, quad->m_arg1->m_offset);
   // EmitStore(Gpr::t0, Gpr::sp, quad->m_dst->m_offset);
+  if (dst->m_bind != Gpr::zero && (arg1->m_type == QuadAddr::AT_INTL ||
+                                   arg1->m_type == QuadAddr::AT_CHARL)) {
+    Emit(MO_LI, dst->m_bind, arg1->m_data);
+    return;
+  }
   auto src = VisitQuadAddr(arg1);
   auto tmp_reg = src == Gpr::t8 ? Gpr::t9 : Gpr::t8;
   switch (dst->m_type) {
   case QuadAddr::AT_IDENT:
-    if (dst->m_isglb) {
-      auto glbvar = reinterpret_cast<Identifier *>(dst->m_data);
-      EmitStore(src, glbvar->Name());
-    }
-#ifdef GLOBAL_REG_ALLOCATION
-    else if (m_curfunc->m_isleaf && dst->m_bind) {
-      Emit("move", dst->m_bind, src);
-      // Emit("add", dst->m_bind, Gpr::zero, src);
-    }
-#endif  // GLOBAL_REG_ALLOCATION
-    else {
-      EmitStore(src, Gpr::sp, dst->m_offset);
-    }
-    break;
   case QuadAddr::AT_TMPCH:
   case QuadAddr::AT_TMP:
-    EmitStore(src, Gpr::sp, dst->m_offset);
-    // Emit("move", Gpr::t8, src);
+    GenWriteBack(dst, src);
     break;
 
   case QuadAddr::AT_ARRAY: {
     // assert(dst->m_islval);
+#ifdef IMM_OPERANDS
+    long off;
+    if (constindex(dst, off)) {
+      if (dst->m_isglb) {
+        auto glbvar = reinterpret_cast<Identifier *>(dst->m_data);
+        EmitStore(src, Gpr::zero, glbvar->Name(), off);
+      }
+      else {
+        EmitStore(src, Gpr::sp, dst->m_offset + off);
+      }
+      break;
+    }
+#endif  // IMM_OPERANDS
     auto reg_idx = VisitQuadAddr(dst->m_minion);
-    Emit("sll", tmp_reg, reg_idx, 2);
+    auto reg_off = reg_idx;
+    if (!dst->m_scaled) {
+      Emit(MO_SLL, tmp_reg, reg_idx, 2);
+      reg_off = tmp_reg;
+    }
     // sll $ti, $ti, 2
     // sw $tx, glist($ti)
     if (dst->m_isglb) {
       auto glbvar = reinterpret_cast<Identifier *>(dst->m_data);
-      EmitStore(src, tmp_reg, glbvar->Name());
+      EmitStore(src, reg_off, glbvar->Name());
     }
     // sll $ti, $ti, 2
     // addiu $tx, $ti, offset
     // addu $ti, $tx, $sp
     else {
-      Emit("addiu", tmp_reg, tmp_reg, dst->m_offset);
-      Emit("addu", tmp_reg, tmp_reg, Gpr::sp);
+      Emit(MO_ADDIU, tmp_reg, reg_off, dst->m_offset);
+      Emit(MO_ADDU, tmp_reg, tmp_reg, Gpr::sp);
       EmitStore(src, tmp_reg);
     }
     break;
@@ -260,130 +351,329 @@ void CodeGenerator::GenAssign(QuadAddr *dst, QuadAddr *arg1)
 
 void CodeGenerator::GenAdd(Quadruple *quad)
 {
-  auto reg1 = VisitQuadAddr(quad->m_arg1);
-  auto reg2 = VisitQuadAddr(quad->m_arg2);
-#ifdef GLOBAL_REG_ALLOCATION
-  if (m_curfunc->m_isleaf) {
-    if (quad->m_arg1->m_bind) {
-      reg1 = quad->m_arg1->m_bind;
-    }
-    if (quad->m_arg2->m_bind) {
-      reg2 = quad->m_arg2->m_bind;
-    }
-    if (quad->m_dst->m_bind) {
-      Gpr dst = quad->m_dst->m_bind;
-      Emit("addu", dst, reg1, reg2);
+#ifdef IMM_OPERANDS
+  auto arg1 = quad->m_arg1, arg2 = quad->m_arg2;
+  if (isimm(arg1)) {
+    std::swap(arg1, arg2);
+  }
+  if (isimm(arg2)) {
+    auto src = VisitQuadAddr(arg1);
+    auto dst = DstReg(quad->m_dst);
+    if (arg2->m_data == 0) {
+      Emit(MO_MOVE, dst, src);
     }
     else {
-      Emit("addu", Gpr::t8, reg1, reg2);
-      EmitStore(Gpr::t8, Gpr::sp, quad->m_dst->m_offset);  // opt
+      Emit(MO_ADDIU, dst, src, arg2->m_data);
     }
+    GenWriteBack(quad->m_dst, dst);
     return;
   }
-#endif  // GLOBAL_REG_ALLOCATION
-        // EmitComment("%s", regs[dst]);
-  Emit("addu", Gpr::t8, reg1, reg2);
-  EmitStore(Gpr::t8, Gpr::sp, quad->m_dst->m_offset);  // opt
+#endif  // IMM_OPERANDS
+  auto reg1 = VisitQuadAddr(quad->m_arg1);
+  auto reg2 = VisitQuadAddr(quad->m_arg2);
+  auto dst = DstReg(quad->m_dst);
+  Emit(MO_ADDU, dst, reg1, reg2);
+  GenWriteBack(quad->m_dst, dst);
 }
 
 void CodeGenerator::GenSub(Quadruple *quad)
 {
+#ifdef IMM_OPERANDS
+  if (isimm(quad->m_arg2, -1) && quad->m_arg2->m_data != 0) {
+    auto src = VisitQuadAddr(quad->m_arg1);
+    auto dst = DstReg(quad->m_dst);
+    Emit(MO_ADDIU, dst, src, -quad->m_arg2->m_data);
+    GenWriteBack(quad->m_dst, dst);
+    return;
+  }
+#endif  // IMM_OPERANDS
   auto reg1 = VisitQuadAddr(quad->m_arg1);
   auto reg2 = VisitQuadAddr(quad->m_arg2);
-// auto dst = VisitQuadAddr(quad->m_dst);
-#ifdef GLOBAL_REG_ALLOCATION
-  if (m_curfunc->m_isleaf) {
-    if (quad->m_arg1->m_bind) {
-      reg1 = quad->m_arg1->m_bind;
+  auto dst = DstReg(quad->m_dst);
+  Emit(MO_SUBU, dst, reg1, reg2);
+  GenWriteBack(quad->m_dst, dst);
+}
+
+#ifdef MULDIV_BY_CONST
+// k if `val` is 2^k, else -1
+static int log2exact(unsigned long val)
+{
+  int k = 0;
+  for (; val > 1 && !(val & 1); val >>= 1) {
+    ++k;
+  }
+  return val == 1 ? k : -1;
+}
+
+// literals in the range a constant may be lowered for
+static bool isconst(QuadAddr *qa)
+{
+  return isliteral(qa) && qa->m_data > INT32_MIN && qa->m_data <= INT32_MAX;
+}
+
+// the magic number and shift dividing by `d` by a signed high multiply,
+// see Hacker's Delight, 10-4; |d| >= 2
+static void magic(int32_t d, int32_t &mul, int &shift)
+{
+  const uint32_t two31 = 0x80000000u;
+  uint32_t ad = d < 0 ? -uint32_t(d) : d;
+  uint32_t t = two31 + (uint32_t(d) >> 31);
+  uint32_t anc = t - 1 - t % ad;
+  uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+  uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+  int p = 31;
+  uint32_t delta;
+  do {
+    ++p;
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= anc) {
+      ++q1;
+      r1 -= anc;
+    }
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= ad) {
+      ++q2;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+  mul = int32_t(q2 + 1);
+  if (d < 0) {
+    mul = -mul;
+  }
+  shift = p - 32;
+}
+
+// `src` times `val` by shifts into `dst`, with $v1 for the partial
+// product, if `val` is +-2^a, +-(2^a + 2^b) or +-(2^a - 2^b)
+bool CodeGenerator::GenMultConst(Gpr dst, Gpr src, long val)
+{
+  unsigned long mag = val < 0 ? -val : val;
+  int a = -1, b = -1;
+  bool sub = false;
+  if (log2exact(mag) >= 0) {
+    a = log2exact(mag);
+  }
+  for (int k = 0; k < 31 && a < 0; ++k) {
+    if (log2exact(mag - (1ul << k)) > k) {
+      a = log2exact(mag - (1ul << k));
+      b = k;
+    }
+    else if (log2exact(mag + (1ul << k)) > k + 1) {
+      a = log2exact(mag + (1ul << k));
+      b = k;
+      sub = true;
+    }
+  }
+  if (a < 0 || a > 31) {
+    return false;
+  }
+  EmitComment("times %ld by shifts", val);
+  if (b < 0) {
+    if (a > 0) {
+      Emit(MO_SLL, dst, src, a);
+    }
+    else if (dst != src) {
+      Emit(MO_MOVE, dst, src);
     }
-    if (quad->m_arg2->m_bind) {
-      reg2 = quad->m_arg2->m_bind;
+  }
+  else {
+    Emit(MO_SLL, Gpr::v1, src, a);
+    auto low = src;
+    if (b > 0) {
+      Emit(MO_SLL, dst, src, b);
+      low = dst;
     }
-    if (quad->m_dst->m_bind) {
-      Gpr dst = quad->m_dst->m_bind;
-      Emit("subu", dst, reg1, reg2);
+    if (sub) {
+      Emit(MO_SUBU, dst, Gpr::v1, low);
     }
     else {
-      Emit("subu", Gpr::t8, reg1, reg2);
-      EmitStore(Gpr::t8, Gpr::sp, quad->m_dst->m_offset);  // opt
+      Emit(MO_ADDU, dst, Gpr::v1, low);
     }
-    return;
   }
-#endif  // GLOBAL_REG_ALLOCATION
-  Emit("subu", Gpr::t8, reg1, reg2);
-  EmitStore(Gpr::t8, Gpr::sp, quad->m_dst->m_offset);  // opt
+  if (val < 0) {
+    Emit(MO_SUBU, dst, Gpr::zero, dst);
+  }
+  return true;
 }
 
-void CodeGenerator::GenMult(Quadruple *quad)
+// `src` divided by `val`, rounding toward zero as div does, into `dst`:
+// by shifts for a power of two, else by a high multiply in $v1
+void CodeGenerator::GenDivConst(Gpr dst, Gpr src, long val)
 {
-  auto reg1 = VisitQuadAddr(quad->m_arg1);
-  auto reg2 = VisitQuadAddr(quad->m_arg2);
-// auto dst = VisitQuadAddr(quad->m_dst);
-#ifdef GLOBAL_REG_ALLOCATION
-  if (m_curfunc->m_isleaf) {
-    if (quad->m_arg1->m_bind) {
-      reg1 = quad->m_arg1->m_bind;
+  unsigned long mag = val < 0 ? -val : val;
+  auto k = log2exact(mag);
+  EmitComment("divided by %ld without div", val);
+  if (k == 0) {
+    if (dst != src) {
+      Emit(MO_MOVE, dst, src);
     }
-    if (quad->m_arg2->m_bind) {
-      reg2 = quad->m_arg2->m_bind;
-    }
-    if (quad->m_dst->m_bind) {
-      Gpr dst = quad->m_dst->m_bind;
-      Emit("mul", dst, reg1, reg2);
+  }
+  else if (k > 0) {
+    // a negative dividend is biased by 2^k - 1 first
+    if (k == 1) {
+      Emit(MO_SRL, Gpr::v1, src, 31);
     }
     else {
-      Emit("mul", Gpr::t8, reg1, reg2);
-      EmitStore(Gpr::t8, Gpr::sp, quad->m_dst->m_offset);  // opt
+      Emit(MO_SRA, Gpr::v1, src, 31);
+      Emit(MO_SRL, Gpr::v1, Gpr::v1, 32 - k);
+    }
+    Emit(MO_ADDU, Gpr::v1, src, Gpr::v1);
+    Emit(MO_SRA, dst, Gpr::v1, k);
+  }
+  else {
+    int32_t mul;
+    int shift;
+    magic(val, mul, shift);
+    Emit(MO_LI, Gpr::v1, mul);
+    Emit(MO_MULT, src, Gpr::v1);
+    Emit(MO_MFHI, Gpr::v1);
+    if (val > 0 && mul < 0) {
+      Emit(MO_ADDU, Gpr::v1, Gpr::v1, src);
+    }
+    else if (val < 0 && mul > 0) {
+      Emit(MO_SUBU, Gpr::v1, Gpr::v1, src);
+    }
+    if (shift > 0) {
+      Emit(MO_SRA, Gpr::v1, Gpr::v1, shift);
+    }
+    // plus one if negative
+    Emit(MO_SRL, dst, Gpr::v1, 31);
+    Emit(MO_ADDU, dst, dst, Gpr::v1);
+    return;
+  }
+  if (val < 0) {
+    Emit(MO_SUBU, dst, Gpr::zero, dst);
+  }
+}
+#endif  // MULDIV_BY_CONST
+
+void CodeGenerator::GenMult(Quadruple *quad)
+{
+#ifdef MULDIV_BY_CONST
+  auto arg1 = quad->m_arg1, arg2 = quad->m_arg2;
+  if (isconst(arg1)) {
+    std::swap(arg1, arg2);
+  }
+  if (isconst(arg2) && !isconst(arg1)) {
+    auto src = VisitQuadAddr(arg1);
+    auto dst = DstReg(quad->m_dst);
+    if (!GenMultConst(dst, src, arg2->m_data)) {
+      Emit(MO_MUL, dst, src, VisitQuadAddr(arg2));
     }
+    GenWriteBack(quad->m_dst, dst);
     return;
   }
-#endif  // GLOBAL_REG_ALLOCATION
-  Emit("mul", Gpr::t8, reg1, reg2);
-  EmitStore(Gpr::t8, Gpr::sp, quad->m_dst->m_offset);  // opt
+#endif  // MULDIV_BY_CONST
+  auto reg1 = VisitQuadAddr(quad->m_arg1);
+  auto reg2 = VisitQuadAddr(quad->m_arg2);
+  auto dst = DstReg(quad->m_dst);
+  Emit(MO_MUL, dst, reg1, reg2);
+  GenWriteBack(quad->m_dst, dst);
 }
 
 void CodeGenerator::GenDiv(Quadruple *quad)
 {
+#ifdef MULDIV_BY_CONST
+  if (isconst(quad->m_arg2) && quad->m_arg2->m_data != 0 &&
+      !isconst(quad->m_arg1)) {
+    auto src = VisitQuadAddr(quad->m_arg1);
+    auto dst = DstReg(quad->m_dst);
+    GenDivConst(dst, src, quad->m_arg2->m_data);
+    GenWriteBack(quad->m_dst, dst);
+    return;
+  }
+#endif  // MULDIV_BY_CONST
   auto reg1 = VisitQuadAddr(quad->m_arg1);
   auto reg2 = VisitQuadAddr(quad->m_arg2);
-#ifdef GLOBAL_REG_ALLOCATION
-  if (m_curfunc->m_isleaf) {
-    if (quad->m_arg1->m_bind) {
-      reg1 = quad->m_arg1->m_bind;
-    }
-    if (quad->m_arg2->m_bind) {
-      reg2 = quad->m_arg2->m_bind;
-    }
-    Emit("div", reg1, reg2);
-    if (quad->m_dst->m_bind) {
-      Emit("mflo", quad->m_dst->m_bind);
-    }
-    else {
-      Emit("mflo", Gpr::t8);
-      EmitStore(Gpr::t8, Gpr::sp, quad->m_dst->m_offset);  // opt
-    }
+  auto dst = DstReg(quad->m_dst);
+  Emit(MO_DIV, reg1, reg2);
+  Emit(MO_MFLO, dst);
+  GenWriteBack(quad->m_dst, dst);
+}
+
+// the branch taken on the same condition, the operands swapped
+static QuadOp swapped(QuadOp op)
+{
+  switch (op) {
+  case QuadOp::QO_BLT:
+    return QuadOp::QO_BGT;
+  case QuadOp::QO_BLE:
+    return QuadOp::QO_BGE;
+  case QuadOp::QO_BGT:
+    return QuadOp::QO_BLT;
+  case QuadOp::QO_BGE:
+    return QuadOp::QO_BLE;
+  default:
+    return op;
+  }
+}
+
+/**
+ * @brief A compare and branch. Against a literal, in that order, by a
+ *   branch on the sign of the other side for 0, else by slti to $v1 and
+ *   a branch on it, x > c being !(x < c + 1) and x <= c being x < c + 1.
+ */
+void CodeGenerator::GenBranch(Quadruple *quad)
+{
+  // pseudo-instructions but for beq and bne
+  static const std::map<QuadOp, MOp> branches = {
+    {QuadOp::QO_BLT, MO_BLT}, {QuadOp::QO_BLE, MO_BLE},
+    {QuadOp::QO_BGT, MO_BGT}, {QuadOp::QO_BGE, MO_BGE},
+    {QuadOp::QO_BEQ, MO_BEQ}, {QuadOp::QO_BNE, MO_BNE},
+  };
+  auto op = quad->m_op;
+  auto lhs = quad->m_arg1, rhs = quad->m_arg2;
+  auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
+#ifdef IMM_OPERANDS
+  static const std::map<QuadOp, MOp> signs = {
+    {QuadOp::QO_BLT, MO_BLTZ}, {QuadOp::QO_BLE, MO_BLEZ},
+    {QuadOp::QO_BGT, MO_BGTZ}, {QuadOp::QO_BGE, MO_BGEZ},
+    {QuadOp::QO_BEQ, MO_BEQZ}, {QuadOp::QO_BNE, MO_BNEZ},
+  };
+  if (isliteral(lhs) && !isliteral(rhs)) {
+    std::swap(lhs, rhs);
+    op = swapped(op);
+  }
+  if (isliteral(rhs) && rhs->m_data == 0) {
+    Emit(signs.at(op), VisitQuadAddr(lhs), ls);
+    return;
+  }
+  auto above = op == QuadOp::QO_BGT || op == QuadOp::QO_BLE;
+  if (op != QuadOp::QO_BEQ && op != QuadOp::QO_BNE && isliteral(rhs) &&
+      IsImm16(rhs->m_data + above)) {
+    auto less = op == QuadOp::QO_BLT || op == QuadOp::QO_BLE;
+    Emit(MO_SLTI, Gpr::v1, VisitQuadAddr(lhs), rhs->m_data + above);
+    Emit(less ? MO_BNEZ : MO_BEQZ, Gpr::v1, ls);
     return;
   }
-#endif  // GLOBAL_REG_ALLOCATION
-  Emit("div", reg1, reg2);
-  Emit("mflo", Gpr::t8);
-  EmitStore(Gpr::t8, Gpr::sp, quad->m_dst->m_offset);  // opt
+#endif  // IMM_OPERANDS
+  auto reg1 = VisitQuadAddr(lhs);
+  auto reg2 = VisitQuadAddr(rhs);
+  Emit(branches.at(op), reg1, reg2, ls);
 }
 
 void CodeGenerator::GenPush(Quadruple *quad)
 {
-  auto src = VisitQuadAddr(quad->m_dst);  // TODO switch
 #ifdef REG_ARGS
+  // the first four go in $a0~$a3, their slots are left for the callee
   if (quad->m_arg1->m_data <= 12) {
-    auto reg = Gpr::a0 + (quad->m_arg1->m_data >> 2);
-    Emit("move", (Gpr)(reg), src);
-  }
-  else {
-    EmitStore(src, Gpr::sp, quad->m_arg1->m_data);
+    auto reg = (Gpr)(Gpr::a0 + (quad->m_arg1->m_data >> 2));
+    auto arg = quad->m_dst;
+    if (arg->m_bind == Gpr::zero && (arg->m_type == QuadAddr::AT_INTL ||
+                                     arg->m_type == QuadAddr::AT_CHARL)) {
+      Emit(MO_LI, reg, arg->m_data);
+    }
+    else {
+      Emit(MO_MOVE, reg, VisitQuadAddr(arg));
+    }
+    return;
   }
-#else
+#endif  // REG_ARGS
+  auto src = VisitQuadAddr(quad->m_dst);
   EmitStore(src, Gpr::sp, quad->m_arg1->m_data);
-#endif  //
 }
 
 void CodeGenerator::GenCall(Quadruple *quad)
@@ -391,25 +681,62 @@ void CodeGenerator::GenCall(Quadruple *quad)
   // assume args have been pushed
   debug("Gen Func Call...");
   auto ls = reinterpret_cast<Identifier *>(quad->m_arg1->m_data);
-  Emit("jal", "$func_" + ls->Name() + "_entry");  // @refactor
+  Emit(MO_JAL, "$func_" + ls->Name() + "_entry");  // @refactor
   // auto ret = VisitQuadAddr(quad->m_dst);  // temp
   if (ls->IsNonVoid()) {
-    EmitStore(Gpr::v0, Gpr::sp, quad->m_dst->m_offset);
+    GenWriteBack(quad->m_dst, Gpr::v0);
   }
 }
 
+/**
+ * @brief A call returning what it returns hands its frame over: the
+ *   registers saved are restored, the frame popped and the callee jumped
+ *   to, so that it returns to the caller right away.
+ */
+void CodeGenerator::GenTailCall(Quadruple *quad)
+{
+  auto ls = reinterpret_cast<Identifier *>(quad->m_arg1->m_data);
+  GenEpilogue(m_curfunc->m_frame, false);
+  Emit(MO_J, "$func_" + ls->Name() + "_entry");
+}
+
+static int get_ones(uint32_t n)
+{
+  int cnt = 0;
+  do {
+    if (n & 1)
+      ++cnt;
+  } while (n >>= 1);
+  return cnt;
+}
+
+#ifdef INLINE_EPILOG
+// registers an epilogue restores at most to be copied to a return
+static const int INLINE_RESTORES = 2;
+#endif  // INLINE_EPILOG
+
 void CodeGenerator::GenReturn(Quadruple *quad)
 {
   debug("Gen Func return...");
   if (quad->m_dst) {
     auto reg1 = VisitQuadAddr(quad->m_dst);
-    Emit("move", Gpr::v0, reg1);
+    Emit(MO_MOVE, Gpr::v0, reg1);
+  }
+  if (m_unframed) {
+    Frame none = {0, 0, 0};
+    GenEpilogue(none);
+    return;
   }
 #ifdef INLINE_EPILOG
-  GenEpilogue(m_curfunc->m_frame);
-#else
-  Emit("j", m_curfunc->m_exit_label);
-#endif
+  // a short epilogue in place saves the jump to it, but for the last
+  // return, which the exit follows anyway
+  if (quad != m_curfunc->m_quads.back() &&
+      get_ones(m_curfunc->m_frame.mask) <= INLINE_RESTORES) {
+    GenEpilogue(m_curfunc->m_frame);
+    return;
+  }
+#endif  // INLINE_EPILOG
+  Emit(MO_J, m_curfunc->m_exit_label);
 }
 
 /*
@@ -419,36 +746,36 @@ void CodeGenerator::GenReturn(Quadruple *quad)
  *      la      $a0, mystr_0
  *      li      $v0, 4
  *      syscall
+ *
+ *  the .asciiz left to GenStrings() with STRING_POOL
  */
 void CodeGenerator::EmitPrint(StringLiteral *sl)
 {
+#ifndef STRING_POOL
   EmitDirective(D_DATA);
   Emit(sl->Label() + ": .asciiz \"" + sl->Val() + "\"");
   EmitDirective(D_TEXT);
+#endif  // !STRING_POOL
   EmitSyscall(SC_PRINT_STR, sl->Label());
   EmitBlankLine();
 }
 
 void CodeGenerator::EmitPrint(IntegerLiteral *il)
 {
-  EmitPrint(std::to_string(il->Val()), 1);
+  Emit(MO_LI, Gpr::t8, il->Val());
+  EmitPrint(Gpr::t8, SC_PRINT_INT);
 }
 
 void CodeGenerator::EmitPrint(Identifier *ident)
 {
-  auto name = ident->Name();
   auto sysn = ident->IsChar() ? SC_PRINT_CHAR : SC_PRINT_INT;
-  EmitSyscall(sysn, name);
+  EmitLoad(Gpr::t8, ident->Name());
+  EmitPrint(Gpr::t8, sysn);
 }
 
 void CodeGenerator::EmitPrint(Gpr reg, int sysn)
 {
-  EmitSyscall(sysn, regs[reg]);
-}
-
-void CodeGenerator::EmitPrint(const std::string &arg, int sysn)
-{
-  EmitSyscall(sysn, arg);
+  EmitSyscall(sysn, reg);
 }
 
 void CodeGenerator::EmitPrint(QuadAddr *qa)
@@ -462,39 +789,17 @@ void CodeGenerator::EmitPrint(QuadAddr *qa)
   case QuadAddr::AT_IDENT: {
     auto cast = reinterpret_cast<Identifier *>(qa->m_data);
     auto sysn = cast->IsChar() ? SC_PRINT_CHAR : SC_PRINT_INT;
-    if (qa->m_isglb) {
-      EmitLoad(Gpr::t8, cast->Name());
-    }
-    else {
-#ifdef GLOBAL_REG_ALLOCATION
-      if (m_curfunc->m_isleaf && qa->m_bind) {
-        EmitPrint(qa->m_bind, sysn);
-        break;
-      }
-#endif  // GLOBAL_REG_ALLOCATION
-      EmitLoad(Gpr::t8, Gpr::sp, qa->m_offset);
-    }
-    EmitPrint(Gpr::t8, sysn);
-    break;
-  }
-  case QuadAddr::AT_TMP: {
-    EmitLoad(Gpr::t8, Gpr::sp, qa->m_offset);
-    EmitPrint(Gpr::t8, SC_PRINT_INT);
-    break;
-  }
-  case QuadAddr::AT_TMPCH: {
-    EmitLoad(Gpr::t8, Gpr::sp, qa->m_offset);
-    EmitPrint(Gpr::t8, SC_PRINT_CHAR);
+    EmitPrint(VisitQuadAddr(qa), sysn);
     break;
   }
+  case QuadAddr::AT_TMP:
   case QuadAddr::AT_INTL: {
-    Emit("li", Gpr::t8, qa->m_data);
-    EmitPrint(Gpr::t8, SC_PRINT_INT);
+    EmitPrint(VisitQuadAddr(qa), SC_PRINT_INT);
     break;
   }
+  case QuadAddr::AT_TMPCH:
   case QuadAddr::AT_CHARL: {
-    Emit("li", Gpr::t8, qa->m_data);
-    EmitPrint(Gpr::t8, SC_PRINT_CHAR);
+    EmitPrint(VisitQuadAddr(qa), SC_PRINT_CHAR);
     break;
   }
   case QuadAddr::AT_ARRAY: {
@@ -512,7 +817,7 @@ void CodeGenerator::EmitScanf(Identifier *ident)
 {
   auto sysn =
     ident->IsInt() ? SC_READ_INT : ident->IsChar() ? SC_READ_CHAR : SC_READ_INT;
-  EmitSyscall(sysn, ident->Name());
+  EmitSyscall(sysn, Gpr::v0);
   EmitStore(Gpr::v0, ident->Name());
   assert(0);
   // if (m_curfunc->m_isleaf)
@@ -524,19 +829,8 @@ void CodeGenerator::EmitScanf(QuadAddr *qa)
   assert(qa->m_type == QuadAddr::AT_IDENT);
   auto ident = reinterpret_cast<Identifier *>(qa->m_data);
   auto sysn = ident->IsChar() ? SC_READ_CHAR : SC_READ_INT;
-  if (qa->m_isglb) {
-    EmitSyscall(sysn, ident->Name());
-    EmitStore(Gpr::v0, ident->Name());
-  }
-  else {
-    EmitSyscall(sysn, std::to_string(qa->m_offset) + "($sp)");
-    EmitStore(Gpr::v0, std::to_string(qa->m_offset) + "($sp)");
-#ifdef GLOBAL_REG_ALLOCATION
-    if (m_curfunc->m_isleaf && qa->m_bind) {
-      Emit("move", qa->m_bind, Gpr::v0);
-    }
-#endif
-  }
+  EmitSyscall(sysn, Gpr::v0);
+  GenWriteBack(qa, Gpr::v0);
 }
 
 void CodeGenerator::EmitQuad(Quadruple *quad)
@@ -586,75 +880,49 @@ void CodeGenerator::EmitQuad(Quadruple *quad)
   }
   case QuadOp::QO_GOTO: {
     auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("j", ls->Repr());
+    Emit(MO_J, ls->Repr());
     break;
   }
   case QuadOp::QO_BZ: {
     auto reg1 = VisitQuadAddr(quad->m_arg1);
     auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("beqz", reg1, ls);
+    Emit(MO_BEQZ, reg1, ls);
     break;
   }
   case QuadOp::QO_BNZ: {
     auto reg1 = VisitQuadAddr(quad->m_arg1);
     auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("bnez", reg1, ls);
-    break;
-  }
-  case QuadOp::QO_BLT: {
-    auto reg1 = VisitQuadAddr(quad->m_arg1);
-    auto reg2 = VisitQuadAddr(quad->m_arg2);
-    auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("blt", reg1, reg2, ls);
-    break;
-  }
-  case QuadOp::QO_BLE: {
-    auto reg1 = VisitQuadAddr(quad->m_arg1);
-    auto reg2 = VisitQuadAddr(quad->m_arg2);
-    auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("ble", reg1, reg2, ls);
-    break;
-  }
-  case QuadOp::QO_BGT: {
-    auto reg1 = VisitQuadAddr(quad->m_arg1);
-    auto reg2 = VisitQuadAddr(quad->m_arg2);
-    auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("bgt", reg1, reg2, ls);
-    break;
-  }
-  case QuadOp::QO_BGE: {
-    auto reg1 = VisitQuadAddr(quad->m_arg1);
-    auto reg2 = VisitQuadAddr(quad->m_arg2);
-    auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("bge", reg1, reg2, ls);
-    break;
-  }
-  case QuadOp::QO_BEQ: {
-    auto reg1 = VisitQuadAddr(quad->m_arg1);
-    auto reg2 = VisitQuadAddr(quad->m_arg2);
-    auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("beq", reg1, reg2, ls);
+    Emit(MO_BNEZ, reg1, ls);
     break;
   }
-  case QuadOp::QO_BNE: {
-    auto reg1 = VisitQuadAddr(quad->m_arg1);
-    auto reg2 = VisitQuadAddr(quad->m_arg2);
-    auto ls = reinterpret_cast<LabelStmt *>(quad->m_dst->m_data);
-    Emit("bne", reg1, reg2, ls);
+  case QuadOp::QO_BLT:
+  case QuadOp::QO_BLE:
+  case QuadOp::QO_BGT:
+  case QuadOp::QO_BGE:
+  case QuadOp::QO_BEQ:
+  case QuadOp::QO_BNE:
+    GenBranch(quad);
     break;
-  }
   case QuadOp::QO_PARAM: {
 #ifdef REG_ARGS
-    auto reg = (Gpr)(m_curfunc->m_parmnum + Gpr::a0);
-    ++m_curfunc->m_parmnum;
-    Emit("move", quad->m_dst->m_bind, reg);
-    if (!m_curfunc->m_isleaf) {
-      EmitStore(reg, Gpr::sp, quad->m_dst->m_offset);
+    auto index = m_curfunc->m_parmnum++;
+    if (index < 4) {
+      // kept where it came, moved to its register or homed in its slot
+      auto reg = (Gpr)(Gpr::a0 + index);
+      if (quad->m_dst->m_bind == Gpr::zero) {
+        EmitStore(reg, Gpr::sp, quad->m_dst->m_offset);
+      }
+      else if (quad->m_dst->m_bind != reg) {
+        Emit(MO_MOVE, quad->m_dst->m_bind, reg);
+      }
+      break;
     }
-    break;
-#else
-    break;
 #endif  // REG_ARGS
+    // the caller left it in its argument building area
+    if (quad->m_dst->m_bind != Gpr::zero) {
+      EmitLoad(quad->m_dst->m_bind, Gpr::sp, quad->m_dst->m_offset);
+    }
+    break;
   }
   default:
     debug("Not support QuadOp::%d yet!\n", quad->m_op);
@@ -663,16 +931,6 @@ void CodeGenerator::EmitQuad(Quadruple *quad)
   }
 }
 
-static int get_ones(uint32_t n)
-{
-  int cnt = 0;
-  do {
-    if (n & 1)
-      ++cnt;
-  } while (n >>= 1);
-  return cnt;
-}
-
 void CodeGenerator::GenPrologue(Frame &frame)
 {
   auto frame_size = frame.size;
@@ -689,7 +947,7 @@ void CodeGenerator::GenPrologue(Frame &frame)
         frame_mask);
   assert(frame_size >= save_size);
 
-  Emit("addiu", Gpr::sp, Gpr::sp, -frame_size);
+  Emit(MO_ADDIU, Gpr::sp, Gpr::sp, -frame_size);
   long size = frame_size - 4;
   for (auto i = 31; i >= 0 && size >= frame_size - save_size; --i) {
     auto bit = (frame_mask >> i) & 1;
@@ -701,13 +959,15 @@ void CodeGenerator::GenPrologue(Frame &frame)
   // Emit("move", Gpr::fp, Gpr::sp);
 }
 
-void CodeGenerator::GenEpilogue(Frame &frame)
+void CodeGenerator::GenEpilogue(Frame &frame, bool ret)
 {
   auto frame_size = frame.size;
   auto frame_mask = frame.mask;
   if (!frame_size) {
     EmitComment("Empty frame, no Epilogue!");
-    Emit("jr", Gpr::ra);
+    if (ret) {
+      Emit(MO_JR, Gpr::ra);
+    }
     return;
   }
   EmitComment(".epilogue");
@@ -725,33 +985,369 @@ void CodeGenerator::GenEpilogue(Frame &frame)
       size += 4;
     }
   }
-  Emit("addiu", Gpr::sp, Gpr::sp, frame_size);
-  Emit("jr", Gpr::ra);
+  Emit(MO_ADDIU, Gpr::sp, Gpr::sp, frame_size);
+  if (ret) {
+    Emit(MO_JR, Gpr::ra);
+  }
+}
+
+#ifdef TAIL_CALLS
+/**
+ * @brief Whether the call at `i` is in tail position, followed by nothing
+ *   but a return of its result, with its arguments passed in registers
+ *   only: the frame they would go in is popped before the callee runs.
+ *   The callee homes them in the area our caller built our own in, so it
+ *   takes no more arguments than we do.
+ */
+static bool istailcall(const FuncInfo::QuadList &quads, size_t i)
+{
+  size_t params = 0;
+  while (params < quads.size() && quads[params]->m_op == QO_PARAM) {
+    ++params;
+  }
+  size_t args = 0;
+  for (auto j = i; j-- > 0 && quads[j]->m_op == QO_PUSH; ++args) {
+#ifdef REG_ARGS
+    if (quads[j]->m_arg1->m_data > 12) {
+      return false;
+    }
+#else
+    return false;
+#endif  // REG_ARGS
+  }
+  if (args > params) {
+    return false;
+  }
+  if (i + 1 == quads.size()) {
+    return true;
+  }
+  auto next = quads[i + 1];
+  return next->m_op == QO_RETURN &&
+         (!next->m_dst || next->m_dst == quads[i]->m_dst);
+}
+#endif  // TAIL_CALLS
+
+#ifdef SHRINK_WRAP
+/**
+ * @brief Whether `func` may return early without a frame: its first
+ *   conditional branch at `branch`, falling through to a return at `ret`,
+ *   both after the parameters and only with calls, prints, labels, locals
+ *   in memory or registers to be saved nowhere on the way.
+ */
+static bool earlyreturn(FuncInfo *func, size_t &branch, size_t &ret)
+{
+  auto &quads = func->m_quads;
+  std::set<QuadAddr *> params;
+  size_t i = 0;
+  for (; i < quads.size() && quads[i]->m_op == QO_PARAM; ++i) {
+#ifdef REG_ARGS
+    // read from their argument registers, moved home after the prologue
+    if (i < 4) {
+      params.insert(quads[i]->m_dst);
+    }
+#endif  // REG_ARGS
+  }
+  std::function<bool(QuadAddr *)> unframed = [&](QuadAddr *qa) {
+    if (!qa || qa->m_type == QuadAddr::AT_INTL ||
+        qa->m_type == QuadAddr::AT_CHARL || qa->m_type == QuadAddr::AT_LABEL) {
+      return true;
+    }
+    if (qa->m_type == QuadAddr::AT_ARRAY) {
+      return qa->m_isglb && unframed(qa->m_minion);
+    }
+    if (qa->m_type == QuadAddr::AT_STR) {
+      return false;
+    }
+    if (qa->m_isglb || params.count(qa)) {
+      return true;
+    }
+    return qa->m_bind != Gpr::zero && !((func->m_frame.mask >> qa->m_bind) & 1);
+  };
+  branch = 0;
+  for (; i < quads.size(); ++i) {
+    auto quad = quads[i];
+    switch (quad->m_op) {
+    case QO_LABEL:
+    case QO_GOTO:
+    case QO_PARAM:
+    case QO_PRINT:
+    case QO_SCAN:
+    case QO_PUSH:
+    case QO_CALL:
+      return false;
+    default:
+      break;
+    }
+    if (!unframed(quad->m_dst) || !unframed(quad->m_arg1) ||
+        !unframed(quad->m_arg2)) {
+      return false;
+    }
+    if (IsCondBranch(quad->m_op)) {
+      if (branch) {
+        return false;
+      }
+      branch = i;
+    }
+    else if (quad->m_op == QO_RETURN) {
+      ret = i;
+      return branch != 0;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Shrink-wrapping of a function returning early: the quads up to
+ *   that return run before the prologue, parameters read from where they
+ *   came, and the branch past it goes to the prologue, the parameters
+ *   moved home and on to where it went. Returns the quads generated, 0 if
+ *   the function does not return early that way.
+ */
+size_t CodeGenerator::GenEarlyReturn()
+{
+  auto &quads = m_curfunc->m_quads;
+  size_t branch, ret;
+  if (!m_curfunc->m_frame.size || !earlyreturn(m_curfunc, branch, ret)) {
+    return 0;
+  }
+  std::map<QuadAddr *, Gpr> binds;
+  for (size_t i = 0; i < quads.size() && quads[i]->m_op == QO_PARAM; ++i) {
+    binds[quads[i]->m_dst] = quads[i]->m_dst->m_bind;
+#ifdef REG_ARGS
+    if (i < 4) {
+      quads[i]->m_dst->m_bind = (Gpr)(Gpr::a0 + i);
+    }
+#endif  // REG_ARGS
+  }
+  auto framed = m_curfunc->NewLabel();
+  m_unframed = true;
+  for (auto i = binds.size(); i <= ret; ++i) {
+    auto quad = quads[i];
+    EmitComment("%s", quad->Str().c_str());
+    if (i == branch) {
+      EmitQuad(
+        Quadruple::New(quad->m_op, framed, quad->m_arg1, quad->m_arg2));
+    }
+    else {
+      EmitQuad(quad);
+    }
+  }
+  m_unframed = false;
+  for (auto &bind : binds) {
+    bind.first->m_bind = bind.second;
+  }
+
+  EmitQuad(Quadruple::New(QO_LABEL, framed));
+  GenPrologue(m_curfunc->m_frame);
+  for (size_t i = 0; i < binds.size(); ++i) {
+    EmitComment("%s", quads[i]->Str().c_str());
+    EmitQuad(quads[i]);
+  }
+  Emit(MO_J, JumpTarget(quads[branch])->Repr());
+  return ret + 1;
+}
+#endif  // SHRINK_WRAP
+
+#ifdef PRINT_BATCHING
+// what printing the literal of `quad` puts out, empty if nothing to batch
+static std::string printtext(Quadruple *quad)
+{
+  if (quad->m_op != QO_PRINT) {
+    return "";
+  }
+  auto qa = quad->m_dst;
+  switch (qa->m_type) {
+  case QuadAddr::AT_STR:
+    return reinterpret_cast<StringLiteral *>(qa->m_data)->Val();
+  case QuadAddr::AT_INTL:
+    return std::to_string(static_cast<int>(qa->m_data));
+  case QuadAddr::AT_CHARL: {
+    auto ch = static_cast<char>(qa->m_data);
+    if (!isprint(ch) || ch == '"' || ch == '\\') {
+      return "";
+    }
+    return std::string(1, ch);
+  }
+  default:
+    return "";
+  }
 }
 
+/**
+ * @brief Count the prints of literals in a row from quad `i` of `func`,
+ *   two or more put out as one string: `text`, labelled `label`.
+ */
+static size_t printrun(FuncInfo *func, size_t i, std::string &label,
+                       std::string &text)
+{
+  auto &quads = func->m_quads;
+  size_t n = 0;
+  text.clear();
+  for (; i + n < quads.size(); ++n) {
+    auto piece = printtext(quads[i + n]);
+    if (piece.empty()) {
+      break;
+    }
+    text += piece;
+  }
+  label = "strlabel_" + func->Name() + "_" + std::to_string(i);
+  return n;
+}
+
+// the prints of literals from quad `i` on by one syscall, how many if any
+size_t CodeGenerator::GenPrintRun(size_t i)
+{
+  std::string label, text;
+  auto n = printrun(m_curfunc, i, label, text);
+  if (n < 2) {
+    return 0;
+  }
+  for (size_t k = 1; k < n; ++k) {
+    EmitComment("%s", m_curfunc->m_quads[i + k]->Str().c_str());
+  }
+  EmitSyscall(SC_PRINT_STR, label);
+  EmitBlankLine();
+  return n;
+}
+#endif  // PRINT_BATCHING
+
 void CodeGenerator::GenFunc(FuncInfo *func_info)
 {
   m_curfunc = func_info;
+  m_reg = Gpr::t8;
   auto name = m_curfunc->Name();
   Emit("\n################### " + name + " ###################", 0);
+  MInstList code;
+  m_code = &code;
   EmitLabel(m_curfunc->m_entry_label);
-  GenPrologue(m_curfunc->m_frame);
+  size_t start = 0;
+#ifdef SHRINK_WRAP
+  start = GenEarlyReturn();
+#endif  // SHRINK_WRAP
+  if (!start) {
+    GenPrologue(m_curfunc->m_frame);
+  }
   // GenCopyParams();
 
-  for (auto quad : m_curfunc->m_quads) {
-    EmitComment(quad->Str().c_str());
-    debug(quad->Str().c_str());
+  auto &quads = m_curfunc->m_quads;
+  for (size_t i = start; i < quads.size(); ++i) {
+    auto quad = quads[i];
+    EmitComment("%s", quad->Str().c_str());
+    debug("%s", quad->Str().c_str());
+#ifdef TAIL_CALLS
+    if (quad->m_op == QO_CALL && istailcall(quads, i)) {
+      GenTailCall(quad);
+      i += i + 1 < quads.size();  // the return, left to the callee
+      continue;
+    }
+#endif  // TAIL_CALLS
+#ifdef PRINT_BATCHING
+    if (auto n = GenPrintRun(i)) {
+      i += n - 1;
+      continue;
+    }
+#endif  // PRINT_BATCHING
     EmitQuad(quad);
   }
 
+#ifdef BLOCK_LAYOUT
+  // the exit only if a return jumps there or the code falls into it
+  auto &exit = m_curfunc->m_exit_label;
+  auto last = std::find_if(code.rbegin(), code.rend(),
+                           [](MInst &inst) { return inst.m_op != MO_NOTE; });
+  if (last != code.rend() && last->m_op == MO_J && last->m_label == exit) {
+    code.erase(std::next(last).base());
+    last = std::find_if(code.rbegin(), code.rend(),
+                        [](MInst &inst) { return inst.m_op != MO_NOTE; });
+  }
+  bool named = std::any_of(code.begin(), code.end(), [&exit](MInst &inst) {
+    return inst.IsInst() && inst.m_label == exit;
+  });
+  if (named) {
+    EmitLabel(exit);
+  }
+  if (named || last == code.rend() ||
+      (last->m_op != MO_J && last->m_op != MO_JR)) {
+    GenEpilogue(m_curfunc->m_frame);
+  }
+#else
   EmitLabel(m_curfunc->m_exit_label);
   GenEpilogue(m_curfunc->m_frame);
+#endif  // BLOCK_LAYOUT
+  Flush();
   Emit("\n# ^^^^^^^^^^^^^^^^^^ " + name + " ^^^^^^^^^^^^^^^^^^", 0);
 }
 
-void CodeGenerator::Gen()
+// main goes first and inline, returning by exit(10)
+void CodeGenerator::GenMain(FuncInfo *func_info)
+{
+  m_curfunc = func_info;
+  m_reg = Gpr::t8;
+  MInstList code;
+  m_code = &code;
+  auto &quads = m_curfunc->m_quads;
+  for (size_t i = 0; i < quads.size(); ++i) {
+    auto quad = quads[i];
+    if (quad->m_op == QuadOp::QO_RETURN) {
+      EmitSyscall(10);
+      continue;
+    }
+    EmitComment("%s", quad->Str().c_str());
+    debug("%s", quad->Str().c_str());
+#ifdef PRINT_BATCHING
+    if (auto n = GenPrintRun(i)) {
+      i += n - 1;
+      continue;
+    }
+#endif  // PRINT_BATCHING
+    EmitQuad(quad);
+  }
+  EmitSyscall(10);
+  Flush();
+}
+
+/**
+ * @brief Print the instructions held back in m_code once the peephole
+ *   pass, the scheduler and the delay slot filling have gone over them,
+ *   with what each did.
+ */
+void CodeGenerator::Flush()
+{
+  auto code = m_code;
+  m_code = nullptr;
+#ifdef PEEPHOLE
+  std::map<std::string, int> removed;
+  Peephole(*code, removed);
+#endif  // PEEPHOLE
+#ifdef SCHEDULING
+  auto stalls = ScheduleLoads(*code);
+#endif  // SCHEDULING
+  int filled = 0, nops = 0;
+  if (DelaySlots()) {
+    filled = FillDelaySlots(*code, nops);
+  }
+  for (auto &inst : *code) {
+    Put(inst);
+  }
+#ifdef PEEPHOLE
+  for (auto &rule : removed) {
+    EmitComment("peephole %s: %d removed", rule.first.c_str(), rule.second);
+  }
+#endif  // PEEPHOLE
+#ifdef SCHEDULING
+  if (stalls) {
+    EmitComment("scheduling: %d load-use stall%s avoided", stalls,
+                stalls > 1 ? "s" : "");
+  }
+#endif  // SCHEDULING
+  if (filled || nops) {
+    EmitComment("delay slots: %d filled, %d nop%s", filled, nops,
+                nops == 1 ? "" : "s");
+  }
+}
+
+void CodeGenerator::GenData()
 {
-  // TestGen();
   Emit("########## MIPS Assembly Code generated by c0c ##########", 0);
   // EmitDirective(D_TEXT);
   // Emit("j", "$func_main_entry");
@@ -761,26 +1357,204 @@ void CodeGenerator::Gen()
   for (auto entry : m_qg->m_data_entries) {
     Emit(entry->Repr());
   }
+#ifdef STRING_POOL
+  GenStrings();
+#endif  // STRING_POOL
 
   EmitDirective(D_TEXT);
+}
+
+#ifdef STRING_POOL
+// whether `str` may be cut at `pos`, not inside an escape sequence
+static bool cuttable(const std::string &str, size_t pos)
+{
+  size_t i = 0;
+  while (i < pos) {
+    i += str[i] == '\\' ? 2 : 1;
+  }
+  return i == pos;
+}
+
+/**
+ * @brief The strings the functions print, each text once: the labels of
+ *   literals alike go on the same .asciiz, and a text ending a longer one
+ *   gets its labels inside that one, cut there into .ascii pieces. With
+ *   PRINT_BATCHING the literals printed in a row count as one text.
+ */
+void CodeGenerator::GenStrings()
+{
+  std::vector<std::string> texts;  // in order of first use
+  std::map<std::string, std::vector<std::string>> labels;
+  std::set<std::string> seen;
+  auto add = [&](const std::string &label, const std::string &text) {
+    if (!seen.insert(label).second) {
+      return;
+    }
+    auto &names = labels[text];
+    if (names.empty()) {
+      texts.push_back(text);
+    }
+    names.push_back(label);
+  };
+  for (auto func : m_qg->m_funcs) {
+    auto &quads = func->m_quads;
+    for (size_t i = 0; i < quads.size(); ++i) {
+#ifdef PRINT_BATCHING
+      std::string label, text;
+      auto n = printrun(func, i, label, text);
+      if (n > 1) {
+        add(label, text);
+        i += n - 1;
+        continue;
+      }
+#endif  // PRINT_BATCHING
+      auto quad = quads[i];
+      if (quad->m_op != QO_PRINT || quad->m_dst->m_type != QuadAddr::AT_STR) {
+        continue;
+      }
+      auto sl = reinterpret_cast<StringLiteral *>(quad->m_dst->m_data);
+      add(sl->Label(), sl->Val());
+    }
+  }
+
+  // longest first, so that a text ends one laid out already if any
+  auto bylength = texts;
+  std::stable_sort(bylength.begin(), bylength.end(),
+                   [](const std::string &a, const std::string &b) {
+                     return a.size() > b.size();
+                   });
+  std::vector<std::string> whole;
+  std::set<std::string> inside;
+  std::map<std::string, std::map<size_t, std::string>> cuts;
+  for (auto &text : bylength) {
+    for (auto &host : whole) {
+      auto pos = host.size() - text.size();
+      if (!host.compare(pos, text.size(), text) && cuttable(host, pos)) {
+        cuts[host][pos] = text;
+        inside.insert(text);
+        break;
+      }
+    }
+    if (!inside.count(text)) {
+      whole.push_back(text);
+    }
+  }
+
+  auto piece = [this](const std::vector<std::string> &names, const char *dir,
+                      const std::string &text) {
+    for (size_t i = 0; i + 1 < names.size(); ++i) {
+      Emit(names[i] + ":");
+    }
+    Emit(names.back() + ": " + dir + " \"" + text + "\"");
+  };
+  for (auto &text : texts) {
+    if (inside.count(text)) {
+      continue;
+    }
+    size_t from = 0;
+    auto names = &labels[text];
+    for (auto &cut : cuts[text]) {
+      piece(*names, ".ascii", text.substr(from, cut.first - from));
+      from = cut.first;
+      names = &labels[cut.second];
+    }
+    piece(*names, ".asciiz", text.substr(from));
+  }
+}
+#endif  // STRING_POOL
+
+void CodeGenerator::Gen()
+{
+  // TestGen();
+  GenData();
   // for (auto func : m_qg->m_funcs) {
   //     GenFunc(func);
   // }
-  m_curfunc = *(m_qg->m_funcs.end() - 1);  // main
-  for (auto quad : m_curfunc->m_quads) {
-    if (quad->m_op == QuadOp::QO_RETURN) {
-      EmitSyscall(10);
+  GenMain(*(m_qg->m_funcs.end() - 1));
+
+  for (auto it = m_qg->m_funcs.end() - 2; it >= m_qg->m_funcs.begin(); --it) {
+    GenFunc(*it);
+  }
+}
+
+/**
+ * @brief Same output as QuadGenerator::Gen() followed by Gen(), but every
+ *   function is generated by tasks of its own: its quads first, then,
+ *   once the quads of all are there to be inlined, the passes, offsets
+ *   and assembly. Each task prints to buffers of its own, which are then
+ *   written out in the sequential order. Labels and the strings made up
+ *   for the quads are numbered per function, whatever task makes them.
+ */
+void CodeGenerator::Gen(unsigned jobs)
+{
+  struct Output {
+    FuncInfo *info;
+    char *quads;
+    size_t quads_len;
+    char *passes;
+    size_t passes_len;
+    char *mips;
+    size_t mips_len;
+  };
+
+  m_qg->GenGlobals();
+
+  std::vector<FunctionDecl *> funcs;
+  for (auto decl : m_parser->Unit()->ExtDecls()) {
+    funcs.push_back(static_cast<FunctionDecl *>(decl));
+  }
+  std::vector<Output> outputs(funcs.size());
+  {
+    ThreadPool pool(jobs);
+    for (size_t i = 0; i < funcs.size(); ++i) {
+      pool.Submit([=, &funcs, &outputs] {
+        auto &out = outputs[i];
+        auto quads_fp = open_memstream(&out.quads, &out.quads_len);
+        out.info = m_qg->GenFunction(funcs[i], quads_fp);
+        fclose(quads_fp);
+      });
     }
-    else {
-      EmitComment(quad->Str().c_str());
-      debug(quad->Str().c_str());
-      EmitQuad(quad);
+    pool.Wait();
+
+    for (size_t i = 0; i < funcs.size(); ++i) {
+      m_qg->m_bodies[funcs[i]->Name()] = outputs[i].info->m_body;
     }
+    for (size_t i = 0; i < funcs.size(); ++i) {
+      bool ismain = i + 1 == funcs.size();
+
+      pool.Submit([=, &outputs] {
+        auto &out = outputs[i];
+        auto passes_fp = open_memstream(&out.passes, &out.passes_len);
+        m_qg->OptimizeFunction(out.info, passes_fp);
+        fclose(passes_fp);
+
+        auto mips_fp = open_memstream(&out.mips, &out.mips_len);
+        CodeGenerator generator(m_parser, m_qg, mips_fp);
+        if (ismain) {
+          generator.GenMain(out.info);
+        }
+        else {
+          generator.GenFunc(out.info);
+        }
+        fclose(mips_fp);
+      });
+    }
+    pool.Wait();
   }
-  EmitSyscall(10);
 
-  for (auto it = m_qg->m_funcs.end() - 2; it >= m_qg->m_funcs.begin(); --it) {
-    GenFunc(*it);
+  for (auto &out : outputs) {
+    m_qg->m_funcs.push_back(out.info);
+    fwrite(out.quads, 1, out.quads_len, m_qg->OutStream());
+    fwrite(out.passes, 1, out.passes_len, m_qg->OutStream());
+    free(out.quads);
+    free(out.passes);
+  }
+  // the data of all functions, written first
+  GenData();
+  // main first, then the others backwards
+  for (size_t i = outputs.size(); i-- > 0;) {
+    fwrite(outputs[i].mips, 1, outputs[i].mips_len, m_outstream);
+    free(outputs[i].mips);
   }
 }
 
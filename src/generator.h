@@ -3,6 +3,7 @@
 
 #include "ast.h"
 #include "mips_isa.h"
+#include "peephole.h"
 #include "visitor.h"
 
 #include <map>
@@ -32,94 +33,77 @@ public:
     m_parser = parser;
     m_outstream = outFile;
   }
-
-protected:
-  void Emit(const std::string &str, unsigned indent = 4)
+  FILE *OutStream() const
   {
-    for (; indent > 0; indent = indent - 4) {
-      fprintf(m_outstream, "    ");
-      // debug("    ");
-    }
-    fprintf(m_outstream, "%s\n", str.c_str());
-    // debug("%s\n", str.c_str());
+    return m_outstream;
   }
+
+protected:
+  void Emit(const std::string &str, unsigned indent = 4);
   void EmitComment(const char *format, ...);
 
   void EmitBlankLine()
   {
-    fputc('\n', m_outstream);
-    // debug("\n");
-  }
-
-  void Emit(const std::string &inst, const std::string &dst)
-  {
-    fprintf(m_outstream, "    %-12s%s\n", inst.c_str(), dst.c_str());
-    // debug("    %-12s%s\n", inst.c_str(), dst.c_str());
-  }
-  void Emit(const std::string &inst, Gpr dst)
-  {
-    Emit(inst, regs[dst]);
+    Put(MInst::Line(MO_NOTE, ""));
   }
 
-  void
-  Emit(const std::string &inst, const std::string &dst, const std::string &src)
+  // operands in the order assembly lists them
+  void Emit(MOp op)
   {
-    fprintf(m_outstream, "    %-12s%s, %s\n", inst.c_str(), dst.c_str(),
-            src.c_str());
-    // debug("    %-12s%s, %s\n", inst.c_str(), dst.c_str(), src.c_str());
+    Put(MInst(op, {}));
   }
-  void Emit(const std::string &inst, Gpr dst, Gpr src)
+  void Emit(MOp op, Gpr reg)
   {
-    Emit(inst, regs[dst], regs[src]);
+    Put(MInst(op, {reg}));
   }
-  void Emit(const std::string &inst, const std::string &dst, Gpr src)
+  void Emit(MOp op, Gpr reg1, Gpr reg2)
   {
-    Emit(inst, dst, regs[src]);
+    Put(MInst(op, {reg1, reg2}));
   }
-  void Emit(const std::string &inst, Gpr dst, const std::string &src)
+  void Emit(MOp op, Gpr reg1, Gpr reg2, Gpr reg3)
   {
-    Emit(inst, regs[dst], src);
+    Put(MInst(op, {reg1, reg2, reg3}));
   }
-  void Emit(const std::string &inst, Gpr dst, long imm)
+  void Emit(MOp op, Gpr reg, long imm)
   {
-    Emit(inst, regs[dst], std::to_string(imm));
+    Put(MInst(op, {reg}, imm));
   }
-  void Emit(const std::string &inst, const std::string &dst, long imm)
+  void Emit(MOp op, Gpr reg1, Gpr reg2, long imm)
   {
-    Emit(inst, dst, std::to_string(imm));
+    Put(MInst(op, {reg1, reg2}, imm));
   }
-
-  void Emit(const std::string &inst,
-            const std::string &dst,
-            const std::string &src1,
-            const std::string &src2)
+  void Emit(MOp op, const std::string &label)
   {
-    fprintf(m_outstream, "    %-12s%s, %s, %s\n", inst.c_str(), dst.c_str(),
-            src1.c_str(), src2.c_str());
-    // debug("    %-12s%s, %s, %s\n", inst.c_str(), dst.c_str(),
-    // src1.c_str(),
-    //       src2.c_str());
+    Put(MInst(op, {}, 0, label));
   }
-  void Emit(const std::string &inst, Gpr src1, LabelStmt *label)
+  void Emit(MOp op, Gpr reg, const std::string &label)
   {
-    Emit(inst, regs[src1], label->Repr());
+    Put(MInst(op, {reg}, 0, label));
   }
-  void Emit(const std::string &inst, Gpr src1, Gpr src2, LabelStmt *label)
+  void Emit(MOp op, Gpr reg, LabelStmt *label)
   {
-    Emit(inst, regs[src1], regs[src2], label->Repr());
+    Emit(op, reg, label->Repr());
   }
-  void Emit(const std::string &inst, Gpr dst, Gpr src1, Gpr src2)
+  void Emit(MOp op, Gpr reg1, Gpr reg2, LabelStmt *label)
   {
-    Emit(inst, regs[dst], regs[src1], regs[src2]);
+    Put(MInst(op, {reg1, reg2}, 0, label->Repr()));
   }
-  void Emit(const std::string &inst, Gpr dst, Gpr src, long imm)
+
+  // printed right away, or held back in m_code if set
+  void Put(const MInst &inst)
   {
-    Emit(inst, regs[dst], regs[src], std::to_string(imm));
+    if (m_code) {
+      m_code->push_back(inst);
+    }
+    else {
+      fprintf(m_outstream, "%s\n", inst.Str().c_str());
+    }
   }
 
 protected:
   Parser *m_parser;
   FILE *m_outstream;
+  MInstList *m_code{nullptr};  // instructions held back for the passes
 };
 
 class CodeGenerator : public Generator {
@@ -136,13 +120,22 @@ public:
   }
 
   void Gen();
+  // quads and assembly of every function generated on `jobs` threads
+  void Gen(unsigned jobs);
   void TestGen();
 
 protected:
   Gpr VisitQuadAddr(QuadAddr *qa);
   void GenPrologue(Frame &frame);
-  void GenEpilogue(Frame &frame);
+  // jumps back unless `ret` is false, for a tail call to jump on instead
+  void GenEpilogue(Frame &frame, bool ret = true);
+  void GenData();
+  void GenStrings();
+  void GenMain(FuncInfo *func_info);
   void GenFunc(FuncInfo *func_info);
+  size_t GenEarlyReturn();
+  size_t GenPrintRun(size_t i);
+  void Flush();
   void Gen(IdentTab &idtab);
   // Binary
   // void GenCommaOp(BinaryOp *comma);
@@ -153,14 +146,21 @@ protected:
   // void GenSubOp(BinaryOp *binaryOp);
   // void GenCastOp(UnaryOp *cast);
   // void GenDerefOp(UnaryOp *deref);
+  // register to compute `dst` into: its own, or a scratch one
+  Gpr DstReg(QuadAddr *dst);
+  void GenWriteBack(QuadAddr *dst, Gpr src);
   void GenAssign(QuadAddr *dst, QuadAddr *arg1);
   void GenAdd(Quadruple *quad);
   void GenSub(Quadruple *quad);
   void GenDiv(Quadruple *quad);
   void GenMult(Quadruple *quad);
+  bool GenMultConst(Gpr dst, Gpr src, long val);
+  void GenDivConst(Gpr dst, Gpr src, long val);
 
+  void GenBranch(Quadruple *quad);
   void GenPush(Quadruple *quad);
   void GenCall(Quadruple *quad);
+  void GenTailCall(Quadruple *quad);
   void GenReturn(Quadruple *quad);
 
   // void GenCompOp(int width, bool flt, const char *set);
@@ -181,28 +181,29 @@ protected:
   void EmitStore(const std::string &addr, Type *type);
   void EmitStore(Gpr src, const std::string &label)
   {
-    Emit("sw", regs[src], label);
+    Put(MInst(MO_SW, {src}, 0, label));
   }
   void EmitStore(Gpr src, Gpr base, int imm = 0)
   {
-    Emit("sw", regs[src], std::to_string(imm) + "(" + regs[base] + ")");
+    Put(MInst(MO_SW, {src, base}, imm));
   }
-  void EmitStore(Gpr src, Gpr base, const std::string &label)
+  void
+  EmitStore(Gpr src, Gpr base, const std::string &label, int imm = 0)
   {
-    Emit("sw", regs[src], label + "(" + regs[base] + ")");
+    Put(MInst(MO_SW, {src, base}, imm, label));
   }
 
   void EmitLoad(Gpr dst, const std::string &label)
   {
-    Emit("lw", regs[dst], label);
+    Put(MInst(MO_LW, {dst}, 0, label));
   }
   void EmitLoad(Gpr dst, Gpr base, int imm = 0)
   {
-    Emit("lw", regs[dst], std::to_string(imm) + "(" + regs[base] + ")");
+    Put(MInst(MO_LW, {dst, base}, imm));
   }
-  void EmitLoad(Gpr dst, Gpr base, const std::string &label)
+  void EmitLoad(Gpr dst, Gpr base, const std::string &label, int imm = 0)
   {
-    Emit("lw", regs[dst], label + "(" + regs[base] + ")");
+    Put(MInst(MO_LW, {dst, base}, imm, label));
   }
   //   void EmitLoadBitField(const std::string& addr, Object* bitField);
   // void EmitStoreBitField(const ObjectAddr &addr, Type *type);
@@ -218,14 +219,15 @@ protected:
   // exit(10), ...
   void EmitSyscall(unsigned service_no);
 
-  // print_int(), print_str(), ...
-  void EmitSyscall(unsigned service_no, const std::string &arg0);
+  // print_int(), print_char() of `arg0`, or read_int(), read_char()
+  void EmitSyscall(unsigned service_no, Gpr arg0);
+  // print_str() of the string at `label`
+  void EmitSyscall(unsigned service_no, const std::string &label);
 
   void EmitPrint(StringLiteral *sl);
   void EmitPrint(IntegerLiteral *il);
   void EmitPrint(Identifier *ident);  // TODO: opt
   void EmitPrint(Expr *ident) {}      // TODO: opt
-  void EmitPrint(const std::string &arg, int sysn);
   void EmitPrint(QuadAddr *qa);
   void EmitPrint(Gpr reg, int sysn);
 
@@ -236,6 +238,8 @@ protected:
 
   QuadGenerator *m_qg;
   FuncInfo *m_curfunc;
+  int m_reg{Gpr::t8};  // scratch register last handed out
+  bool m_unframed{false};  // before the prologue, see GenEarlyReturn()
 
 protected:
   static DataSegEntryList data_entries;
@@ -0,0 +1,270 @@
+#include "incremental.h"
+#include "error.h"
+#include "lexer.h"
+#include "parser.h"
+#include "scope.h"
+
+#include <algorithm>
+#include <iterator>
+
+extern int error_count;
+
+IncrementalParser::~IncrementalParser()
+{
+  delete m_visible;
+}
+
+/**
+ * @brief Parse `src` from scratch and split it into chunks.
+ *   Tokens are lexed once; a brace skim tells where each function starts
+ *   and every function is then parsed by a Parser of its own, in order.
+ *   If the skim fails the whole file becomes one chunk which is never
+ *   reparsed on its own.
+ */
+TranslationUnitDecl *IncrementalParser::Parse(const std::string &src)
+{
+  auto text = std::make_shared<std::string>(src);
+  auto base = text->data();
+  m_chunks.clear();
+  m_last = nullptr;
+  delete m_visible;
+  m_visible = nullptr;
+  m_unit = TranslationUnitDecl::New();
+  m_scope = new Scope(nullptr, S_FILE);
+
+  Lexer lexer(text.get(), m_filename);
+  TokenList tokens;
+  std::vector<int> lex_errors;  // errors reported while lexing each token
+  for (;;) {
+    int before = error_count;
+    auto tok = lexer.GetToken();
+    tokens.push_back(tok);
+    lex_errors.push_back(error_count - before);
+    if (tok->m_type == EOFTK) {
+      break;
+    }
+  }
+  auto sum_errors = [&lex_errors](size_t begin, size_t end) {
+    int sum = 0;
+    for (size_t i = begin; i < end; ++i) {
+      sum += lex_errors[i];
+    }
+    return sum;
+  };
+
+  Parser::FuncSpanList spans;
+  if (!Parser::SkimFunctions(tokens, spans)) {
+    int before = error_count;
+    Parser parser(&tokens, 0, tokens.size(), m_scope, m_unit);
+    parser.Analyse();
+    m_chunks.push_back({text, 0, text->size(), 1, 0, 0, 0, tokens, nullptr, 0,
+                        sum_errors(0, tokens.size()) + error_count - before});
+    m_chunks.back().tokens.pop_back();
+    return m_unit;
+  }
+
+  // chunk boundaries: a function owns its whole first line if it can
+  std::vector<size_t> starts;
+  for (auto &span : spans) {
+    auto &loc = tokens[span.begin]->m_loc;
+    auto p = loc.line_begin;
+    while (p < loc.loc() && (*p == ' ' || *p == '\t')) {
+      ++p;
+    }
+    starts.push_back((p == loc.loc() ? loc.line_begin : loc.loc()) - base);
+  }
+  starts.push_back(text->size());
+
+  int before = error_count;
+  Parser(&tokens, 0, spans[0].begin, m_scope, m_unit).ParseGlobalDecls();
+  m_chunks.push_back({text, 0, starts[0], 1, 0, 0, 0,
+                      TokenList(tokens.begin(), tokens.begin() + spans[0].begin),
+                      nullptr, 0,
+                      sum_errors(0, spans[0].begin) + error_count - before});
+
+  for (size_t i = 0; i < spans.size(); ++i) {
+    auto &span = spans[i];
+    auto end = i + 1 < spans.size() ? span.end : tokens.size();
+    before = error_count;
+    auto func =
+      Parser(&tokens, span.begin, span.end, m_scope, m_unit).ParseFunctionDecl();
+    Chunk chunk;
+    if (func != nullptr) {
+      m_unit->Add(func);
+      chunk.decl = std::prev(m_unit->ExtDecls().end());
+    }
+    chunk.text = text;
+    chunk.off = starts[i];
+    chunk.len = starts[i + 1] - starts[i];
+    chunk.line = tokens[span.begin]->m_loc.line;
+    chunk.lbrace = tokens[span.lbrace]->m_loc.loc() - base - chunk.off;
+    chunk.rbrace = tokens[span.end - 1]->m_loc.loc() - base - chunk.off;
+    chunk.body = span.lbrace - span.begin;
+    chunk.tokens.assign(tokens.begin() + span.begin, tokens.begin() + span.end);
+    chunk.func = func;
+    chunk.header_errors = sum_errors(span.begin, span.lbrace);
+    chunk.errors = sum_errors(span.begin, end) + error_count - before;
+    m_chunks.push_back(chunk);
+  }
+  m_unit->SetScope(m_scope);
+  return m_unit;
+}
+
+/**
+ * @brief Replace `len` bytes at `offset` with `text`.
+ *   Only the function around the edit is reparsed if the edit lies
+ *   strictly inside its body, and the body is still one balanced block.
+ */
+TranslationUnitDecl *
+IncrementalParser::Edit(size_t offset, size_t len, const std::string &text)
+{
+  m_last = nullptr;
+  size_t start = 0;
+  for (size_t i = 0; i < m_chunks.size(); ++i) {
+    auto &chunk = m_chunks[i];
+    if (offset >= start && offset + len <= start + chunk.len) {
+      size_t rel = offset - start;
+      if (chunk.func != nullptr && rel > chunk.lbrace &&
+          rel + len <= chunk.rbrace && Reparse(i, rel, len, text)) {
+        return m_unit;
+      }
+      break;
+    }
+    start += chunk.len;
+  }
+
+  auto src = Source();
+  offset = std::min(offset, src.size());
+  len = std::min(len, src.size() - offset);
+  src.replace(offset, len, text);
+  return Parse(src);
+}
+
+/**
+ * @brief Reparse the function of chunk `idx` after an edit of its body.
+ *   Header tokens are kept, only the body is lexed again.
+ * @return false if the edit changed the brace structure of the body.
+ */
+bool IncrementalParser::Reparse(size_t idx,
+                                size_t rel,
+                                size_t len,
+                                const std::string &text)
+{
+  auto &chunk = m_chunks[idx];
+  auto old_base = chunk.text->data() + chunk.off;
+  auto src =
+    std::make_shared<std::string>(chunk.text->substr(chunk.off, chunk.len));
+  int lines = std::count(text.begin(), text.end(), '\n') -
+              std::count(src->begin() + rel, src->begin() + rel + len, '\n');
+  src->replace(rel, len, text);
+  size_t rbrace = chunk.rbrace + text.size() - len;
+
+  // lexer errors wait until the body is known to be kept
+  ErrorBuffer lex_errors;
+  unsigned line =
+    chunk.line + std::count(src->begin(), src->begin() + chunk.lbrace, '\n');
+  Lexer lexer(src.get(), chunk.lbrace, m_filename, line);
+  SetErrorBuffer(&lex_errors);
+  auto body = lexer.Tokenize();
+  SetErrorBuffer(nullptr);
+  body.pop_back();  // EOFTK
+
+  int depth = 0;
+  for (size_t i = 0; i < body.size(); ++i) {
+    if (body[i]->m_type == LBRACE) {
+      ++depth;
+    }
+    else if (body[i]->m_type == RBRACE && --depth == 0 &&
+             i + 1 != body.size()) {
+      return false;
+    }
+  }
+  if (depth != 0 || body.empty() ||
+      body.back()->m_loc.loc() != src->data() + rbrace) {
+    return false;
+  }
+
+  int before = error_count;
+  FlushErrorBuffer(lex_errors);
+
+  // Move the kept header tokens onto the new buffer and line numbers.
+  TokenList tokens(chunk.tokens.begin(), chunk.tokens.begin() + chunk.body);
+  int shift = chunk.line - chunk.tokens[0]->m_loc.line;
+  for (auto tok : tokens) {
+    auto &loc = tok->m_loc;
+    if (loc.line_begin >= old_base && loc.line_begin < old_base + chunk.len) {
+      loc.line_begin = src->data() + (loc.line_begin - old_base);
+    }
+    loc.line += shift;
+  }
+  tokens.insert(tokens.end(), body.begin(), body.end());
+
+  Parser parser(&tokens, 0, tokens.size(), VisibleScope(idx), m_unit);
+  auto func = parser.ParseFunctionDecl();
+  if (func != nullptr) {
+    *chunk.decl = func;
+    m_scope->Insert(func->Name(), func->Ident());
+  }
+  else {
+    // broken: the next edit of the chunk reparses everything
+    m_unit->ExtDecls().erase(chunk.decl);
+  }
+
+  chunk.text = src;
+  chunk.off = 0;
+  chunk.len = src->size();
+  chunk.rbrace = rbrace;
+  chunk.tokens = tokens;
+  chunk.func = func;
+  chunk.errors = chunk.header_errors + error_count - before;
+  for (size_t i = idx + 1; i < m_chunks.size(); ++i) {
+    m_chunks[i].line += lines;
+  }
+  m_last = func;
+  return true;
+}
+
+/**
+ * @brief Global scope as seen from the function of chunk `idx`:
+ *   global declarations and the functions defined before it.
+ *   It is kept for the next reparse of the same chunk, which only
+ *   redefines the function itself; a function before it is reparsed
+ *   through another chunk, which builds the scope again.
+ */
+Scope *IncrementalParser::VisibleScope(size_t idx)
+{
+  if (m_visible != nullptr && m_visible_idx == idx) {
+    return m_visible;
+  }
+  delete m_visible;
+  m_visible = new Scope(nullptr, S_FILE);
+  m_visible_idx = idx;
+  for (auto decl : m_unit->VarDecls()) {
+    m_visible->Insert(decl->Name(), decl->Ident());
+  }
+  for (size_t i = 0; i < idx; ++i) {
+    auto func = m_chunks[i].func;
+    if (func != nullptr) {
+      m_visible->Insert(func->Name(), func->Ident());
+    }
+  }
+  return m_visible;
+}
+
+std::string IncrementalParser::Source() const
+{
+  std::string src;
+  for (auto &chunk : m_chunks) {
+    src.append(*chunk.text, chunk.off, chunk.len);
+  }
+  return src;
+}
+
+int IncrementalParser::ErrorCount() const
+{
+  int count = 0;
+  for (auto &chunk : m_chunks) {
+    count += chunk.errors;
+  }
+  return count;
+}
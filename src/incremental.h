@@ -0,0 +1,72 @@
+#ifndef C0C_INCREMENTAL_H
+#define C0C_INCREMENTAL_H
+
+#include "ast.h"
+#include "token.h"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Scope;
+
+/**
+ * Incremental front end for editor integration.
+ *
+ * The source is kept as a list of chunks: the global declarations first,
+ * then one chunk per function definition (with the blanks following it).
+ * Every chunk keeps its text, its tokens and its FunctionDecl. An edit
+ * that stays inside a single function body re-lexes that body only and
+ * reparses that function only; any other edit falls back to Parse().
+ */
+class IncrementalParser {
+public:
+  explicit IncrementalParser(const char *filename) : m_filename(filename) {}
+  ~IncrementalParser();
+
+  TranslationUnitDecl *Parse(const std::string &src);
+  TranslationUnitDecl *
+  Edit(size_t offset, size_t len, const std::string &text);
+
+  TranslationUnitDecl *Unit() const
+  {
+    return m_unit;
+  }
+  // function reparsed by the last Edit(), nullptr if all was reparsed
+  FunctionDecl *LastReparsed() const
+  {
+    return m_last;
+  }
+  std::string Source() const;
+  int ErrorCount() const;
+
+private:
+  struct Chunk {
+    std::shared_ptr<std::string> text;  // buffer holding the chunk
+    size_t off;                         // chunk begins at text[off]
+    size_t len;                         // chunk length in bytes
+    unsigned line;                      // line number of text[off]
+    size_t lbrace;       // '{' of the body, relative to off
+    size_t rbrace;       // '}' of the body, relative to off
+    size_t body;         // index of '{' in tokens
+    TokenList tokens;    // tokens of the chunk, EOFTK excluded
+    FunctionDecl *func;  // nullptr for global declarations, or if broken
+    int header_errors;   // lexical errors before the body
+    int errors;          // all errors reported for this chunk
+    std::list<ASTNode *>::iterator decl;  // func in the unit's ExtDecls()
+  };
+
+  bool Reparse(size_t idx, size_t rel, size_t len, const std::string &text);
+  Scope *VisibleScope(size_t idx);
+
+  const char *m_filename;
+  std::vector<Chunk> m_chunks;
+  TranslationUnitDecl *m_unit{nullptr};
+  Scope *m_scope{nullptr};
+  Scope *m_visible{nullptr};  // VisibleScope() of chunk m_visible_idx
+  size_t m_visible_idx{0};
+  FunctionDecl *m_last{nullptr};
+};
+
+#endif  // !C0C_INCREMENTAL_H
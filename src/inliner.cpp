@@ -0,0 +1,361 @@
+#include "inliner.h"
+#include "cfg.h"
+#include "debug.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+// callees this small are inlined anywhere, those up to INLINE_HOT in loops
+static const size_t INLINE_SMALL = 12;
+static const size_t INLINE_HOT = 40;
+// callees inlined into each other, and quads a caller may grow by
+static const size_t INLINE_DEPTH = 3;
+static const size_t INLINE_GROWTH = 400;
+
+// operands made for the function only, all but globals and labels
+static bool isprivate(const QuadAddr *qa)
+{
+  if (qa->m_type == QuadAddr::AT_ARRAY) {
+    return true;
+  }
+  return qa->m_type != QuadAddr::AT_LABEL && qa->m_type != QuadAddr::AT_STR &&
+         !qa->m_isglb;
+}
+
+InlineBody *KeepBody(FuncInfo *func)
+{
+  if (func->Name() == "main") {
+    return nullptr;
+  }
+  size_t size = 0;
+  for (auto quad : func->m_quads) {
+    if (quad->m_op != QO_LABEL && quad->m_op != QO_PARAM) {
+      ++size;
+    }
+#ifndef STRING_POOL
+    for (auto qa : {quad->m_dst, quad->m_arg1, quad->m_arg2}) {
+      if (qa && qa->m_type == QuadAddr::AT_STR) {
+        return nullptr;
+      }
+    }
+#endif  // !STRING_POOL
+  }
+  if (size > INLINE_HOT) {
+    return nullptr;
+  }
+
+  // passes change quads and operands in place: copy both
+  std::map<QuadAddr *, QuadAddr *> copies;
+  std::function<QuadAddr *(QuadAddr *)> copy = [&](QuadAddr *qa) {
+    if (!qa || !isprivate(qa)) {
+      return qa;
+    }
+    auto &ret = copies[qa];
+    if (!ret) {
+      ret = QuadAddr::New(*qa);
+      ret->m_minion = copy(qa->m_minion);
+    }
+    return ret;
+  };
+  auto body = new InlineBody;
+  for (auto quad : func->m_quads) {
+    body->m_quads.push_back(Quadruple::New(
+      quad->m_op, copy(quad->m_dst), copy(quad->m_arg1), copy(quad->m_arg2)));
+  }
+  body->m_slots = func->m_slots;
+  body->m_size = size;
+  return body;
+}
+
+// loop nesting of each quad, a loop running from a label to a jump back
+static std::vector<int> loopdepth(const FuncInfo::QuadList &quads)
+{
+  std::map<LabelStmt *, size_t> labels;
+  std::vector<int> depth(quads.size() + 1);
+  for (size_t i = 0; i < quads.size(); ++i) {
+    auto op = quads[i]->m_op;
+    if (op == QO_LABEL) {
+      labels[JumpTarget(quads[i])] = i;
+    }
+    else if (IsCondBranch(op) || op == QO_GOTO) {
+      auto it = labels.find(JumpTarget(quads[i]));
+      if (it != labels.end()) {
+        ++depth[it->second];
+        --depth[i + 1];
+      }
+    }
+  }
+  for (size_t i = 1; i < quads.size(); ++i) {
+    depth[i] += depth[i - 1];
+  }
+  return depth;
+}
+
+static std::string callee(const Quadruple *call)
+{
+  return reinterpret_cast<Identifier *>(call->m_arg1->m_data)->Name();
+}
+
+namespace {
+
+class Inliner {
+public:
+  Inliner(FuncInfo *func,
+          const InlineBodies &bodies,
+          std::map<std::string, int> &inlined)
+    : m_func(func), m_bodies(bodies), m_inlined(inlined)
+  {
+  }
+
+  // the quads of the function with the calls worth it inlined
+  void Expand(const FuncInfo::QuadList &quads, int loops);
+
+  FuncInfo::QuadList m_out;
+
+private:
+  const InlineBody *Worth(Quadruple *call, int loops);
+  FuncInfo::QuadList Clone(const InlineBody *body,
+                           Quadruple *call,
+                           const std::vector<Quadruple *> &pushes);
+
+  FuncInfo *m_func;
+  const InlineBodies &m_bodies;
+  std::map<std::string, int> &m_inlined;
+  std::vector<std::string> m_chain;  // callees being inlined, outermost first
+  size_t m_growth{0};
+};
+
+}  // namespace
+
+void Inliner::Expand(const FuncInfo::QuadList &quads, int loops)
+{
+  auto depth = loopdepth(quads);
+  // the arguments of a call are pushed right before it
+  std::vector<Quadruple *> pushes;
+  for (size_t i = 0; i < quads.size(); ++i) {
+    auto quad = quads[i];
+    if (quad->m_op == QO_PUSH) {
+      pushes.push_back(quad);
+      continue;
+    }
+    if (quad->m_op == QO_CALL) {
+      auto body = Worth(quad, loops + depth[i]);
+      if (body) {
+        auto name = callee(quad);
+        ++m_inlined[name];
+        m_growth += body->m_size;
+        m_chain.push_back(name);
+        Expand(Clone(body, quad, pushes), loops + depth[i]);
+        m_chain.pop_back();
+        pushes.clear();
+        continue;
+      }
+    }
+    m_out.insert(m_out.end(), pushes.begin(), pushes.end());
+    pushes.clear();
+    m_out.push_back(quad);
+  }
+  m_out.insert(m_out.end(), pushes.begin(), pushes.end());
+}
+
+const InlineBody *Inliner::Worth(Quadruple *call, int loops)
+{
+  auto name = callee(call);
+  auto it = m_bodies.find(name);
+  if (it == m_bodies.end() || !it->second || name == m_func->Name()) {
+    return nullptr;
+  }
+  if (std::find(m_chain.begin(), m_chain.end(), name) != m_chain.end()) {
+    return nullptr;
+  }
+  auto size = it->second->m_size;
+  if (m_chain.size() >= INLINE_DEPTH || size > INLINE_HOT ||
+      (size > INLINE_SMALL && loops == 0) ||
+      m_growth + size > INLINE_GROWTH) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+FuncInfo::QuadList Inliner::Clone(const InlineBody *body,
+                                  Quadruple *call,
+                                  const std::vector<Quadruple *> &pushes)
+{
+  FuncInfo::QuadList ret;
+  std::map<QuadAddr *, QuadAddr *> vars;
+  std::map<unsigned, unsigned> arrays;  // slot of a local array, by offset
+  std::map<LabelStmt *, QuadAddr *> labels;
+  std::function<QuadAddr *(QuadAddr *)> rename = [&](QuadAddr *qa) {
+    if (!qa || qa->m_type == QuadAddr::AT_STR) {
+      return qa;
+    }
+    if (qa->m_type == QuadAddr::AT_ARRAY) {
+      auto copy = QuadAddr::New(*qa);
+      copy->m_minion = rename(qa->m_minion);
+      if (!qa->m_isglb) {
+        auto it = arrays.find(qa->m_offset);
+        if (it == arrays.end()) {
+          auto width = body->m_slots.at(qa->m_offset);
+          it = arrays.emplace(qa->m_offset, m_func->NewSlot(width)).first;
+        }
+        copy->m_offset = it->second;
+      }
+      return copy;
+    }
+    if (qa->m_isglb) {
+      return qa;
+    }
+    if (qa->m_type == QuadAddr::AT_LABEL) {
+      auto &label = labels[reinterpret_cast<LabelStmt *>(qa->m_data)];
+      if (!label) {
+        label = m_func->NewLabel();
+      }
+      return label;
+    }
+    if (!qa->IsLocal()) {
+      // literals get resolved in place like the rest
+      return QuadAddr::New(*qa);
+    }
+    auto &var = vars[qa];
+    if (!var) {
+      var = QuadAddr::New(*qa);
+      var->m_offset = m_func->NewSlot(4);
+      if (qa->m_type != QuadAddr::AT_IDENT) {
+        var->m_data = ++m_func->m_ntemps;
+      }
+    }
+    return var;
+  };
+
+  // pushed in the order of the parameters
+  size_t param = 0;
+  QuadAddr *end = nullptr;
+  for (size_t i = 0; i < body->m_quads.size(); ++i) {
+    auto quad = body->m_quads[i];
+    if (quad->m_op == QO_PARAM) {
+      auto value = pushes[param++]->m_dst;
+      ret.push_back(Quadruple::New(QO_ASSIGN, rename(quad->m_dst), value));
+    }
+    else if (quad->m_op == QO_RETURN) {
+      if (quad->m_dst) {
+        ret.push_back(
+          Quadruple::New(QO_ASSIGN, call->m_dst, rename(quad->m_dst)));
+      }
+      if (i + 1 < body->m_quads.size()) {
+        end = end ? end : m_func->NewLabel();
+        ret.push_back(Quadruple::New(QO_GOTO, end));
+      }
+    }
+    else if (quad->m_op == QO_CALL) {
+      ret.push_back(Quadruple::New(QO_CALL, rename(quad->m_dst),
+                                   QuadAddr::New(*quad->m_arg1)));
+    }
+    else {
+      ret.push_back(Quadruple::New(quad->m_op, rename(quad->m_dst),
+                                   rename(quad->m_arg1),
+                                   rename(quad->m_arg2)));
+    }
+  }
+  if (end) {
+    ret.push_back(Quadruple::New(QO_LABEL, end));
+  }
+  return ret;
+}
+
+void InlineCalls(FuncInfo *func,
+                 const InlineBodies &bodies,
+                 std::map<std::string, int> &inlined)
+{
+  Inliner inliner(func, bodies, inlined);
+  inliner.Expand(func->m_quads, 0);
+  if (inlined.empty()) {
+    return;
+  }
+  func->m_quads = inliner.m_out;
+  func->Recount();
+}
+
+// whether the quads from `i` on return `value` doing nothing else, past
+// labels and gotos; falling off the end returns nothing
+static bool returns(const FuncInfo::QuadList &quads,
+                    size_t i,
+                    QuadAddr *value,
+                    const std::map<LabelStmt *, size_t> &labels)
+{
+  std::set<size_t> seen;
+  while (i < quads.size() && seen.insert(i).second) {
+    auto quad = quads[i];
+    if (quad->m_op == QO_LABEL) {
+      ++i;
+    }
+    else if (quad->m_op == QO_GOTO) {
+      i = labels.at(JumpTarget(quad));
+    }
+    else {
+      return quad->m_op == QO_RETURN &&
+             (!quad->m_dst || quad->m_dst == value);
+    }
+  }
+  return i == quads.size();
+}
+
+bool EliminateTailRecursion(FuncInfo *func)
+{
+  auto &quads = func->m_quads;
+  std::map<LabelStmt *, size_t> labels;
+  std::vector<QuadAddr *> params;
+  for (size_t i = 0; i < quads.size(); ++i) {
+    if (quads[i]->m_op == QO_LABEL) {
+      labels[JumpTarget(quads[i])] = i;
+    }
+    else if (quads[i]->m_op == QO_PARAM) {
+      params.push_back(quads[i]->m_dst);
+    }
+  }
+
+  FuncInfo::QuadList out;
+  QuadAddr *start = nullptr;
+  std::vector<Quadruple *> pushes;
+  for (size_t i = 0; i < quads.size(); ++i) {
+    auto quad = quads[i];
+    if (quad->m_op == QO_PUSH) {
+      pushes.push_back(quad);
+      continue;
+    }
+    if (quad->m_op == QO_CALL && callee(quad) == func->Name() &&
+        pushes.size() == params.size() &&
+        returns(quads, i + 1, quad->m_dst, labels)) {
+      // every argument is read before any parameter is written
+      std::vector<QuadAddr *> args;
+      for (size_t k = 0; k < pushes.size(); ++k) {
+        auto arg = pushes[k]->m_dst;
+        if (arg != params[k] &&
+            std::find(params.begin(), params.end(), arg) != params.end()) {
+          arg = func->NewTemp();
+          out.push_back(Quadruple::New(QO_ASSIGN, arg, pushes[k]->m_dst));
+        }
+        args.push_back(arg);
+      }
+      for (size_t k = 0; k < params.size(); ++k) {
+        if (args[k] != params[k]) {
+          out.push_back(Quadruple::New(QO_ASSIGN, params[k], args[k]));
+        }
+      }
+      start = start ? start : func->NewLabel();
+      out.push_back(Quadruple::New(QO_GOTO, start));
+      pushes.clear();
+      continue;
+    }
+    out.insert(out.end(), pushes.begin(), pushes.end());
+    pushes.clear();
+    out.push_back(quad);
+  }
+  if (!start) {
+    return false;
+  }
+  out.insert(out.begin() + params.size(), Quadruple::New(QO_LABEL, start));
+  quads = out;
+  func->Recount();
+  return true;
+}
@@ -0,0 +1,53 @@
+#ifndef C0C_INLINER_H
+#define C0C_INLINER_H
+
+#include "quad_generator.h"
+
+#include <map>
+#include <string>
+
+/*
+ * Inlining at the quad level. The quads of a function are kept as they
+ * are generated, before any pass changes them, and a call worth it is
+ * replaced by a copy of them: the locals, temporaries and labels of the
+ * callee renamed into the caller, its parameters assigned the arguments
+ * pushed, and its returns turned into assignments to the result of the
+ * call and jumps past the copy. Calls left in the copy are inlined in
+ * turn, so that the caller works on raw quads only.
+ */
+
+// quads of a function as generated, with the width of its slots
+struct InlineBody {
+  FuncInfo::QuadList m_quads;
+  std::map<unsigned, unsigned> m_slots;
+  size_t m_size;  // quads besides labels and parameters
+};
+
+using InlineBodies = std::map<std::string, InlineBody *>;
+
+/**
+ * A copy of the quads of `func` as they are now, nullptr if it is never
+ * worth inlining: main, one too big or, unless strings are pooled, a
+ * function printing a string (whose data each copy would define again).
+ */
+InlineBody *KeepBody(FuncInfo *func);
+
+/**
+ * Inlines the calls of `func` to the functions in `bodies` worth it: those
+ * small enough anywhere, and those still small in a loop, as far as the
+ * caller may grow. A function is never inlined into itself, directly or
+ * through the functions inlined into it, nor more than a few levels deep.
+ * The calls inlined are counted in `inlined`, by callee.
+ */
+void InlineCalls(FuncInfo *func,
+                 const InlineBodies &bodies,
+                 std::map<std::string, int> &inlined);
+
+/**
+ * Turns the calls of `func` to itself in tail position, those followed by
+ * nothing but a return of their result, into assignments to its
+ * parameters and a jump back to its start. Returns whether any was.
+ */
+bool EliminateTailRecursion(FuncInfo *func);
+
+#endif  // !C0C_INLINER_H
@@ -335,6 +335,21 @@ Token *Lexer::MakeToken(const TokenType type)
   return Token::New(m_token);
 }
 
+/**
+ * @brief Lex the rest of the buffer at once.
+ * @return all tokens, the trailing EOFTK included.
+ */
+TokenList Lexer::Tokenize()
+{
+  TokenList tokens;
+  Token *token = nullptr;
+  do {
+    token = GetToken();
+    tokens.push_back(token);
+  } while (token->m_type != EOFTK);
+  return tokens;
+}
+
 /*
  * Course demand
  */
@@ -21,11 +21,30 @@ public:
     m_pbuf = &(*srcbuf)[0];  // origin
     m_loc = {filename, m_pbuf, line, column};
   }
+
+  /**
+   * Start lexing at byte `offset` of `srcbuf`, which lies on line `line`.
+   */
+  Lexer(const std::string *srcbuf,
+        size_t offset,
+        const char *filename,
+        unsigned line)
+    : Lexer(srcbuf, filename, line)
+  {
+    auto line_begin = m_pbuf + offset;
+    while (line_begin > m_pbuf && line_begin[-1] != '\n') {
+      --line_begin;
+    }
+    m_loc.line_begin = line_begin;
+    m_loc.column = m_pbuf + offset - line_begin + 1;
+    m_pbuf += offset;
+  }
   Lexer() = delete;
   ~Lexer() {}
 
   void Analyse();
   Token *GetToken();
+  TokenList Tokenize();
 
 private:
   int GetChar();
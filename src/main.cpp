@@ -1,12 +1,20 @@
 #include "debug.h"
 #include "error.h"
 #include "generator.h"
+#include "incremental.h"
 #include "lexer.h"
 #include "parser.h"
 #include "quad_generator.h"
+#include "regalloc.h"
+#include "schedule.h"
 
 #include <assert.h>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <getopt.h>
+#include <iostream>
 #include <sstream>
 
 #ifdef PRINT_OUTPUT
@@ -20,6 +28,9 @@ extern int error_flag;
 
 const char *output_file;
 const char *source_file;
+bool incremental;
+unsigned jobs = 1;
+static const unsigned max_jobs = 64;  // threads beyond are only overhead
 
 static void usage(const char *argv0)
 {
@@ -28,9 +39,82 @@ static void usage(const char *argv0)
           " %s compiles C0(C-like) language source file into MIPS assembly "
           "code.\n"
           "Options:\n"
-          " -c <file>, Compile source <file>.\n",
-          " -o <file>, Place the output into <file>.\n",
-          " -g, Generate debug information.\n", argv0, argv0);
+          " -c <file>, Compile source <file>.\n"
+          " -o <file>, Place the output into <file>.\n"
+          " -g, Generate debug information.\n"
+          " -j <n>, Parse and generate code of functions on <n> threads.\n"
+          " -ferror-limit=<n>, Show at most <n> errors, 0 for all.\n"
+          " -fdiagnostics-format=<text|json>, Print errors as text or "
+          "JSON.\n"
+          " -fregalloc=<linear-scan|graph-coloring>, Allocate registers by "
+          "linear\n"
+          "     scan (default) or by graph coloring.\n"
+          " -mdelay-slots, Fill the delay slots of branches and jumps, for "
+          "MARS run\n"
+          "     with delayed branching.\n"
+          " -i, Keep parsing incrementally, reading edits from stdin:\n"
+          "     `edit <offset> <length> <size>\\n<size bytes>` or `quit`.\n",
+          argv0, argv0);
+}
+
+// all of `str` a decimal number no greater than `max`
+static bool parse_number(const char *str, unsigned long max,
+                         unsigned long &ret)
+{
+  char *end;
+  errno = 0;
+  ret = strtoul(str, &end, 10);
+  return isdigit((unsigned char)*str) && *end == '\0' && errno == 0 &&
+         ret <= max;
+}
+
+// -f<name>=<value>
+static int parse_fopt(const char *opt)
+{
+  std::string name(opt), value;
+  auto eq = name.find('=');
+  if (eq != std::string::npos) {
+    value = name.substr(eq + 1);
+    name.resize(eq);
+  }
+  unsigned long number;
+  if (name == "error-limit" && parse_number(value.c_str(), UINT_MAX, number)) {
+    SetErrorLimit(number);
+  }
+  else if (name == "diagnostics-format" && value == "text") {
+    SetDiagnosticFormat(DF_TEXT);
+  }
+  else if (name == "diagnostics-format" && value == "json") {
+    SetDiagnosticFormat(DF_JSON);
+  }
+  else if (name == "regalloc" && value == "linear-scan") {
+    SetRegAlloc(RA_LINEAR_SCAN);
+  }
+  else if (name == "regalloc" && value == "graph-coloring") {
+    SetRegAlloc(RA_GRAPH_COLORING);
+  }
+  else {
+    Error("unknown option \'-f%s\'", opt);
+    return -1;
+  }
+  return 0;
+}
+
+// -m<name>
+static int parse_mopt(const char *opt)
+{
+  std::string name(opt);
+  if (name == "delay-slots") {
+    SetDelaySlots(true);
+  }
+  else if (name == "no-delay-slots") {
+    SetDelaySlots(false);
+  }
+  else {
+    Error("unknown option \'-m%s\'", opt);
+    return -1;
+  }
+  return 0;
 }
 
 static int parse_opt(int argc, char *const argv[])
@@ -40,8 +124,10 @@ static int parse_opt(int argc, char *const argv[])
       {.name = "compile", .has_arg = 1, .flag = nullptr, .val = 'c'},
       {.name = "output", .has_arg = 1, .flag = nullptr, .val = 'o'},
       {.name = "g", .has_arg = 0, .flag = nullptr, .val = 'g'},
+      {.name = "incremental", .has_arg = 0, .flag = nullptr, .val = 'i'},
+      {.name = "jobs", .has_arg = 1, .flag = nullptr, .val = 'j'},
     };
-    int c = getopt_long(argc, argv, "c:o:g", long_options, NULL);
+    int c = getopt_long(argc, argv, "c:o:gij:f:m:", long_options, NULL);
     if (c == -1)
       break;
     switch (c) {
@@ -54,6 +140,31 @@ static int parse_opt(int argc, char *const argv[])
     case 'g':
       /* TODO: Add -g support */
       break;
+    case 'i':
+      incremental = true;
+      break;
+    case 'j': {
+      unsigned long number;
+      if (!parse_number(optarg, ULONG_MAX, number)) {
+        Error("invalid number of jobs \'%s\'", optarg);
+        usage(argv[0]);
+        return 1;
+      }
+      jobs = number < 1 ? 1 : number > max_jobs ? max_jobs : number;
+      break;
+    }
+    case 'f':
+      if (parse_fopt(optarg)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'm':
+      if (parse_mopt(optarg)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
     default:
       usage(argv[0]);
       return 1;
@@ -85,6 +196,38 @@ static std::string *read_source_file(const char *filename)
   return new std::string(buf.str());
 }
 
+/**
+ * Editor integration: reparse on every edit read from stdin and answer
+ * each one with `<reparsed function or *> <error count>`.
+ */
+static void incremental_loop(const std::string *src)
+{
+  IncrementalParser parser(source_file);
+  parser.Parse(*src);
+  RenderDiagnostics();
+  printf("* %d\n", parser.ErrorCount());
+  fflush(stdout);
+
+  std::string cmd;
+  while (std::cin >> cmd && cmd != "quit") {
+    if (cmd != "edit") {
+      Error("unknown command \'%s\'", cmd.c_str());
+      continue;
+    }
+    size_t offset, len, size;
+    std::cin >> offset >> len >> size;
+    std::cin.get();
+    std::string text(size, '\0');
+    std::cin.read(&text[0], size);
+
+    parser.Edit(offset, len, text);
+    auto func = parser.LastReparsed();
+    RenderDiagnostics();
+    printf("%s %d\n", func ? func->Name().c_str() : "*", parser.ErrorCount());
+    fflush(stdout);
+  }
+}
+
 int main(int argc, char **argv)
 {
   int rc;
@@ -92,10 +235,15 @@ int main(int argc, char **argv)
   rc = parse_opt(argc, argv);
   if (rc) {
     Error("Option parse failed.");
+    RenderDiagnostics();
     exit(0);
   }
 
   auto srcfile = read_source_file(source_file);
+  if (srcfile == nullptr) {
+    RenderDiagnostics();
+    return 0;
+  }
 #ifdef PRINT_OUTPUT
   outstream.open(output_file);
   assert(outstream.is_open());
@@ -106,25 +254,40 @@ int main(int argc, char **argv)
   assert(errstream.is_open());
 #endif  // PRINT_ERROR
 
+  if (incremental) {
+    incremental_loop(srcfile);
+    return 0;
+  }
+
   Lexer lexer(srcfile, source_file);
   Parser parser(&lexer);
-  parser.Analyse();
+  if (jobs > 1) {
+    parser.AnalyseParallel(jobs);
+  }
+  else {
+    parser.Analyse();
+  }
 
+  RenderDiagnostics();
   if (error_flag) {
     return 0;
   }
   auto quads_fp = fopen("quads.txt", "w");
-
-  QuadGenerator qg(&parser, quads_fp);
-  qg.Gen();
-  fclose(quads_fp);
-
-  debug("**************** Code Gen ****************\n");
-
   auto mips_fp = fopen("mips.txt", "w");
+  QuadGenerator qg(&parser, quads_fp);
   CodeGenerator generator(&parser, &qg, mips_fp);
-  generator.Gen();
+
+  if (jobs > 1) {
+    generator.Gen(jobs);
+  }
+  else {
+    qg.Gen();
+    debug("**************** Code Gen ****************\n");
+    generator.Gen();
+  }
+  fclose(quads_fp);
   fclose(mips_fp);
+  RenderDiagnostics();
 
 #ifdef PRINT_ERROR
   errstream.close();
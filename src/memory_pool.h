@@ -2,6 +2,7 @@
 #define C0C_MEMORY_POOL_H
 
 #include <cstddef>
+#include <mutex>
 #include <vector>
 
 class MemoryPool {
@@ -49,11 +50,13 @@ private:
 
   std::vector<Block *> m_blocks;
   Chunk *m_root;
+  std::mutex m_mutex;  // functions may be parsed on several threads
 };
 
 template <class T>
 void *MemoryPoolImp<T>::Alloc()
 {
+  std::lock_guard<std::mutex> lock(m_mutex);
   if (nullptr == m_root) {  // 空间不够，需要分配空间
     auto block = new Block();
     m_root = block->m_chunks;
@@ -77,6 +80,7 @@ void MemoryPoolImp<T>::Free(void *addr)
   if (nullptr == addr)
     return;
 
+  std::lock_guard<std::mutex> lock(m_mutex);
   auto chunk = static_cast<Chunk *>(addr);
   chunk->m_next = m_root;
   m_root = chunk;
@@ -87,6 +91,7 @@ void MemoryPoolImp<T>::Free(void *addr)
 template <class T>
 void MemoryPoolImp<T>::Clear()
 {
+  std::lock_guard<std::mutex> lock(m_mutex);
   for (auto block : m_blocks)
     delete block;
 
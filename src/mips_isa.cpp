@@ -1,9 +1,276 @@
 #include "mips_isa.h"
 
+#include <cstdio>
+
 RegNameList regs{"$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
                  "$t0",   "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
                  "$s0",   "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
                  "$t8",   "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"};
+
+namespace {
+
+// operands of an opcode, in the order they are printed
+enum Format {
+  F_NONE,  // syscall, nop
+  F_D,     // rd
+  F_S,     // rs
+  F_DS,    // rd, rs
+  F_ST,    // rs, rt
+  F_DST,   // rd, rs, rt
+  F_DSI,   // rd, rs, imm
+  F_DI,    // rd, imm
+  F_DL,    // rd, label
+  F_SL,    // rs, label
+  F_STL,   // rs, rt, label
+  F_L,     // label
+  F_MEM,   // rt, address
+};
+
+struct OpInfo {
+  const char *name;
+  Format format;
+};
+
+// by MOp
+const OpInfo ops[] = {
+  {"add", F_DST},  {"addiu", F_DSI}, {"addu", F_DST},  {"beq", F_STL},
+  {"beqz", F_SL},  {"bge", F_STL},   {"bgez", F_SL},   {"bgt", F_STL},
+  {"bgtz", F_SL},  {"ble", F_STL},   {"blez", F_SL},   {"blt", F_STL},
+  {"bltz", F_SL},  {"bne", F_STL},   {"bnez", F_SL},   {"div", F_ST},
+  {"j", F_L},      {"jal", F_L},     {"jr", F_S},      {"la", F_DL},
+  {"li", F_DI},    {"lw", F_MEM},    {"mfhi", F_D},    {"mflo", F_D},
+  {"move", F_DS},  {"mul", F_DST},   {"mult", F_ST},   {"nop", F_NONE},
+  {"sll", F_DSI},  {"slti", F_DSI},  {"sra", F_DSI},   {"srl", F_DSI},
+  {"subu", F_DST}, {"sw", F_MEM},    {"syscall", F_NONE},
+};
+
+}  // namespace
+
+MInst::MInst(MOp op,
+             std::initializer_list<Gpr> regs,
+             long imm,
+             const std::string &label)
+  : m_op(op), m_imm(imm), m_label(label)
+{
+  if (!IsInst()) {
+    return;
+  }
+  std::vector<Gpr *> fields;
+  switch (ops[op].format) {
+  case F_D:
+  case F_DI:
+  case F_DL:
+    fields = {&m_rd};
+    break;
+  case F_S:
+  case F_SL:
+    fields = {&m_rs};
+    break;
+  case F_DS:
+  case F_DSI:
+    fields = {&m_rd, &m_rs};
+    break;
+  case F_ST:
+  case F_STL:
+    fields = {&m_rs, &m_rt};
+    break;
+  case F_DST:
+    fields = {&m_rd, &m_rs, &m_rt};
+    break;
+  case F_MEM:
+    fields = {&m_rt, &m_rs};
+    break;
+  default:
+    break;
+  }
+  auto field = fields.begin();
+  for (auto reg : regs) {
+    **field++ = reg;
+  }
+}
+
+std::string MInst::Str() const
+{
+  if (m_op == MO_LABEL) {
+    return m_label + ":";
+  }
+  if (!IsInst()) {
+    return m_label;
+  }
+  auto &info = ops[m_op];
+  std::vector<std::string> args;
+  switch (info.format) {
+  case F_NONE:
+    return std::string("    ") + info.name;
+  case F_D:
+    args = {regs[m_rd]};
+    break;
+  case F_S:
+    args = {regs[m_rs]};
+    break;
+  case F_DS:
+    args = {regs[m_rd], regs[m_rs]};
+    break;
+  case F_ST:
+    args = {regs[m_rs], regs[m_rt]};
+    break;
+  case F_DST:
+    args = {regs[m_rd], regs[m_rs], regs[m_rt]};
+    break;
+  case F_DSI:
+    args = {regs[m_rd], regs[m_rs], std::to_string(m_imm)};
+    break;
+  case F_DI:
+    args = {regs[m_rd], std::to_string(m_imm)};
+    break;
+  case F_DL:
+    args = {regs[m_rd], m_label};
+    break;
+  case F_SL:
+    args = {regs[m_rs], m_label};
+    break;
+  case F_STL:
+    args = {regs[m_rs], regs[m_rt], m_label};
+    break;
+  case F_L:
+    args = {m_label};
+    break;
+  case F_MEM: {
+    auto base = std::string("(") + regs[m_rs] + ")";
+    if (m_label.empty()) {
+      args = {regs[m_rt], std::to_string(m_imm) + base};
+    }
+    else {
+      auto addr = m_imm ? m_label + "+" + std::to_string(m_imm) : m_label;
+      args = {regs[m_rt], m_rs == zero ? addr : addr + base};
+    }
+    break;
+  }
+  }
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%-12s", info.name);
+  std::string ret = "    " + std::string(buf) + args[0];
+  for (size_t i = 1; i < args.size(); ++i) {
+    ret += ", " + args[i];
+  }
+  return ret;
+}
+
+bool IsImm16(long imm)
+{
+  return imm >= -32768 && imm <= 32767;
+}
+
+int MInst::Words() const
+{
+  switch (m_op) {
+  case MO_LI:
+    // addiu or ori, else lui and ori
+    return IsImm16(m_imm) || (m_imm >= 0 && m_imm <= 65535) ? 1 : 2;
+  case MO_LA:
+    return 2;
+  case MO_ADDIU:
+  case MO_SLTI:
+    return IsImm16(m_imm) ? 1 : 3;
+  case MO_LW:
+  case MO_SW:
+    // lui $at first for a label, and addu the base to it
+    if (!m_label.empty()) {
+      return m_rs == zero ? 2 : 3;
+    }
+    return IsImm16(m_imm) ? 1 : 3;
+  case MO_BLT:
+  case MO_BLE:
+  case MO_BGT:
+  case MO_BGE:
+    // slt $at first
+    return 2;
+  default:
+    return IsInst() ? 1 : 0;
+  }
+}
+
+bool MInst::IsBranch() const
+{
+  return IsInst() && (ops[m_op].format == F_SL || ops[m_op].format == F_STL);
+}
+
+bool MInst::IsJump() const
+{
+  return m_op == MO_J || m_op == MO_JAL || m_op == MO_JR || IsBranch();
+}
+
+Gpr MInst::Def() const
+{
+  if (!IsInst()) {
+    return zero;
+  }
+  switch (ops[m_op].format) {
+  case F_D:
+  case F_DS:
+  case F_DST:
+  case F_DSI:
+  case F_DI:
+  case F_DL:
+    return m_rd;
+  default:
+    break;
+  }
+  if (m_op == MO_LW) {
+    return m_rt;
+  }
+  if (m_op == MO_SYSCALL) {
+    return v0;
+  }
+  return m_op == MO_JAL ? ra : zero;
+}
+
+// registers read as operands, by the fields holding them
+static std::vector<Gpr MInst::*> operands(const MInst &inst)
+{
+  if (!inst.IsInst()) {
+    return {};
+  }
+  switch (ops[inst.m_op].format) {
+  case F_S:
+  case F_DS:
+  case F_DSI:
+  case F_SL:
+    return {&MInst::m_rs};
+  case F_ST:
+  case F_DST:
+  case F_STL:
+    return {&MInst::m_rs, &MInst::m_rt};
+  default:
+    break;
+  }
+  if (inst.m_op == MO_SW) {
+    return {&MInst::m_rt};
+  }
+  return {};
+}
+
+std::vector<Gpr *> MInst::Operands()
+{
+  std::vector<Gpr *> ret;
+  for (auto field : operands(*this)) {
+    ret.push_back(&(this->*field));
+  }
+  return ret;
+}
+
+bool MInst::Reads(Gpr reg) const
+{
+  if (m_op == MO_SYSCALL) {
+    return reg == v0 || reg == a0;
+  }
+  for (auto field : operands(*this)) {
+    if (this->*field == reg) {
+      return true;
+    }
+  }
+  return false;
+}
 // struct Reg RegPool[8] = {
 //     {Gpr::t0, 0, nullptr}, {Gpr::t1, 0, nullptr}, {Gpr::t2, 0, nullptr},
 //     {Gpr::t3, 0, nullptr}, {Gpr::t4, 0, nullptr}, {Gpr::t5, 0, nullptr},
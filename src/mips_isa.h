@@ -1,6 +1,8 @@
 #ifndef C0C_MIPS_ISA_H
 #define C0C_MIPS_ISA_H
 
+#include <initializer_list>
+#include <string>
 #include <vector>
 
 extern std::vector<const char *> regs;
@@ -63,6 +65,101 @@ struct Reg {
 
 using RegNameList = std::vector<const char *>;
 
+// opcodes as MARS spells them, then the lines around instructions
+enum MOp {
+  MO_ADD,
+  MO_ADDIU,
+  MO_ADDU,
+  MO_BEQ,
+  MO_BEQZ,
+  MO_BGE,
+  MO_BGEZ,
+  MO_BGT,
+  MO_BGTZ,
+  MO_BLE,
+  MO_BLEZ,
+  MO_BLT,
+  MO_BLTZ,
+  MO_BNE,
+  MO_BNEZ,
+  MO_DIV,
+  MO_J,
+  MO_JAL,
+  MO_JR,
+  MO_LA,
+  MO_LI,
+  MO_LW,
+  MO_MFHI,
+  MO_MFLO,
+  MO_MOVE,
+  MO_MUL,
+  MO_MULT,
+  MO_NOP,
+  MO_SLL,
+  MO_SLTI,
+  MO_SRA,
+  MO_SRL,
+  MO_SUBU,
+  MO_SW,
+  MO_SYSCALL,
+  MO_LABEL,  // m_label:
+  MO_NOTE,   // comment or blank line, m_label as printed
+  MO_TEXT,   // directive or data, m_label as printed
+};
+
+/**
+ * An instruction of the machine IR, or a line printed around them. The
+ * registers an opcode takes are set in the order assembly lists them, lw
+ * and sw addressing m_imm(m_rs), or m_label+m_imm(m_rs) if there is a
+ * label.
+ */
+struct MInst {
+  MInst(MOp op,
+        std::initializer_list<Gpr> regs,
+        long imm = 0,
+        const std::string &label = "");
+  static MInst Line(MOp op, const std::string &text)
+  {
+    MInst ret(op, {});
+    ret.m_label = text;
+    return ret;
+  }
+
+  std::string Str() const;
+  bool IsInst() const
+  {
+    return m_op < MO_LABEL;
+  }
+  bool IsBranch() const;
+  // control goes elsewhere, or may not come back to the next line
+  bool IsJump() const;
+  // register written, $zero if none
+  Gpr Def() const;
+  // whether `reg` is read as an operand, not an address
+  bool Reads(Gpr reg) const;
+  // whether `reg` is read as the base of an address
+  bool Addresses(Gpr reg) const
+  {
+    return (m_op == MO_LW || m_op == MO_SW) && m_rs == reg;
+  }
+  // the operands `Reads` returns true for
+  std::vector<Gpr *> Operands();
+  // machine words MARS assembles it into, pseudo-instructions expanded
+  int Words() const;
+
+  MOp m_op;
+  Gpr m_rd{zero};
+  Gpr m_rs{zero};
+  Gpr m_rt{zero};
+  long m_imm{0};
+  std::string m_label;
+};
+
+using MInstList = std::vector<MInst>;
+
+// whether `imm` fits the signed 16-bit immediate of an instruction
+bool IsImm16(long imm);
+
 // extern struct Reg RegPool[8];
 
 #endif  // !C0C_MIPS_ISA_H
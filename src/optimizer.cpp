@@ -0,0 +1,1279 @@
+#include "optimizer.h"
+#include "dataflow.h"
+#include "debug.h"
+
+#include <algorithm>
+#include <climits>
+#include <set>
+#include <tuple>
+
+// 32-bit MIPS arithmetic, except what traps or is left undefined
+static bool fold(QuadOp op, int32_t a, int32_t b, int32_t &ret)
+{
+  auto ua = uint32_t(a), ub = uint32_t(b);
+  switch (op) {
+  case QO_PLUS:
+    ret = int32_t(ua + ub);
+    return true;
+  case QO_MINU:
+    ret = int32_t(ua - ub);
+    return true;
+  case QO_MULT:
+    ret = int32_t(ua * ub);
+    return true;
+  case QO_DIV:
+    if (b == 0 || (a == INT32_MIN && b == -1)) {
+      return false;
+    }
+    ret = a / b;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool taken(QuadOp op, int32_t a, int32_t b)
+{
+  switch (op) {
+  case QO_BEQ:
+    return a == b;
+  case QO_BNE:
+    return a != b;
+  case QO_BGE:
+    return a >= b;
+  case QO_BLT:
+    return a < b;
+  case QO_BGT:
+    return a > b;
+  case QO_BLE:
+    return a <= b;
+  case QO_BZ:
+    return a == 0;
+  case QO_BNZ:
+    return a != 0;
+  default:
+    assert(0);
+    return false;
+  }
+}
+
+struct ConstValue {
+  enum Kind {
+    CV_TOP,     // no value seen yet
+    CV_CONST,   // always m_val
+    CV_BOTTOM,  // more than one value, or unknown
+  };
+
+  bool operator==(const ConstValue &other) const
+  {
+    return m_kind == other.m_kind &&
+           (m_kind != CV_CONST || m_val == other.m_val);
+  }
+
+  Kind m_kind;
+  int32_t m_val;
+};
+
+struct ConstState {
+  bool operator==(const ConstState &other) const
+  {
+    return m_reached == other.m_reached && m_vals == other.m_vals;
+  }
+
+  bool m_reached;
+  std::vector<ConstValue> m_vals;  // by local id
+};
+
+/**
+ * Wegman and Zadeck's conditional constant propagation, over the locals of
+ * the blocks rather than SSA values: a block is reached through the edges
+ * its predecessors may take, and only those feed its constants.
+ */
+class ConstPropagation : public DataFlow<ConstState> {
+public:
+  explicit ConstPropagation(FlowGraph *cfg) : DataFlow(cfg, FD_FORWARD)
+  {
+    NumberLocals(cfg, m_ids);
+  }
+
+  bool Rewrite();
+
+protected:
+  virtual ConstState Boundary();
+  virtual ConstState Initial();
+  virtual void Meet(ConstState &state, const ConstState &other);
+  virtual ConstState Transfer(BasicBlock *bb, const ConstState &state);
+  virtual bool Executable(BasicBlock *from, BasicBlock *to);
+
+private:
+  int Id(QuadAddr *qa) const
+  {
+    auto it = m_ids.find(qa);
+    return it == m_ids.end() ? -1 : it->second;
+  }
+  ConstValue Eval(QuadAddr *qa, const ConstState &state) const;
+  void Step(Quadruple *quad, ConstState &state) const;
+  // 1 if the branch is always taken, 0 if never, -1 if not known
+  int Decide(Quadruple *branch, const ConstState &state) const;
+
+  std::map<QuadAddr *, int> m_ids;
+};
+
+// nothing is known of the locals on entry
+ConstState ConstPropagation::Boundary()
+{
+  ConstValue bottom{ConstValue::CV_BOTTOM, 0};
+  return {true, std::vector<ConstValue>(m_ids.size(), bottom)};
+}
+
+ConstState ConstPropagation::Initial()
+{
+  ConstValue top{ConstValue::CV_TOP, 0};
+  return {false, std::vector<ConstValue>(m_ids.size(), top)};
+}
+
+void ConstPropagation::Meet(ConstState &state, const ConstState &other)
+{
+  if (!other.m_reached) {
+    return;
+  }
+  if (!state.m_reached) {
+    state = other;
+    return;
+  }
+  for (size_t i = 0; i < state.m_vals.size(); ++i) {
+    auto &val = state.m_vals[i];
+    auto &rhs = other.m_vals[i];
+    if (val.m_kind == ConstValue::CV_TOP) {
+      val = rhs;
+    }
+    else if (rhs.m_kind != ConstValue::CV_TOP && !(val == rhs)) {
+      val.m_kind = ConstValue::CV_BOTTOM;
+    }
+  }
+}
+
+ConstState ConstPropagation::Transfer(BasicBlock *bb, const ConstState &state)
+{
+  auto ret = state;
+  if (ret.m_reached) {
+    for (auto quad : bb->m_quads) {
+      Step(quad, ret);
+    }
+  }
+  return ret;
+}
+
+bool ConstPropagation::Executable(BasicBlock *from, BasicBlock *to)
+{
+  auto &state = m_out[from->m_id];
+  if (!state.m_reached) {
+    return false;
+  }
+  auto term = from->Terminator();
+  if (!term || !IsCondBranch(term->m_op) || from->m_succs.size() < 2) {
+    return true;
+  }
+  auto decision = Decide(term, state);
+  return decision < 0 || (to == m_cfg->Target(term)) == (decision == 1);
+}
+
+ConstValue ConstPropagation::Eval(QuadAddr *qa, const ConstState &state) const
+{
+  if (qa->m_type == QuadAddr::AT_INTL || qa->m_type == QuadAddr::AT_CHARL) {
+    return {ConstValue::CV_CONST, int32_t(qa->m_data)};
+  }
+  auto id = Id(qa);
+  return id < 0 ? ConstValue{ConstValue::CV_BOTTOM, 0} : state.m_vals[id];
+}
+
+void ConstPropagation::Step(Quadruple *quad, ConstState &state) const
+{
+  auto id = Id(quad->Def());
+  if (id < 0) {
+    return;
+  }
+  // read, passed in or returned by a call: not known
+  ConstValue val{ConstValue::CV_BOTTOM, 0};
+  switch (quad->m_op) {
+  case QO_ASSIGN:
+    val = Eval(quad->m_arg1, state);
+    break;
+  case QO_PLUS:
+  case QO_MINU:
+  case QO_MULT:
+  case QO_DIV: {
+    auto lhs = Eval(quad->m_arg1, state);
+    auto rhs = Eval(quad->m_arg2, state);
+    if (lhs.m_kind == ConstValue::CV_BOTTOM ||
+        rhs.m_kind == ConstValue::CV_BOTTOM) {
+      break;
+    }
+    if (lhs.m_kind == ConstValue::CV_TOP || rhs.m_kind == ConstValue::CV_TOP) {
+      val.m_kind = ConstValue::CV_TOP;
+    }
+    else if (fold(quad->m_op, lhs.m_val, rhs.m_val, val.m_val)) {
+      val.m_kind = ConstValue::CV_CONST;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  state.m_vals[id] = val;
+}
+
+int ConstPropagation::Decide(Quadruple *branch,
+                             const ConstState &state) const
+{
+  auto lhs = Eval(branch->m_arg1, state);
+  auto rhs = branch->m_arg2 ? Eval(branch->m_arg2, state) :
+                              ConstValue{ConstValue::CV_CONST, 0};
+  if (lhs.m_kind != ConstValue::CV_CONST ||
+      rhs.m_kind != ConstValue::CV_CONST) {
+    return -1;
+  }
+  return taken(branch->m_op, lhs.m_val, rhs.m_val) ? 1 : 0;
+}
+
+bool ConstPropagation::Rewrite()
+{
+  bool changed = false;
+  auto literal = [](QuadAddr *like, int32_t val) {
+    auto type = like->IsChar() ? QuadAddr::AT_CHARL : QuadAddr::AT_INTL;
+    return QuadAddr::New(type, long(val));
+  };
+
+  for (auto bb : m_cfg->m_blocks) {
+    auto state = m_in[bb->m_id];
+    if (!state.m_reached) {
+      changed |= !bb->m_quads.empty();
+      bb->m_quads.clear();
+      continue;
+    }
+    FuncInfo::QuadList quads;
+    for (auto quad : bb->m_quads) {
+      quad->RewriteUses([&](QuadAddr *qa) {
+        auto id = Id(qa);
+        if (id < 0 || state.m_vals[id].m_kind != ConstValue::CV_CONST) {
+          return qa;
+        }
+        changed = true;
+        return literal(qa, state.m_vals[id].m_val);
+      });
+      Step(quad, state);
+
+      auto def = Id(quad->Def());
+      auto arith = quad->m_op >= QO_PLUS && quad->m_op <= QO_DIV;
+      if (arith && def >= 0 &&
+          state.m_vals[def].m_kind == ConstValue::CV_CONST) {
+        quad->m_op = QO_ASSIGN;
+        quad->m_arg1 = literal(quad->m_dst, state.m_vals[def].m_val);
+        quad->m_arg2 = nullptr;
+        changed = true;
+      }
+      else if (IsCondBranch(quad->m_op)) {
+        auto decision = Decide(quad, state);
+        if (decision == 0) {
+          changed = true;
+          continue;
+        }
+        if (decision == 1) {
+          quad->m_op = QO_GOTO;
+          quad->m_arg1 = quad->m_arg2 = nullptr;
+          changed = true;
+        }
+      }
+      quads.push_back(quad);
+    }
+    bb->m_quads.swap(quads);
+  }
+  return changed;
+}
+
+bool PropagateConstants(FlowGraph *cfg)
+{
+  ConstPropagation sccp(cfg);
+  sccp.Solve();
+  return sccp.Rewrite();
+}
+
+static bool removable(const Quadruple *quad)
+{
+  switch (quad->m_op) {
+  case QO_ASSIGN:
+  case QO_PLUS:
+  case QO_MINU:
+  case QO_MULT:
+  case QO_DIV:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool EliminateDeadCode(FlowGraph *cfg)
+{
+  bool changed = false;
+  for (auto bb : cfg->m_blocks) {
+    if (!bb->IsReachable() && !bb->m_quads.empty()) {
+      bb->m_quads.clear();
+      changed = true;
+    }
+  }
+
+  std::map<QuadAddr *, int> ids;
+  NumberLocals(cfg, ids);
+  // a quad dying may leave the ones feeding it dead
+  for (bool again = true; again;) {
+    Liveness live(cfg, ids);
+    std::set<Quadruple *> dead;
+    for (auto bb : cfg->m_blocks) {
+      live.EachQuad(bb, [&](Quadruple *quad, const BitSet &after) {
+        auto it = ids.find(quad->Def());
+        if (it != ids.end() && !after.Test(it->second) && removable(quad)) {
+          dead.insert(quad);
+        }
+      });
+    }
+    for (auto bb : cfg->m_blocks) {
+      auto &quads = bb->m_quads;
+      quads.erase(std::remove_if(quads.begin(), quads.end(),
+                                 [&dead](Quadruple *quad) {
+                                   return dead.count(quad) > 0;
+                                 }),
+                  quads.end());
+    }
+    again = !dead.empty();
+    changed |= again;
+  }
+  return changed;
+}
+
+static bool isliteral(const QuadAddr *qa)
+{
+  return qa->m_type == QuadAddr::AT_INTL || qa->m_type == QuadAddr::AT_CHARL;
+}
+
+// an array element or a global
+static bool ismemory(const QuadAddr *qa)
+{
+  return qa->m_type == QuadAddr::AT_ARRAY ||
+         (qa->m_type == QuadAddr::AT_IDENT && qa->m_isglb);
+}
+
+namespace {
+
+// op and operands: a local's leader, or the literal with a null local
+using ValueKey = std::tuple<int, QuadAddr *, long, QuadAddr *, long>;
+
+// a value computed, or read from an array element or global
+struct Available {
+  QuadAddr *m_val;
+  BasicBlock *m_bb;   // where it was computed or read
+  intptr_t m_base;    // array or global read, 0 for arithmetic
+  bool m_global;
+};
+
+// arrays and globals written in a region, and whether it calls
+struct Clobbers {
+  bool Kills(const Available &avail) const
+  {
+    return avail.m_base &&
+           ((m_call && avail.m_global) || m_bases.count(avail.m_base));
+  }
+  void Union(const Clobbers &other)
+  {
+    m_bases.insert(other.m_bases.begin(), other.m_bases.end());
+    m_call |= other.m_call;
+  }
+
+  std::set<intptr_t> m_bases;
+  bool m_call{false};
+};
+
+/**
+ * Dominator-based value numbering (Briggs, Cooper and Simpson) over SSA
+ * versions: a table of the values available, scoped to the dominator
+ * tree. A read of memory stays available down the tree until a store to
+ * the same array or global, or a call for a global, may come in between.
+ */
+class ValueNumbering {
+public:
+  explicit ValueNumbering(FlowGraph *cfg);
+
+  bool Run();
+
+private:
+  struct Undo {
+    ValueKey m_key;
+    bool m_had;
+    Available m_old;
+  };
+
+  QuadAddr *Value(QuadAddr *qa) const
+  {
+    auto it = m_values.find(qa);
+    return it == m_values.end() ? qa : it->second;
+  }
+  // a value known by its operands, false if one of them is not
+  bool Operand(QuadAddr *qa, QuadAddr *&local, long &lit) const;
+  bool Key(Quadruple *quad, ValueKey &key) const;
+  bool MemoryKey(QuadAddr *mem, ValueKey &key) const;
+
+  QuadAddr *Lookup(const ValueKey &key, BasicBlock *bb);
+  void Record(const ValueKey &key, const Available &avail);
+  void Clobber(const Clobbers &clobbers);
+  const Clobbers &Between(BasicBlock *from, BasicBlock *to);
+  bool Visit(BasicBlock *bb);
+
+  FlowGraph *m_cfg;
+  std::map<ValueKey, Available> m_table;
+  std::vector<Undo> m_undo;
+  std::map<QuadAddr *, QuadAddr *> m_values;  // leader of each local
+  std::vector<Clobbers> m_clobbers;           // by block id
+  std::map<std::pair<int, int>, Clobbers> m_between;
+};
+
+}  // namespace
+
+static Clobbers clobbered(const BasicBlock *bb)
+{
+  Clobbers ret;
+  for (auto quad : bb->m_quads) {
+    if (quad->m_op == QO_CALL) {
+      ret.m_call = true;
+    }
+    else if ((quad->m_op == QO_ASSIGN || quad->m_op == QO_SCAN) &&
+             ismemory(quad->m_dst)) {
+      ret.m_bases.insert(quad->m_dst->m_data);
+    }
+  }
+  return ret;
+}
+
+ValueNumbering::ValueNumbering(FlowGraph *cfg) : m_cfg(cfg)
+{
+  for (auto bb : cfg->m_blocks) {
+    m_clobbers.push_back(clobbered(bb));
+  }
+}
+
+bool ValueNumbering::Operand(QuadAddr *qa, QuadAddr *&local, long &lit) const
+{
+  qa = Value(qa);
+  if (isliteral(qa)) {
+    local = nullptr;
+    lit = qa->m_data;
+    return true;
+  }
+  local = qa;
+  lit = 0;
+  return qa->IsLocal();
+}
+
+bool ValueNumbering::Key(Quadruple *quad, ValueKey &key) const
+{
+  QuadAddr *lhs, *rhs;
+  long llit, rlit;
+  if (!Operand(quad->m_arg1, lhs, llit) || !Operand(quad->m_arg2, rhs, rlit)) {
+    return false;
+  }
+  auto commutes = quad->m_op == QO_PLUS || quad->m_op == QO_MULT;
+  if (commutes && std::make_pair(rhs, rlit) < std::make_pair(lhs, llit)) {
+    std::swap(lhs, rhs);
+    std::swap(llit, rlit);
+  }
+  key = std::make_tuple(int(quad->m_op), lhs, llit, rhs, rlit);
+  return true;
+}
+
+// a read of an array element or global: the base, then the index if any
+bool ValueNumbering::MemoryKey(QuadAddr *mem, ValueKey &key) const
+{
+  QuadAddr *index = nullptr;
+  long lit = 0;
+  if (mem->m_type == QuadAddr::AT_ARRAY &&
+      !Operand(mem->m_minion, index, lit)) {
+    return false;
+  }
+  key = std::make_tuple(int(QO_ASSIGN), nullptr, long(mem->m_data), index, lit);
+  return true;
+}
+
+QuadAddr *ValueNumbering::Lookup(const ValueKey &key, BasicBlock *bb)
+{
+  auto it = m_table.find(key);
+  if (it == m_table.end()) {
+    return nullptr;
+  }
+  auto &avail = it->second;
+  if (avail.m_bb != bb && Between(avail.m_bb, bb).Kills(avail)) {
+    return nullptr;
+  }
+  return avail.m_val;
+}
+
+void ValueNumbering::Record(const ValueKey &key, const Available &avail)
+{
+  auto it = m_table.find(key);
+  if (it == m_table.end()) {
+    m_undo.push_back({key, false, avail});
+    m_table.emplace(key, avail);
+  }
+  else {
+    m_undo.push_back({key, true, it->second});
+    it->second = avail;
+  }
+}
+
+void ValueNumbering::Clobber(const Clobbers &clobbers)
+{
+  for (auto it = m_table.begin(); it != m_table.end();) {
+    if (clobbers.Kills(it->second)) {
+      m_undo.push_back({it->first, true, it->second});
+      it = m_table.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+/**
+ * @brief What the blocks on a path from `from` to `to` may write, `from`
+ *   left out: the blocks reaching `to` without passing `from`.
+ */
+const Clobbers &ValueNumbering::Between(BasicBlock *from, BasicBlock *to)
+{
+  auto key = std::make_pair(from->m_id, to->m_id);
+  auto it = m_between.find(key);
+  if (it != m_between.end()) {
+    return it->second;
+  }
+  auto &ret = m_between[key];
+  std::vector<bool> seen(m_cfg->m_blocks.size());
+  std::vector<BasicBlock *> work(to->m_preds.begin(), to->m_preds.end());
+  while (!work.empty()) {
+    auto bb = work.back();
+    work.pop_back();
+    if (bb == from || !bb->IsReachable() || seen[bb->m_id]) {
+      continue;
+    }
+    seen[bb->m_id] = true;
+    ret.Union(m_clobbers[bb->m_id]);
+    work.insert(work.end(), bb->m_preds.begin(), bb->m_preds.end());
+  }
+  return ret;
+}
+
+// a quad computing a value available already copies it instead
+bool ValueNumbering::Visit(BasicBlock *bb)
+{
+  bool changed = false;
+  auto reuse = [&](Quadruple *quad, QuadAddr *val) {
+    quad->m_op = QO_ASSIGN;
+    quad->m_arg1 = val;
+    quad->m_arg2 = nullptr;
+    m_values[quad->m_dst] = val;
+    changed = true;
+  };
+
+  for (auto quad : bb->m_quads) {
+    auto def = quad->Def();
+    if (def && !def->IsLocal()) {
+      def = nullptr;
+    }
+    ValueKey key;
+    switch (quad->m_op) {
+    case QO_PLUS:
+    case QO_MINU:
+    case QO_MULT:
+    case QO_DIV:
+      if (!def || !def->IsLocal() || !Key(quad, key)) {
+        break;
+      }
+      if (auto val = Lookup(key, bb)) {
+        reuse(quad, val);
+      }
+      else {
+        Record(key, {def, bb, 0, false});
+      }
+      break;
+    case QO_ASSIGN: {
+      auto src = quad->m_arg1;
+      if (def && ismemory(src)) {
+        if (!MemoryKey(src, key)) {
+          break;
+        }
+        if (auto val = Lookup(key, bb)) {
+          reuse(quad, val);
+        }
+        else {
+          Record(key, {def, bb, src->m_data, src->m_isglb});
+        }
+      }
+      else if (def) {
+        m_values[def] = Value(src);
+      }
+      else {
+        // a store: what is read back from there next is what was stored
+        Clobbers clobbers;
+        clobbers.m_bases.insert(quad->m_dst->m_data);
+        Clobber(clobbers);
+        if ((isliteral(src) || src->IsLocal()) && MemoryKey(quad->m_dst, key)) {
+          Record(key, {Value(src), bb, quad->m_dst->m_data,
+                       quad->m_dst->m_isglb});
+        }
+      }
+      break;
+    }
+    case QO_SCAN:
+      if (ismemory(quad->m_dst)) {
+        Clobbers clobbers;
+        clobbers.m_bases.insert(quad->m_dst->m_data);
+        Clobber(clobbers);
+      }
+      break;
+    case QO_CALL: {
+      Clobbers clobbers;
+      clobbers.m_call = true;
+      Clobber(clobbers);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  return changed;
+}
+
+bool ValueNumbering::Run()
+{
+  bool changed = false;
+  // dominator tree preorder, undoing a block's entries on the way back
+  std::vector<std::pair<BasicBlock *, size_t>> stack;
+  std::vector<size_t> marks;
+  auto enter = [&](BasicBlock *bb) {
+    marks.push_back(m_undo.size());
+    changed |= Visit(bb);
+    stack.emplace_back(bb, 0);
+  };
+
+  enter(m_cfg->Entry());
+  while (!stack.empty()) {
+    auto &top = stack.back();
+    auto &kids = top.first->m_children;
+    if (top.second < kids.size()) {
+      enter(kids[top.second++]);
+      continue;
+    }
+    for (; m_undo.size() > marks.back(); m_undo.pop_back()) {
+      auto &undo = m_undo.back();
+      if (undo.m_had) {
+        m_table[undo.m_key] = undo.m_old;
+      }
+      else {
+        m_table.erase(undo.m_key);
+      }
+    }
+    marks.pop_back();
+    stack.pop_back();
+  }
+  return changed;
+}
+
+bool NumberValues(FlowGraph *cfg)
+{
+  return ValueNumbering(cfg).Run();
+}
+
+// the one block from outside a loop entering it, nullptr if there is none
+static BasicBlock *preheader(const Loop *loop)
+{
+  BasicBlock *ret = nullptr;
+  for (auto pred : loop->m_header->m_preds) {
+    if (!pred->IsReachable() || loop->Contains(pred)) {
+      continue;
+    }
+    if (ret || pred->m_succs.size() != 1) {
+      return nullptr;
+    }
+    ret = pred;
+  }
+  return ret;
+}
+
+// add a quad to the end of a block, before its branch or goto if any
+static void append(BasicBlock *bb, Quadruple *quad)
+{
+  auto at = bb->Terminator() ? bb->m_quads.end() - 1 : bb->m_quads.end();
+  bb->m_quads.insert(at, quad);
+}
+
+bool InsertPreheaders(FlowGraph *cfg)
+{
+  auto func = cfg->m_func;
+  // quads to go after the last one of a block, by id
+  std::vector<FuncInfo::QuadList> tails(cfg->m_blocks.size());
+  for (auto loop : cfg->m_loops) {
+    if (preheader(loop)) {
+      continue;
+    }
+    auto head = loop->m_header;
+    assert(head->Label() && head->m_id > 0);
+    auto label = func->NewLabel();
+    for (auto pred : head->m_preds) {
+      auto term = pred->Terminator();
+      if (!loop->Contains(pred) && term && term->m_op != QO_RETURN &&
+          JumpTarget(term) == head->Label()) {
+        term->m_dst = label;
+      }
+    }
+    // the block laid out before the header falls into the preheader now
+    auto layout = cfg->m_blocks[head->m_id - 1];
+    auto term = layout->Terminator();
+    auto &tail = tails[layout->m_id];
+    if (loop->Contains(layout) && (!term || IsCondBranch(term->m_op))) {
+      tail.push_back(Quadruple::New(QO_GOTO, head->m_quads.front()->m_dst));
+    }
+    tail.push_back(Quadruple::New(QO_LABEL, label));
+  }
+
+  bool changed = false;
+  for (auto bb : cfg->m_blocks) {
+    auto &tail = tails[bb->m_id];
+    bb->m_quads.insert(bb->m_quads.end(), tail.begin(), tail.end());
+    changed |= !tail.empty();
+  }
+  return changed;
+}
+
+bool HoistInvariants(FlowGraph *cfg)
+{
+  std::map<QuadAddr *, BasicBlock *> defs;
+  for (auto bb : cfg->m_blocks) {
+    for (auto quad : bb->m_quads) {
+      if (quad->Def() && quad->Def()->IsLocal()) {
+        defs[quad->Def()] = bb;
+      }
+    }
+  }
+
+  bool changed = false;
+  // inner loops first, so what leaves one may leave the next one out too
+  for (auto it = cfg->m_loops.rbegin(); it != cfg->m_loops.rend(); ++it) {
+    auto loop = *it;
+    auto pre = preheader(loop);
+    if (!pre) {
+      continue;
+    }
+    Clobbers clobbers;
+    BasicBlock::BlockList exits;
+    for (auto bb : loop->m_blocks) {
+      clobbers.Union(clobbered(bb));
+      for (auto succ : bb->m_succs) {
+        if (succ == cfg->Exit() || !loop->Contains(succ)) {
+          exits.push_back(bb);
+          break;
+        }
+      }
+    }
+
+    auto invariant = [&](QuadAddr *qa) {
+      if (isliteral(qa)) {
+        return true;
+      }
+      auto def = defs.find(qa);
+      return qa->IsLocal() &&
+             (def == defs.end() || !loop->Contains(def->second));
+    };
+    // run on every way out of the loop, so a fault moved out would have
+    // happened anyway
+    auto always = [&](BasicBlock *bb) {
+      for (auto exit : exits) {
+        if (!cfg->Dominates(bb, exit)) {
+          return false;
+        }
+      }
+      return true;
+    };
+    auto hoistable = [&](BasicBlock *bb, Quadruple *quad) {
+      auto def = quad->Def();
+      if (!def || !def->IsLocal()) {
+        return false;
+      }
+      auto src = quad->m_arg1;
+      switch (quad->m_op) {
+      case QO_PLUS:
+      case QO_MINU:
+      case QO_MULT:
+        return invariant(src) && invariant(quad->m_arg2);
+      case QO_DIV:
+        return invariant(src) && invariant(quad->m_arg2) &&
+               ((isliteral(quad->m_arg2) && quad->m_arg2->m_data) ||
+                always(bb));
+      case QO_ASSIGN:
+        // a copy or literal costs no more than in the loop, and holds on
+        if (!ismemory(src)) {
+          return false;
+        }
+        if (clobbers.Kills({nullptr, nullptr, src->m_data, src->m_isglb})) {
+          return false;
+        }
+        return src->m_type != QuadAddr::AT_ARRAY ||
+               (invariant(src->m_minion) && always(bb));
+      default:
+        return false;
+      }
+    };
+
+    for (bool again = true; again;) {
+      again = false;
+      for (auto bb : loop->m_blocks) {
+        auto &quads = bb->m_quads;
+        for (auto q = quads.begin(); q != quads.end();) {
+          if (!hoistable(bb, *q)) {
+            ++q;
+            continue;
+          }
+          append(pre, *q);
+          defs[(*q)->Def()] = pre;
+          q = quads.erase(q);
+          again = changed = true;
+        }
+      }
+    }
+  }
+  return changed;
+}
+
+namespace {
+
+// where a multiple of an induction variable is read
+struct ScaledUse {
+  Quadruple *m_quad;
+  QuadAddr **m_operand;  // array operand, nullptr for a multiplication
+  bool m_next;           // of the value after the step
+};
+
+}  // namespace
+
+/**
+ * @brief The basic induction variable a header phi merges, if it does: the
+ *   same version back from every latch, stepped by a literal in the loop.
+ *   Sets `next` to that version and `step` to what it adds.
+ */
+static bool induction(const Loop *loop,
+                      Quadruple *phi,
+                      const std::map<QuadAddr *, Quadruple *> &defs,
+                      QuadAddr *&next,
+                      int32_t &step)
+{
+  auto head = loop->m_header;
+  next = nullptr;
+  for (size_t i = 0; i < head->m_preds.size(); ++i) {
+    if (!loop->Contains(head->m_preds[i])) {
+      continue;
+    }
+    if (next && phi->m_phiargs[i] != next) {
+      return false;
+    }
+    next = phi->m_phiargs[i];
+  }
+  auto it = defs.find(next);
+  if (phi->m_dst->IsChar() || it == defs.end()) {
+    return false;
+  }
+  auto quad = it->second;
+  auto lhs = quad->m_arg1, rhs = quad->m_arg2;
+  if (quad->m_op == QO_PLUS && rhs == phi->m_dst) {
+    std::swap(lhs, rhs);
+  }
+  if ((quad->m_op != QO_PLUS && quad->m_op != QO_MINU) ||
+      lhs != phi->m_dst || !isliteral(rhs)) {
+    return false;
+  }
+  step = quad->m_op == QO_PLUS ? int32_t(rhs->m_data) : -int32_t(rhs->m_data);
+  return true;
+}
+
+bool ReduceStrength(FlowGraph *cfg)
+{
+  auto func = cfg->m_func;
+  std::map<QuadAddr *, Quadruple *> defs;
+  for (auto bb : cfg->m_blocks) {
+    for (auto quad : bb->m_quads) {
+      if (quad->Def()) {
+        defs[quad->Def()] = quad;
+      }
+    }
+  }
+
+  bool changed = false;
+  for (auto loop : cfg->m_loops) {
+    auto pre = preheader(loop);
+    if (!pre) {
+      continue;
+    }
+    auto head = loop->m_header;
+    FuncInfo::QuadList phis;
+    for (auto quad : head->m_quads) {
+      if (quad->m_op == QO_PHI) {
+        phis.push_back(quad);
+      }
+    }
+
+    for (auto phi : phis) {
+      QuadAddr *next;
+      int32_t step;
+      if (!induction(loop, phi, defs, next, step)) {
+        continue;
+      }
+      auto iv = phi->m_dst;
+      std::map<int32_t, std::vector<ScaledUse>> uses;  // by scale
+      std::map<int32_t, bool> mults;
+      for (auto bb : loop->m_blocks) {
+        for (auto quad : bb->m_quads) {
+          for (auto operand : {&quad->m_dst, &quad->m_arg1}) {
+            auto qa = *operand;
+            if (quad->m_op == QO_ASSIGN && qa &&
+                qa->m_type == QuadAddr::AT_ARRAY && !qa->m_scaled &&
+                (qa->m_minion == iv || qa->m_minion == next)) {
+              uses[4].push_back({quad, operand, qa->m_minion == next});
+            }
+          }
+          if (quad->m_op != QO_MULT) {
+            continue;
+          }
+          auto lhs = quad->m_arg1, rhs = quad->m_arg2;
+          if (isliteral(lhs)) {
+            std::swap(lhs, rhs);
+          }
+          if ((lhs == iv || lhs == next) && isliteral(rhs)) {
+            uses[int32_t(rhs->m_data)].push_back({quad, nullptr, lhs == next});
+            mults[int32_t(rhs->m_data)] = true;
+          }
+        }
+      }
+
+      // a multiple stepped along with the variable instead of scaled each
+      // time: its step, li and addu or a single addiu, is worth it for
+      // more shifts than it takes instructions, or for a multiplication
+#ifdef IMM_OPERANDS
+      const size_t worth = 2;
+#else
+      const size_t worth = 3;
+#endif  // IMM_OPERANDS
+      for (auto &entry : uses) {
+        auto scale = entry.first;
+        if (entry.second.size() < worth && !mults[scale]) {
+          continue;
+        }
+        auto literal = [](int32_t val) {
+          return QuadAddr::New(QuadAddr::AT_INTL, long(val));
+        };
+        auto &preds = head->m_preds;
+        auto index = std::find(preds.begin(), preds.end(), pre) - preds.begin();
+        auto init = phi->m_phiargs[index];
+        // versions of a new temporary, so leaving SSA joins them up
+        auto var = func->NewTemp();
+        auto version = [func, var](int n) {
+          return QuadAddr::New(var, n, func->NewSlot(4));
+        };
+        QuadAddr *first;
+        if (isliteral(init)) {
+          first = literal(int32_t(uint32_t(init->m_data) * uint32_t(scale)));
+        }
+        else {
+          first = version(3);
+          append(pre, Quadruple::New(QO_MULT, first, init, literal(scale)));
+        }
+        auto cur = version(1), after = version(2);
+        auto merge = Quadruple::New(QO_PHI, cur);
+        for (auto pred : head->m_preds) {
+          merge->m_phiargs.push_back(pred == pre ? first : after);
+        }
+        head->m_quads.insert(head->m_quads.begin() + 1, merge);
+        auto update = defs[next];
+        for (auto bb : loop->m_blocks) {
+          auto at = std::find(bb->m_quads.begin(), bb->m_quads.end(), update);
+          if (at != bb->m_quads.end()) {
+            auto delta = int32_t(uint32_t(step) * uint32_t(scale));
+            bb->m_quads.insert(at + 1, Quadruple::New(QO_PLUS, after, cur,
+                                                      literal(delta)));
+            break;
+          }
+        }
+
+        for (auto &use : entry.second) {
+          auto val = use.m_next ? after : cur;
+          if (use.m_operand) {
+            auto qa = *use.m_operand;
+            auto scaled = QuadAddr::New(QuadAddr::AT_ARRAY, qa, val,
+                                        qa->m_islval);
+            scaled->m_scaled = true;
+            *use.m_operand = scaled;
+          }
+          else {
+            use.m_quad->m_op = QO_ASSIGN;
+            use.m_quad->m_arg1 = val;
+            use.m_quad->m_arg2 = nullptr;
+          }
+        }
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+// label quad a jump to `bb` names, one made up if it has none
+static QuadAddr *label(FuncInfo *func, BasicBlock *bb)
+{
+  if (!bb->Label()) {
+    auto quad = Quadruple::New(QO_LABEL, func->NewLabel());
+    bb->m_quads.insert(bb->m_quads.begin(), quad);
+  }
+  return bb->m_quads.front()->m_dst;
+}
+
+// where a jump to `bb` ends up, past blocks of labels and a goto at most
+static BasicBlock *thread(FlowGraph *cfg, BasicBlock *bb)
+{
+  auto &blocks = cfg->m_blocks;
+  std::set<BasicBlock *> seen;
+  while (seen.insert(bb).second) {
+    auto &quads = bb->m_quads;
+    auto it = std::find_if(quads.begin(), quads.end(), [](Quadruple *quad) {
+      return quad->m_op != QO_LABEL;
+    });
+    BasicBlock *next = nullptr;
+    if (it == quads.end()) {
+      if (bb->m_id + 1 < int(blocks.size())) {
+        next = blocks[bb->m_id + 1];
+      }
+    }
+    else if (it + 1 == quads.end() && (*it)->m_op == QO_GOTO) {
+      next = cfg->Target(*it);
+    }
+    if (!next || !next->Label()) {
+      break;
+    }
+    bb = next;
+  }
+  return bb;
+}
+
+bool LayoutBlocks(FlowGraph *cfg)
+{
+  auto &blocks = cfg->m_blocks;
+  auto n = blocks.size();
+  // the block laid out after, nullptr for the end of the function
+  auto next = [&](const BasicBlock *bb) {
+    return bb->m_id + 1 < int(n) ? blocks[bb->m_id + 1] : nullptr;
+  };
+  bool changed = false;
+
+  for (auto bb : blocks) {
+    auto term = bb->Terminator();
+    if (!term || term->m_op == QO_RETURN) {
+      continue;
+    }
+    auto target = thread(cfg, cfg->Target(term));
+    if (target != cfg->Target(term)) {
+      term->m_dst = label(cfg->m_func, target);
+      changed = true;
+    }
+  }
+
+  // reachable over the jumps threaded, the others emptied
+  std::vector<bool> reached(n);
+  BasicBlock::BlockList stack{cfg->Entry()};
+  reached[0] = true;
+  while (!stack.empty()) {
+    auto bb = stack.back();
+    stack.pop_back();
+    auto term = bb->Terminator();
+    BasicBlock::BlockList succs;
+    if (term && term->m_op != QO_RETURN) {
+      succs.push_back(cfg->Target(term));
+    }
+    if ((!term || IsCondBranch(term->m_op)) && next(bb)) {
+      succs.push_back(next(bb));
+    }
+    for (auto succ : succs) {
+      if (!reached[succ->m_id]) {
+        reached[succ->m_id] = true;
+        stack.push_back(succ);
+      }
+    }
+  }
+  for (auto bb : blocks) {
+    if (!reached[bb->m_id] && !bb->m_quads.empty()) {
+      bb->m_quads.clear();
+      changed = true;
+    }
+  }
+
+  // the end the function may fall off stays last
+  std::vector<bool> placed(n);
+  auto last = blocks.back()->Terminator();
+  size_t tail = !last || IsCondBranch(last->m_op) ? n - 1 : n;
+  if (tail < n) {
+    placed[tail] = true;
+  }
+  // no block falls into it as laid out
+  auto movable = [&](const BasicBlock *bb) {
+    if (placed[bb->m_id]) {
+      return false;
+    }
+    auto prev = blocks[bb->m_id - 1];
+    auto term = prev->Terminator();
+    return !reached[prev->m_id] || (term && IsJump(term->m_op));
+  };
+  // a loop tested at the top goes after the block going back to it, the
+  // latch, to be tested at the bottom
+  BasicBlock::BlockList latch(n);
+  for (auto loop : cfg->m_loops) {
+    auto head = loop->m_header;
+    auto term = head->Terminator();
+    if (!reached[head->m_id] || !term || !IsCondBranch(term->m_op) ||
+        movable(head) || placed[head->m_id]) {
+      continue;
+    }
+    for (auto pred : head->m_preds) {
+      auto jump = pred->Terminator();
+      if (loop->Contains(pred) && reached[pred->m_id] && jump &&
+          jump->m_op == QO_GOTO && cfg->Target(jump) == head &&
+          pred->m_id > head->m_id &&
+          (!latch[head->m_id] || pred->m_id > latch[head->m_id]->m_id)) {
+        latch[head->m_id] = pred;
+      }
+    }
+  }
+  // chains of blocks each falling into or going to the one after
+  auto follow = [&](const BasicBlock *bb) -> BasicBlock * {
+    auto term = bb->Terminator();
+    auto ft = next(bb);
+    if ((!term || IsCondBranch(term->m_op)) && ft && !placed[ft->m_id] &&
+        !latch[ft->m_id]) {
+      return ft;
+    }
+    if (!term || term->m_op == QO_RETURN) {
+      return nullptr;
+    }
+    auto target = cfg->Target(term);
+    if (latch[target->m_id] ? latch[target->m_id] == bb : movable(target)) {
+      return target;
+    }
+    return nullptr;
+  };
+  BasicBlock::BlockList order;
+  auto chain = [&](BasicBlock *head) {
+    for (auto bb = head; bb && reached[bb->m_id] && !placed[bb->m_id];
+         bb = follow(bb)) {
+      placed[bb->m_id] = true;
+      order.push_back(bb);
+    }
+  };
+  // one without a label goes after the block falling into it, unless it
+  // is a latch reached from its header only
+  for (auto head : blocks) {
+    if (!latch[head->m_id] && (head->m_id == 0 || head->Label())) {
+      chain(head);
+    }
+  }
+  for (auto head : blocks) {
+    if (!latch[head->m_id]) {
+      chain(head);
+    }
+  }
+  for (auto head : blocks) {
+    chain(head);
+  }
+  order.insert(order.end(), blocks.begin() + tail, blocks.end());
+
+  // branches and gotos after the blocks moved
+  for (size_t i = 0; i < order.size(); ++i) {
+    auto bb = order[i];
+    auto after = i + 1 < order.size() ? order[i + 1] : nullptr;
+    auto ft = next(bb);
+    auto term = bb->Terminator();
+    if (term && term->m_op == QO_RETURN) {
+      continue;
+    }
+    if (term && term->m_op == QO_GOTO) {
+      if (cfg->Target(term) == after) {
+        bb->m_quads.pop_back();
+        changed = true;
+      }
+      continue;
+    }
+    if (term && cfg->Target(term) == ft) {
+      bb->m_quads.pop_back();
+      changed = true;
+    }
+    else if (term && cfg->Target(term) == after && ft != after) {
+      term->m_op = (QuadOp)(term->m_op * -1);
+      term->m_dst = label(cfg->m_func, ft);
+      ft = after;
+      changed = true;
+    }
+    if (ft != after) {
+      auto jump = Quadruple::New(QO_GOTO, label(cfg->m_func, ft));
+      bb->m_quads.push_back(jump);
+      changed = true;
+    }
+  }
+  // a jump left going past blocks emptied above only, along with what
+  // its test would have loaded
+  for (size_t i = 0; i < order.size(); ++i) {
+    auto term = order[i]->Terminator();
+    if (!term || term->m_op == QO_RETURN) {
+      continue;
+    }
+    auto target = cfg->Target(term);
+    auto j = i + 1;
+    for (; j < order.size() && order[j] != target; ++j) {
+      auto &quads = order[j]->m_quads;
+      if (std::any_of(quads.begin(), quads.end(), [](Quadruple *quad) {
+            return quad->m_op != QO_LABEL;
+          })) {
+        break;
+      }
+    }
+    if (j < order.size() && order[j] == target) {
+      order[i]->m_quads.pop_back();
+      changed = true;
+    }
+  }
+
+  // labels no jump names
+  std::set<LabelStmt *> named;
+  for (auto bb : order) {
+    for (auto quad : bb->m_quads) {
+      if (IsCondBranch(quad->m_op) || quad->m_op == QO_GOTO) {
+        named.insert(JumpTarget(quad));
+      }
+    }
+  }
+  for (auto bb : order) {
+    auto &quads = bb->m_quads;
+    auto end = std::remove_if(quads.begin(), quads.end(), [&](Quadruple *q) {
+      return q->m_op == QO_LABEL && !named.count(JumpTarget(q));
+    });
+    changed |= end != quads.end();
+    quads.erase(end, quads.end());
+  }
+
+  changed |= !std::equal(order.begin(), order.end(), blocks.begin());
+  // the ones left out are empty
+  for (size_t i = 0; i < tail; ++i) {
+    if (!reached[i]) {
+      order.push_back(blocks[i]);
+    }
+  }
+  blocks = order;
+  return changed;
+}
@@ -0,0 +1,65 @@
+#ifndef C0C_OPTIMIZER_H
+#define C0C_OPTIMIZER_H
+
+#include "cfg.h"
+
+/*
+ * Passes over the flow graph of a function. Each works on the quads of the
+ * blocks and returns whether it changed any; the graph is to be flattened
+ * and built again after a change to the branches.
+ */
+
+/**
+ * Sparse conditional constant propagation (Wegman and Zadeck): locals and
+ * temporaries known to hold a constant are replaced by it, quads computing
+ * one become assignments, branches deciding on one become gotos or go
+ * away, and blocks reached by none of the edges left are emptied.
+ */
+bool PropagateConstants(FlowGraph *cfg);
+
+/**
+ * Removes quads writing a local or temporary no one reads afterwards, and
+ * the quads of unreachable blocks. Calls, reads and parameters stay.
+ */
+bool EliminateDeadCode(FlowGraph *cfg);
+
+/**
+ * Value numbering over the dominator tree, on SSA form (ssa.h): arithmetic
+ * computed already, and array elements and globals read or stored already
+ * with no store or call in between, are copied instead of computed or read
+ * again. The copies are left to copy propagation.
+ */
+bool NumberValues(FlowGraph *cfg);
+
+/**
+ * Gives every loop a preheader: a block of its own entering the header
+ * from outside, for what is moved out of the loop to go.
+ */
+bool InsertPreheaders(FlowGraph *cfg);
+
+/**
+ * Loop-invariant code motion on SSA form: arithmetic on values computed
+ * outside a loop, and reads of arrays and globals no quad in it writes,
+ * move to its preheader. What may fault moves only when it runs on every
+ * way out of the loop.
+ */
+bool HoistInvariants(FlowGraph *cfg);
+
+/**
+ * Strength reduction of induction variables on SSA form: an array indexed
+ * by, or a multiplication of, a variable stepped by a literal in a loop
+ * reads a multiple of it stepped along with it instead. Array indexes so
+ * get to be in bytes (QuadAddr::m_scaled).
+ */
+bool ReduceStrength(FlowGraph *cfg);
+
+/**
+ * Block placement: jumps to blocks of nothing but labels and a goto go
+ * where those do, blocks no jump reaches any more are emptied, and chains
+ * of blocks each falling into or going to the next are laid out in a row,
+ * the gotos between them dropped and branches inverted to fall through.
+ * Labels no jump names are removed.
+ */
+bool LayoutBlocks(FlowGraph *cfg);
+
+#endif  // !C0C_OPTIMIZER_H
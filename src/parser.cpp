@@ -4,8 +4,12 @@
 #include "iobase.h"
 #include "lexer.h"
 #include "scope.h"
+#include "thread_pool.h"
 
+#include <algorithm>
 #include <cstdarg>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
 #ifdef PRINT_OUTPUT
@@ -16,7 +20,9 @@ extern std::ofstream outstream;
 #ifndef DEBUG_PARSE_END
 #define DEBUG_PARSE_END(x)                                                     \
   do {                                                                         \
-    outstream << "<" << x << ">" << std::endl;                                 \
+    if (m_trace) {                                                             \
+      outstream << "<" << x << ">" << std::endl;                               \
+    }                                                                          \
   } while (0)
 #endif  // !DEBUG_PARSE_END
 #endif  // PRINT_OUTPUT && PRINT_PARSER
@@ -35,8 +41,10 @@ void Parser::Peek()
 
 #define DEBUG_PARSE_BEGIN(x)                                                   \
   do {                                                                         \
-    outstream << indent << "{" << x << std::endl;                              \
-    indent.append("  ");                                                       \
+    if (m_trace) {                                                             \
+      outstream << indent << "{" << x << std::endl;                            \
+      indent.append("  ");                                                     \
+    }                                                                          \
   } while (0)
 
 #ifdef DEBUG_PARSE_END
@@ -45,11 +53,13 @@ void Parser::Peek()
 #ifndef DEBUG_PARSE_END
 #define DEBUG_PARSE_END(x)                                                     \
   do {                                                                         \
-    outstream << "<" << x << ">" << std::endl;                                 \
-    indent.pop_back();                                                         \
-    indent.pop_back();                                                         \
-    outstream << indent << x << "}" << std::endl;                              \
-    Peek();                                                                    \
+    if (m_trace) {                                                             \
+      outstream << "<" << x << ">" << std::endl;                               \
+      indent.pop_back();                                                       \
+      indent.pop_back();                                                       \
+      outstream << indent << x << "}" << std::endl;                            \
+      Peek();                                                                  \
+    }                                                                          \
   } while (0)
 #endif  // DEBUG_PARSE_END
 
@@ -69,26 +79,20 @@ int Parser::Assert(size_t n, const TokenType type)
   auto ft = m_ts.At(n);
   if (ft->m_type != type) {
     if (type == SEMICN) {
-      // TODO prev() is enough?
-      if (!n) {
-        Error(m_ts.prev(), 'k');
-      }
-      else {
-        Error(m_ts[n - 1], 'k');
-      }
+      // complete but for it, the statement needs no recovery
+      Error(n ? m_ts[n - 1] : m_ts.prev(), 'k');
     }
     else if (type == WHILETK) {
-      Error(m_ts[n], 'n');
+      Panic(m_ts[n], 'n');
     }
     else if (type == RPARENT) {
-      Error(m_ts[n], 'l');
+      Panic(m_ts[n], 'l');
     }
     else if (type == RBRACK) {
-      Error(m_ts[n], 'm');
+      Panic(m_ts[n], 'm');
     }
     else {
-      // Error(ft, "expected %s, we got %s.", tokenlist[(type)],
-      //       tokenlist[ft->m_type]);
+      Panic(tokenlist[type]);
     }
     return -1;
   }
@@ -116,6 +120,108 @@ int Parser::CheckTokens(const int num, ...)
   return 0;
 }
 
+/**
+ * @brief Report a syntax error at the front token, unless one is being
+ *   recovered from already, and mute errors until resynchronised.
+ */
+void Parser::Panic(const char *expected)
+{
+  if (m_panic) {
+    return;
+  }
+  auto ft = m_ts[0];
+  Error(ft, "expected %s, we got %s.", expected, tokenlist[ft->m_type]);
+  m_panic = true;
+  MuteErrors(true);
+}
+
+// the same, for the syntax errors with a course error code
+void Parser::Panic(const Token *tok, char code)
+{
+  if (m_panic) {
+    return;
+  }
+  Error(tok, code);
+  m_panic = true;
+  MuteErrors(true);
+}
+
+void Parser::Recover()
+{
+  m_panic = false;
+  MuteErrors(false);
+}
+
+Parser::~Parser()
+{
+  if (m_panic) {
+    Recover();
+  }
+}
+
+/**
+ * @brief Drop tokens up to `type` or `other`, never past the end of input.
+ */
+void Parser::SkipUntil(const TokenType type, const TokenType other)
+{
+  while (!MatchFront(type) && !MatchFront(other) && !MatchFront(EOFTK)) {
+    m_ts.FlushFront();
+  }
+}
+
+/**
+ * @brief Statement level synchronisation: skip the rest of the broken
+ *   statement, up to and including its ';', or up to a '}' or a token
+ *   that starts a statement, where errors are reported again.
+ */
+void Parser::SyncStmt()
+{
+  auto prev = m_ts.prev();
+  if (prev == nullptr || (prev->m_type != SEMICN && prev->m_type != RBRACE)) {
+    for (;;) {
+      auto type = m_ts.GetFrontType();
+      if (type == SEMICN) {
+        m_ts.FlushFront();
+        break;
+      }
+      if (type == RBRACE || type == EOFTK || type == LBRACE || type == IFTK ||
+          type == WHILETK || type == DOTK || type == FORTK ||
+          type == PRINTFTK || type == SCANFTK || type == RETURNTK) {
+        break;
+      }
+      m_ts.FlushFront();
+    }
+  }
+  Recover();
+}
+
+/**
+ * @brief Declaration level synchronisation: skip to the next `const`,
+ *   `int`, `char` or `void` outside of any braces.
+ */
+void Parser::SyncDecl()
+{
+  int depth = 0;
+  for (;;) {
+    auto type = m_ts.GetFrontType();
+    if (type == EOFTK) {
+      break;
+    }
+    if (depth == 0 && (type == CONSTTK || type == INTTK || type == CHARTK ||
+                       type == VOIDTK)) {
+      break;
+    }
+    if (type == LBRACE) {
+      ++depth;
+    }
+    else if (type == RBRACE && depth > 0) {
+      --depth;
+    }
+    m_ts.FlushFront();
+  }
+  Recover();
+}
+
 #ifdef EXTRA_MIDEXAM
 
 /*
@@ -336,11 +442,18 @@ IntegerLiteral *Parser::ParseUnsignedIntegerLiteral()
     if (strlen(prev) > 1 && prev[0] == '0') {
       Error(res, 'a');
     }
+    if (strtoll(prev, nullptr, 10) > INT32_MAX) {
+      Error(res, "integer literal is too large.");
+      res = nullptr;
+    }
   }
 
 #ifdef DEBUG_PARSE_END
   DEBUG_PARSE_END("无符号整数");
 #endif
+  if (res == nullptr) {
+    return IntegerLiteral::New(nullptr, ExprType::T_INT, 0);
+  }
   return IntegerLiteral::New(res, ExprType::T_INT);
 }
 
@@ -445,6 +558,9 @@ bool Parser::ParseConstCharDef(CompoundStmt *cstmt)
   do {
     m_ts.PrintFront();
     auto tok = AssertFront(IDENFR);
+    if (tok == nullptr) {
+      return false;
+    }
     /* first look up in current scope, Error() if redef */
     auto res = m_curscope->FindInCurScope(tok->m_value);
     if (res != nullptr) {
@@ -463,9 +579,7 @@ bool Parser::ParseConstCharDef(CompoundStmt *cstmt)
     AssertFront(ASSIGN);
     if (m_ts.GetFrontType() != CHARCON) {
       Error(m_ts[0], 'o');
-      while (m_ts.GetFrontType() != SEMICN) {
-        m_ts.FlushFront();
-      }
+      SkipUntil(SEMICN);
       return false;
     }
     auto char_literal = ParseCharLiteral();
@@ -473,9 +587,7 @@ bool Parser::ParseConstCharDef(CompoundStmt *cstmt)
       if (ParseIntegerLiteral() == nullptr) {
         Error(m_ts.prev(), 'o');
       }
-      while (m_ts.GetFrontType() != SEMICN) {
-        m_ts.FlushFront();
-      }
+      SkipUntil(SEMICN);
       return false;
     }
     if (m_curscope->IsGlobalScope()) {
@@ -512,7 +624,9 @@ bool Parser::ParseConstIntDef(CompoundStmt *cstmt)
   assert(MatchFront(TokenType::INTTK));
   do {
     m_ts.PrintFront();
-    AssertFront(IDENFR);
+    if (AssertFront(IDENFR) == nullptr) {
+      return false;
+    }
     /* first look up in current scope, Error() if redef */
     auto res = m_curscope->FindInCurScope(m_ts.prev()->m_value);
     if (res != nullptr) {
@@ -532,9 +646,7 @@ bool Parser::ParseConstIntDef(CompoundStmt *cstmt)
     if (m_ts.GetFrontType() != MINU && m_ts.GetFrontType() != PLUS &&
         m_ts.GetFrontType() != INTCON) {
       Error(m_ts[0], 'o');
-      while (m_ts.GetFrontType() != SEMICN) {
-        m_ts.FlushFront();
-      }
+      SkipUntil(SEMICN);
       return false;
     }
     auto int_literal = ParseIntegerLiteral();
@@ -542,9 +654,7 @@ bool Parser::ParseConstIntDef(CompoundStmt *cstmt)
       if (ParseCharLiteral() == nullptr) {
         Error(m_ts[0], 'o');
       }
-      while (m_ts.GetFrontType() != SEMICN) {
-        m_ts.FlushFront();
-      }
+      SkipUntil(SEMICN);
       return false;
     }
 
@@ -579,7 +689,7 @@ bool Parser::ParseConstVarDef(CompoundStmt *cstmt)
 {
   TokenType first_type = m_ts.GetFrontType();
   if (first_type != CHARTK && first_type != INTTK) {
-    Error("const defintion should start with \'int\' or \'char\'");
+    Panic("INTTK or CHARTK");
     return false;
   }
 #ifdef DEBUG_PARSE_BEGIN
@@ -611,7 +721,12 @@ int Parser::ParseConstVarDecl(CompoundStmt *cstmt)
   do {
     AssertFront(CONSTTK);           // const
     ret = ParseConstVarDef(cstmt);  // int a = 10
-    AssertFront(SEMICN);            // ;
+    if (m_panic) {
+      SyncStmt();
+    }
+    else {
+      AssertFront(SEMICN);  // ;
+    }
   } while (MatchFront(CONSTTK));
 
 #ifdef DEBUG_PARSE_END
@@ -644,6 +759,9 @@ int Parser::ParseVarDef(CompoundStmt *cstmt)
     m_ts.PrintFront();
 
     auto tok = AssertFront(IDENFR);
+    if (tok == nullptr) {
+      return -1;
+    }
     /* first look up in current scope, Error() if redef */
     auto res = m_curscope->FindInCurScope(tok->m_value);
     if (res != nullptr) {
@@ -710,7 +828,12 @@ int Parser::ParseVarDecl(CompoundStmt *cstmt)
 
   do {
     ParseVarDef(cstmt);
-    AssertFront(SEMICN);
+    if (m_panic) {
+      SyncStmt();
+    }
+    else {
+      AssertFront(SEMICN);
+    }
 
     if (MatchFront(INTTK) || MatchFront(CHARTK)) {
       if (m_ts.GetType(1) == IDENFR && m_ts.GetType(2) == LPARENT) {
@@ -741,7 +864,7 @@ Identifier *Parser::ParseFunctionReturnType()
   Identifier *ident = nullptr;
   auto type = ParseTypeIdentifier();
   auto tok = AssertFront(IDENFR);
-  if (tok->m_type == IDENFR) {
+  if (tok != nullptr) {
     auto derived_type = QualType(ArithmType::New(type));
     auto qt = QualType(FuncType::New(derived_type, 0));
     ident = Identifier::New(tok, qt);
@@ -773,9 +896,11 @@ int Parser::ParseFunctionParamList(FunctionDecl *func)
       break;  // epsilon
     }
     auto expr_type = ParseTypeIdentifier();
-    assert(expr_type != ExprType::T_INVALID);
+    if (expr_type == ExprType::T_INVALID) {
+      Panic("INTTK or CHARTK");
+    }
     auto tok = AssertFront(IDENFR);
-    if (tok != nullptr) {
+    if (tok != nullptr && expr_type != ExprType::T_INVALID) {
       /* first look up in current scope, Error() if redef */
       auto res = m_curscope->FindInCurScope(tok->m_value);
       if (res != nullptr) {
@@ -825,6 +950,28 @@ FunctionDecl *Parser::ParseVoidFunctionDecl()
   DEBUG_PARSE_BEGIN("无返回值函数定义");
 #endif
 
+  auto func = ParseVoidFunctionHeader();
+  if (func != nullptr) {
+    ParseFunctionBody(func);
+  }
+
+#ifdef DEBUG_PARSE_END
+  DEBUG_PARSE_END("无返回值函数定义");
+#endif
+  return func;
+}
+
+/*
+ * @*无返回值函数头部
+ * @Grammar:
+ *   void <标识符>'('<参数表>')'
+ * @References: <无返回值函数定义>
+ * @First = {void}
+ * @Follow = {'{'}
+ * @Note: leaves `m_curscope` at the new function scope.
+ */
+FunctionDecl *Parser::ParseVoidFunctionHeader()
+{
   AssertFront(VOIDTK);
   auto func_tok = AssertFront(IDENFR);
   if (func_tok == nullptr) {
@@ -854,22 +1001,8 @@ FunctionDecl *Parser::ParseVoidFunctionDecl()
   AssertFront(LPARENT);
   ParseFunctionParamList(func);
   AssertFront(RPARENT);
-  AssertFront(LBRACE);
-  func->SetBody(ParseCompoundStmt());
-  AssertFront(RBRACE);
 
   func->SetScope(m_curscope);
-  // m_curscope->Peek();
-
-  // Scope *temp = m_curscope;
-  m_curscope = m_curscope->parent();
-  m_curfunc = nullptr;
-  // debug("scope now is %#X\n", m_curscope);
-  // delete temp;
-
-#ifdef DEBUG_PARSE_END
-  DEBUG_PARSE_END("无返回值函数定义");
-#endif
   return func;
 }
 
@@ -887,7 +1020,32 @@ FunctionDecl *Parser::ParseNonvoidFunctionDecl()
   DEBUG_PARSE_BEGIN("有返回值函数定义");
 #endif
 
+  auto func = ParseNonvoidFunctionHeader();
+  if (func != nullptr) {
+    ParseFunctionBody(func);
+  }
+
+#ifdef DEBUG_PARSE_END
+  DEBUG_PARSE_END("有返回值函数定义");
+#endif
+  return func;
+}
+
+/*
+ * @*有返回值函数头部
+ * @Grammar:
+ *   <声明头部>'('<参数表>')'
+ * @References: <有返回值函数定义>
+ * @First = {int, char}
+ * @Follow = {'{'}
+ * @Note: leaves `m_curscope` at the new function scope.
+ */
+FunctionDecl *Parser::ParseNonvoidFunctionHeader()
+{
   auto ident = ParseFunctionReturnType();
+  if (ident == nullptr) {
+    return nullptr;
+  }
   auto func = FunctionDecl::New(ident);
   m_curfunc = func;
   ident->SetDecl(func);
@@ -907,26 +1065,8 @@ FunctionDecl *Parser::ParseNonvoidFunctionDecl()
   AssertFront(LPARENT);
   ParseFunctionParamList(func);
   AssertFront(RPARENT);
-  AssertFront(LBRACE);
-  func->SetBody(ParseCompoundStmt());
-  AssertFront(RBRACE);
-
-  if (!m_curscope->RetFlag()) {
-    Error(m_ts.prev(), 'h');
-  }
 
   func->SetScope(m_curscope);
-  // m_curscope->Peek();
-
-  m_curfunc = nullptr;
-  // Scope *temp = m_curscope;
-  m_curscope = m_curscope->parent();
-  // debug("scope now is %#X\n", m_curscope);
-  // delete temp;
-
-#ifdef DEBUG_PARSE_END
-  DEBUG_PARSE_END("有返回值函数定义");
-#endif
   return func;
 }
 
@@ -991,38 +1131,18 @@ StmtList Parser::ParseStmtList()
   DEBUG_PARSE_BEGIN("语句列");
 #endif
   auto ret = StmtList();
-  auto type = NATK;
-
-  while ((type = m_ts.GetFrontType()) != RBRACE) {
-    switch (type) {
-    case IFTK:
-    case WHILETK:
-    case DOTK:
-    case FORTK:
-    case LBRACE:
-    case IDENFR:
-    case PRINTFTK:
-    case SCANFTK:
-    case RETURNTK:
-    case SEMICN:
-#ifdef EXTRA_SWITCH
-    case SWITCHTK:
-#endif  // EXTRA_SWITCH
-    {
-      auto stmt = ParseStmt();
-      // assert(stmt != nullptr);
-      if (stmt)
-        ret.push_back(stmt);
-      break;
-    }
-
-    case RBRACE:
-      debug("right brace\n");
-      break;
-    default:
 
-      // TODO error handling
-      break;
+  while (!MatchFront(RBRACE) && !MatchFront(EOFTK)) {
+    auto front = m_ts[0];
+    auto stmt = ParseStmt();
+    if (stmt) {
+      ret.push_back(stmt);
+    }
+    if (m_panic) {
+      if (m_ts[0] == front) {
+        m_ts.FlushFront();  // stuck at a token no statement starts with
+      }
+      SyncStmt();
     }
   }
 
@@ -1063,6 +1183,7 @@ Stmt *Parser::ParseStmt()
 
   case LBRACE: {
     m_ts.PrintFront();
+    Recover();
     auto cstmt = CompoundStmt::New(m_curscope);
     cstmt->SetStmtList(ParseStmtList());
     ret = cstmt;
@@ -1086,9 +1207,7 @@ Stmt *Parser::ParseStmt()
     if (ident == nullptr) {
       Error(m_ts[0], 'c');
       debug("curscope: %#X\n", m_curscope);
-      while (m_ts.GetType(0) != SEMICN) {
-        m_ts.FlushFront();
-      }
+      SkipUntil(SEMICN, RBRACE);
     }
     else if (!CheckTokens(2, IDENFR, ASSIGN) ||
              !CheckTokens(2, IDENFR, LBRACK)) {  // a = 1 or a[xx] = 1
@@ -1098,7 +1217,12 @@ Stmt *Parser::ParseStmt()
     else if (!CheckTokens(2, IDENFR, LPARENT))  // a(1)
     {
       auto func = ident->Type()->ToFunc();
-      if (func->IsNonVoid() || ident->Type()->ToVoid()) {
+      if (func == nullptr) {
+        Error(m_ts[0], "called object \'%s\' is not a function.",
+              m_ts.GetName(0).c_str());
+        SkipUntil(SEMICN, RBRACE);
+      }
+      else if (func->IsNonVoid() || ident->Type()->ToVoid()) {
         assert(ident->IsNonVoid());
         ret = ParseNonvoidFunctionCall();
       }
@@ -1112,8 +1236,8 @@ Stmt *Parser::ParseStmt()
       AssertFront(SEMICN);
     }
     else {
-      Error("Drift identifier");
-      return nullptr;
+      m_ts.PrintFront();
+      Panic("ASSIGN, LBRACK or LPARENT");
     }
     break;
   }
@@ -1152,6 +1276,7 @@ Stmt *Parser::ParseStmt()
   case RBRACK:  // ]
   case RBRACE:  // }
   default:
+    Panic("statement");
     break;
   }
 
@@ -1205,13 +1330,18 @@ Expr *Parser::ParseFactor()
       if (ident == nullptr) {
         Error(tok, 'c');
         // ret = nullptr;
+        if (MatchFront(LBRACK)) {
+          m_ts.PrintFront();
+          ParseExpr();
+          AssertFront(RBRACK);
+        }
       }
       else {
         // array
         if (MatchFront(LBRACK)) {
           m_ts.PrintFront();
           auto expr = ParseExpr();
-          if (!expr->IsInt()) {
+          if (expr != nullptr && !expr->IsInt()) {
             Error(m_ts.prev(), 'i');
           }
           AssertFront(RBRACK);
@@ -1230,7 +1360,8 @@ Expr *Parser::ParseFactor()
     }
     break;
   default:
-    // TODO error handling
+    Panic("expression");
+    ret = IntegerLiteral::New(m_ts[0], ExprType::T_INT, 0);
     break;
   }
 
@@ -1314,7 +1445,7 @@ Expr *Parser::ParseExpr()
     uop_tok = m_ts.PrintFront();
   }
   auto lhs = ParseTerm();
-  if (uop_tok) {
+  if (uop_tok && lhs) {
     auto qt = QualType(lhs->Type());
     auto uop = UnaryOp::New(uop_tok, lhs, qt);  // TODO: add qual type
     lhs = uop;
@@ -1357,9 +1488,7 @@ Condition *Parser::ParseCondition()
   Condition *cond = nullptr;
   auto lhs = ParseExpr();
   if (lhs == nullptr) {
-    while (m_ts.GetFrontType() != SEMICN && m_ts.GetFrontType() != RPARENT) {
-      m_ts.FlushFront();
-    }
+    SkipUntil(SEMICN, RPARENT);
     return nullptr;
   }
   if (!lhs->IsInt()) {
@@ -1369,9 +1498,7 @@ Condition *Parser::ParseCondition()
     auto bop_tok = m_ts.PrintFront();
     auto rhs = ParseExpr();
     if (rhs == nullptr) {
-      while (m_ts.GetFrontType() != SEMICN && m_ts.GetFrontType() != RPARENT) {
-        m_ts.FlushFront();
-      }
+      SkipUntil(SEMICN, RPARENT);
       return nullptr;
     }
     if (!rhs->IsInt()) {
@@ -1384,9 +1511,7 @@ Condition *Parser::ParseCondition()
     // Error(m_ts[0], 'a'); // ???
     cond = Condition::New(lhs);
     assert(!cond->IsBinary());
-    while (m_ts.GetType(0) != RPARENT && m_ts.GetType(0) != SEMICN) {
-      m_ts.FlushFront();
-    }
+    SkipUntil(RPARENT, SEMICN);
   }
 
 #ifdef DEBUG_PARSE_END
@@ -1626,9 +1751,7 @@ PrintStmt *Parser::ParsePrintStmt()
   }
   else {
     Error("ParsePrintStmt: not found expr nor string literal.");
-    while (m_ts.GetFrontType() != SEMICN) {
-      m_ts.FlushFront();
-    }
+    SkipUntil(SEMICN);
     return nullptr;
   }
 
@@ -1703,8 +1826,10 @@ ReturnStmt *Parser::ParseReturnStmt()
     }
     m_ts.PrintFront();
     auto expr = ParseExpr();
-    assert(expr != nullptr);
-    if (m_curscope->Type() == S_INT_FUNC) {
+    if (expr == nullptr) {
+      // error reported already
+    }
+    else if (m_curscope->Type() == S_INT_FUNC) {
       if (!expr->IsInt()) {
         Error(m_ts.prev(), 'h');
       }
@@ -1731,11 +1856,13 @@ ReturnStmt *Parser::ParseReturnStmt()
     assert(m_curfunc);
     rstmt = ReturnStmt::New(m_curfunc);
   }
+  else {
+    Panic("LPARENT or SEMICN");
+  }
 
 #ifdef DEBUG_PARSE_END
   DEBUG_PARSE_END("返回语句");
 #endif
-  assert(rstmt);
   return rstmt;
 }
 
@@ -1772,23 +1899,26 @@ BinaryOp *Parser::ParseAssignStmt()
   if (MatchFront(LBRACK)) {
     m_ts.PrintFront();
     auto subscript_expr = ParseExpr();
-    if (!subscript_expr->IsInt()) {
+    if (subscript_expr != nullptr && !subscript_expr->IsInt()) {
       Error(m_ts.prev(), 'i');
     }
     AssertFront(RBRACK);
-    auto expr_type = ident->IsInt() ? ExprType::T_INT : ExprType::T_CHAR;
-    auto elem_type = QualType(ArithmType::New(expr_type));
-    auto type = ArrayType::New(subscript_expr, elem_type);
+    if (ident != nullptr && subscript_expr != nullptr) {
+      auto expr_type = ident->IsInt() ? ExprType::T_INT : ExprType::T_CHAR;
+      auto elem_type = QualType(ArithmType::New(expr_type));
+      auto type = ArrayType::New(subscript_expr, elem_type);
 
-    lhs = ArraySubscriptExpr::New(ident, subscript_expr, type, true);
+      lhs = ArraySubscriptExpr::New(ident, subscript_expr, type, true);
+    }
     // lhs = BinaryOp::New(lbrack_tok, lhs, subscript_expr);
   }
   auto ass_tok = AssertFront(ASSIGN);
+  if (ass_tok == nullptr) {
+    return nullptr;
+  }
   auto rhs = ParseExpr();
   if (rhs == nullptr) {
-    while (m_ts.GetFrontType() != SEMICN) {
-      m_ts.FlushFront();
-    }
+    SkipUntil(SEMICN);
     return nullptr;
   }
 
@@ -1812,7 +1942,8 @@ BinaryOp *Parser::ParseAssignStmt()
  */
 CallExpr::ArgList Parser::ParseValueParamList(Identifier *ident)
 {
-  return ParseValueParamList(ident->Type()->ToFunc()->GetFuncDecl());
+  auto func_type = ident ? ident->Type()->ToFunc() : nullptr;
+  return ParseValueParamList(func_type ? func_type->GetFuncDecl() : nullptr);
 }
 
 CallExpr::ArgList Parser::ParseValueParamList(FunctionDecl *func)
@@ -1822,7 +1953,6 @@ CallExpr::ArgList Parser::ParseValueParamList(FunctionDecl *func)
     return arglist;
   }
   // assert(MatchFront(RPARENT));
-  assert(func != nullptr);
 #ifdef DEBUG_PARSE_BEGIN
   DEBUG_PARSE_BEGIN("值参数表");
 #endif
@@ -1832,20 +1962,19 @@ CallExpr::ArgList Parser::ParseValueParamList(FunctionDecl *func)
     auto expr = ParseExpr();
     // assert(expr != nullptr);
     if (expr == nullptr) {
-      while (m_ts.GetFrontType() != RPARENT) {
-        m_ts.FlushFront();
-      }
+      SkipUntil(RPARENT);
       return arglist;
     }
     arglist.push_back(expr);
+    // callee unknown, an error is reported already
+    if (func == nullptr) {
+      // no params to match
+    }
     // still have params left to match
-    if (func->ParamNum() > i) {
+    else if (func->ParamNum() > i) {
       auto param_type = func->m_params[i]->Type()->ToArithm();
       if (!(expr->IsInt() && param_type->IsInteger()) &&
           !(expr->IsChar() && param_type->IsChar())) {
-        Error("internal%s: %d %d\n %d %d\n", expr->Tok()->m_value.c_str(),
-              expr->IsInt(), expr->IsChar(), param_type->IsInteger(),
-              param_type->IsChar());
         Error(m_ts.prev(), 'e');
       }
     }
@@ -1929,8 +2058,18 @@ CallExpr *Parser::ParseNonvoidFunctionCall()
   CallExpr::ArgList args;
   auto tok = AssertFront(IDENFR);
   auto ident = m_curscope->Find(tok->m_value);
-  if (ident == nullptr) {
-    Error(tok, 'c');
+  if (ident == nullptr || ident->Type()->ToFunc() == nullptr) {
+    if (ident == nullptr) {
+      Error(tok, 'c');
+    }
+    else {
+      Error(tok, "called object \'%s\' is not a function.",
+            tok->m_value.c_str());
+    }
+    // skip the arguments
+    AssertFront(LPARENT);
+    ParseValueParamList(ident);
+    AssertFront(RPARENT);
     return nullptr;
   }
   else {
@@ -1963,6 +2102,26 @@ FunctionDecl *Parser::ParseMain()
   DEBUG_PARSE_BEGIN("主函数");
 #endif
 
+  auto ret = ParseMainHeader();
+  ParseFunctionBody(ret);
+
+#ifdef DEBUG_PARSE_END
+  DEBUG_PARSE_END("主函数");
+#endif
+  return ret;
+}
+
+/*
+ * @*主函数头部
+ * @Grammar:
+ *   void main'('')'
+ * @References: <主函数>
+ * @First = {void}
+ * @Follow = {'{'}
+ * @Note: leaves `m_curscope` at the new function scope.
+ */
+FunctionDecl *Parser::ParseMainHeader()
+{
   AssertFront(VOIDTK);  // void
   Identifier *main_ident = nullptr;
   if (MatchFront(MAINTK)) {
@@ -1984,22 +2143,260 @@ FunctionDecl *Parser::ParseMain()
   AssertFront(MAINTK);   // main
   AssertFront(LPARENT);  // (
   AssertFront(RPARENT);  // )
-  AssertFront(LBRACE);   // {
-  ret->SetBody(ParseCompoundStmt());
-  AssertFront(RBRACE);  // }
+  return ret;
+}
+
+/*
+ * @*全局声明
+ * @Grammar:
+ *   [<常量说明>] [<变量说明>]
+ * @References: <程序>
+ * @First = {const, int, char, epsilon}
+ * @Follow = {int, char, void}
+ */
+int Parser::ParseGlobalDecls()
+{
+  if (MatchFront(CONSTTK)) {
+    ParseConstVarDecl();
+  }
+  // forwarding scan: DO NOT PRINT
+  if (MatchFront(INTTK) || MatchFront(CHARTK)) {
+    // int/char << identifier << ;
+    if (m_ts.GetType(1) == IDENFR &&
+        (m_ts.GetType(2) == SEMICN || m_ts.GetType(2) == COMMA ||
+         m_ts.GetType(2) == LBRACK)) {
+      ParseVarDecl();
+    }
+    // TODO error handling not identifier
+  }
+  return 0;
+}
+
+/*
+ * @*函数定义
+ * @Grammar:
+ *   <有返回值函数定义> | <无返回值函数定义> | <主函数>
+ * @References: <程序>
+ * @First = {int, char, void}
+ * @Follow = {int, char, void, epsilon}
+ */
+FunctionDecl *Parser::ParseFunctionDecl()
+{
+  if (MatchFront(VOIDTK)) {
+    if (m_ts.GetType(1) == MAINTK) {
+      return ParseMain();
+    }
+    return ParseVoidFunctionDecl();
+  }
+  return ParseNonvoidFunctionDecl();
+}
 
+/*
+ * @*函数头部
+ * @Grammar:
+ *   <有返回值函数头部> | <无返回值函数头部> | <主函数头部>
+ * @References: (并行分析) 先顺序分析全部函数头部
+ * @First = {int, char, void}
+ * @Follow = {'{'}
+ */
+FunctionDecl *Parser::ParseFunctionHeader()
+{
+  if (MatchFront(VOIDTK)) {
+    if (m_ts.GetType(1) == MAINTK) {
+      return ParseMainHeader();
+    }
+    return ParseVoidFunctionHeader();
+  }
+  return ParseNonvoidFunctionHeader();
+}
+
+/*
+ * @*函数体
+ * @Grammar:
+ *   '{'<复合语句>'}'
+ * @References: <有返回值函数定义> <无返回值函数定义> <主函数>
+ * @First = {'{'}
+ * @Follow = {int, char, void, epsilon}
+ * @Note: `m_curscope` must be the scope made by the function header.
+ */
+FunctionDecl *Parser::ParseFunctionBody(FunctionDecl *func)
+{
+  m_curfunc = func;
+  if (MatchFront(LBRACE)) {
+    Recover();  // whatever went wrong in the header, the body is intact
+  }
+  if (AssertFront(LBRACE) != nullptr) {
+    func->SetBody(ParseCompoundStmt());
+    AssertFront(RBRACE);
+
+    if (func->FuncType()->IsNonVoid() && !m_curscope->RetFlag()) {
+      Error(m_ts.prev(), 'h');
+    }
+  }
+  func->SetScope(m_curscope);
   // m_curscope->Peek();
 
-  // Scope *temp = m_curscope;
   m_curscope = m_curscope->parent();
-  debug("scope now is %#X\n", m_curscope);
-  // delete temp;
   m_curfunc = nullptr;
+  return func;
+}
 
-#ifdef DEBUG_PARSE_END
-  DEBUG_PARSE_END("主函数");
-#endif
-  return ret;
+/**
+ * @brief Brace-matching skim over top-level tokens.
+ *   Finds where each function definition starts and where its body
+ *   begins and ends, without building any AST.
+ * @return false if the layout is not `globals {function} main`.
+ */
+bool Parser::SkimFunctions(const TokenList &tokens, FuncSpanList &spans)
+{
+  auto type = [&tokens](size_t i) {
+    return i < tokens.size() ? tokens[i]->m_type : EOFTK;
+  };
+  spans.clear();
+
+  size_t i = 0;
+  while (type(i) != EOFTK) {
+    bool header = (type(i) == INTTK || type(i) == CHARTK ||
+                   type(i) == VOIDTK) &&
+                  (type(i + 1) == IDENFR || type(i + 1) == MAINTK) &&
+                  type(i + 2) == LPARENT;
+    if (!header) {
+      if (!spans.empty()) {
+        return false;  // only global declarations precede functions
+      }
+      ++i;
+      continue;
+    }
+
+    FuncSpan span;
+    span.begin = i;
+    while (type(i) != LBRACE) {
+      if (type(i) == EOFTK || type(i) == SEMICN || type(i) == RBRACE) {
+        return false;
+      }
+      ++i;
+    }
+    span.lbrace = i;
+    int depth = 0;
+    do {
+      if (type(i) == LBRACE) {
+        ++depth;
+      }
+      else if (type(i) == RBRACE) {
+        --depth;
+      }
+      else if (type(i) == EOFTK) {
+        return false;
+      }
+      ++i;
+    } while (depth > 0);
+    span.end = i;
+    spans.push_back(span);
+  }
+  return !spans.empty() && type(spans.back().begin + 1) == MAINTK;
+}
+
+/**
+ * @brief Two-phase parse for many-function sources.
+ *   Global declarations and all function headers are parsed first, in
+ *   order. The bodies are then parsed at once on `jobs` threads: they
+ *   only read the global scope, and each one sees just the names
+ *   declared before it. Functions and errors are merged back in source
+ *   order, lexer errors being held with their token until it is parsed.
+ *   A source with any error is parsed again serially, as where a broken
+ *   one goes astray need not be where it was split into functions.
+ *   Parse trace and token echo are not written in this mode.
+ */
+TranslationUnitDecl *Parser::AnalyseParallel(unsigned jobs)
+{
+  ErrorBufferList lex_errors;
+  auto tokens = m_ts.Drain(&lex_errors);
+  auto serial = [&]() {
+    Parser parser(&tokens, 0, tokens.size(), m_curscope, m_unit,
+                  &lex_errors);
+    return parser.Analyse();
+  };
+  FuncSpanList spans;
+  if (!SkimFunctions(tokens, spans)) {
+    return serial();
+  }
+
+  ErrorBuffer global_errors;
+  Parser globals(&tokens, 0, spans[0].begin, m_curscope, m_unit,
+                 &lex_errors);
+  globals.SetTrace(false);
+  SetErrorBuffer(&global_errors);
+  globals.ParseGlobalDecls();
+  SetErrorBuffer(nullptr);
+  // tokens a part leaves unparsed are an error too
+  bool failed = !globals.AtEnd();
+
+  auto n = spans.size();
+  std::vector<FunctionDecl *> funcs(n);
+  std::vector<ErrorBuffer> header_errors(n);
+  std::vector<ErrorBuffer> body_errors(n);
+  std::vector<size_t> strings(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto &span = spans[i];
+    // up to the '{', what a broken header is reported against
+    Parser header(&tokens, span.begin, span.lbrace + 1, m_curscope, m_unit,
+                  &lex_errors);
+    header.SetTrace(false);
+    SetErrorBuffer(&header_errors[i]);
+    funcs[i] = header.ParseFunctionHeader();
+    SetErrorBuffer(nullptr);
+    failed |= !header.MatchFront(LBRACE);
+    strings[i] = std::count_if(
+      tokens.begin() + span.lbrace, tokens.begin() + span.end,
+      [](const Token *tok) { return tok->m_type == STRCON; });
+  }
+  std::vector<size_t> first_id(n);
+  for (size_t i = 0; i < n; ++i) {
+    first_id[i] = StringLiteral::ReserveIds(strings[i]);
+  }
+
+  ThreadPool pool(jobs);
+  for (size_t i = 0; i < n; ++i) {
+    if (funcs[i] == nullptr) {
+      continue;
+    }
+    pool.Submit([&, i] {
+      auto func = funcs[i];
+      auto &span = spans[i];
+      func->m_scope->SetHorizon(tokens[span.lbrace]);
+      SetErrorBuffer(&body_errors[i]);
+      StringLiteral::SetIdRange(first_id[i], first_id[i] + strings[i]);
+
+      Parser body(&tokens, span.lbrace, span.end, func->m_scope, m_unit,
+                  &lex_errors);
+      body.SetTrace(false);
+      body.ParseFunctionBody(func);
+      // a stray '}' left over, for the serial parse to tell what it is
+      if (!body.AtEnd() && !body.m_panic) {
+        body.Panic("function definition");
+      }
+
+      StringLiteral::SetIdRange(0, 0);
+      SetErrorBuffer(nullptr);
+    });
+  }
+  pool.Wait();
+
+  failed |= !global_errors.diags.empty();
+  for (size_t i = 0; i < n; ++i) {
+    failed |= funcs[i] == nullptr || !header_errors[i].diags.empty() ||
+              !body_errors[i].diags.empty();
+  }
+  if (failed) {
+    m_curscope = new Scope(nullptr, S_FILE);
+    m_unit = TranslationUnitDecl::New();
+    return serial();
+  }
+  for (auto func : funcs) {
+    m_unit->Add(func);
+  }
+  m_unit->SetScope(m_curscope);
+  return m_unit;
 }
 
 /*
@@ -2017,40 +2414,32 @@ TranslationUnitDecl *Parser::ParseTranslationUnitDecl()
   DEBUG_PARSE_BEGIN("程序");
 #endif
 
-  if (MatchFront(CONSTTK)) {
-    ParseConstVarDecl();
-  }
-  // forwarding scan: DO NOT PRINT
-  if (MatchFront(INTTK) || MatchFront(CHARTK)) {
-    // int/char << identifier <<
-    if (m_ts.GetType(1) == IDENFR) {
-      // int/char << identifier << ;
-      if (m_ts.GetType(2) == SEMICN || m_ts.GetType(2) == COMMA ||
-          m_ts.GetType(2) == LBRACK) {
-        ParseVarDecl();
-      }
-      // int/char << identifier << (
-      else if (m_ts.GetType(2) == LPARENT) {
-        m_unit->Add(ParseNonvoidFunctionDecl());
-      }
-      // TODO error handling
+  ParseGlobalDecls();
+  for (;;) {
+    auto front = m_ts[0];
+    if (MatchFront(VOIDTK) && m_ts.GetType(1) == MAINTK) {
+      m_unit->Add(ParseMain());
+      break;
     }
-    // TODO error handling not identifier
-  }
-  while (MatchFront(VOIDTK) || MatchFront(INTTK) || MatchFront(CHARTK)) {
-    if (MatchFront(VOIDTK)) {
-      if (m_ts.GetType(1) == MAINTK) {
-        break;
-      }
-      else {
-        m_unit->Add(ParseVoidFunctionDecl());
+    if (MatchFront(VOIDTK) || MatchFront(INTTK) || MatchFront(CHARTK)) {
+      if (auto func = ParseFunctionDecl()) {
+        m_unit->Add(func);
       }
     }
     else {
-      m_unit->Add(ParseNonvoidFunctionDecl());
+      Panic(AtEnd() ? "main function" : "function definition");
+    }
+    if (AtEnd()) {
+      break;
+    }
+    if (m_panic) {
+      if (m_ts[0] == front) {
+        m_ts.FlushFront();
+      }
+      SyncDecl();
     }
   }
-  m_unit->Add(ParseMain());
+  Recover();
   m_unit->SetScope(m_curscope);
   // m_curscope->Peek();
 
@@ -26,14 +26,57 @@ public:
       m_unit(TranslationUnitDecl::New()), m_curfunc(nullptr)
   {
   }
+
+  /**
+   * Parse part [begin, end) of a pre-lexed token list into an existing
+   * translation unit, looking names up in (and adding them to) `scope`.
+   */
+  Parser(const TokenList *tokens,
+         size_t begin,
+         size_t end,
+         Scope *scope,
+         TranslationUnitDecl *unit,
+         const ErrorBufferList *lex_errors = nullptr)
+    : m_ts(tokens, begin, end, lex_errors), m_curscope(scope), m_unit(unit),
+      m_curfunc(nullptr)
+  {
+  }
+
+  struct FuncSpan {
+    size_t begin;   // first token of the function header
+    size_t lbrace;  // '{' opening the body
+    size_t end;     // one past the '}' closing the body
+  };
+  using FuncSpanList = std::vector<FuncSpan>;
+  static bool SkimFunctions(const TokenList &tokens, FuncSpanList &spans);
+
+  TranslationUnitDecl *AnalyseParallel(unsigned jobs);
+
+  int ParseGlobalDecls();
+  FunctionDecl *ParseFunctionDecl();
+  FunctionDecl *ParseFunctionHeader();
+  FunctionDecl *ParseFunctionBody(FunctionDecl *func);
+  bool AtEnd()
+  {
+    return MatchFront(EOFTK);
+  }
+
+  // parse trace (DEBUG_PARSER) and token echo (PRINT_OUTPUT) switch
+  void SetTrace(bool trace)
+  {
+    m_trace = trace;
+    m_ts.SetEcho(trace);
+  }
   Parser() = delete;
-  ~Parser() {}
+  ~Parser();
 
 private:
   TokenStream m_ts;
   Scope *m_curscope;
   TranslationUnitDecl *m_unit;
   FunctionDecl *m_curfunc;
+  bool m_trace{true};
+  bool m_panic{false};  // recovering from a syntax error, errors muted
 
 #ifdef DEBUG_PARSER
   void Peek();
@@ -46,6 +89,14 @@ private:
     return m_ts.GetFrontType() == type;
   }
 
+  // panic-mode error recovery
+  void Panic(const char *expected);
+  void Panic(const Token *tok, char code);
+  void Recover();
+  void SkipUntil(const TokenType type, const TokenType other = EOFTK);
+  void SyncStmt();
+  void SyncDecl();
+
 #ifdef EXTRA_MIDEXAM
 
 #endif  // EXTRA_MIDEXAM
@@ -66,6 +117,9 @@ private:
   FunctionDecl *ParseNonvoidFunctionDecl();         // 有返回值函数定义
   FunctionDecl *ParseVoidFunctionDecl();            // 无返回值函数定义
   FunctionDecl *ParseMain();                        // 主函数
+  FunctionDecl *ParseNonvoidFunctionHeader();       // 有返回值函数头部
+  FunctionDecl *ParseVoidFunctionHeader();          // 无返回值函数头部
+  FunctionDecl *ParseMainHeader();                  // 主函数头部
 
   bool ParseConstCharDef(CompoundStmt *cstmt);
   bool ParseConstIntDef(CompoundStmt *cstmt);
@@ -0,0 +1,216 @@
+#include "peephole.h"
+#include "debug.h"
+
+// the code generator keeps nothing in these from one block to the next
+static bool isscratch(Gpr reg)
+{
+  return (reg >= t0 && reg <= t7) || reg == t8 || reg == t9;
+}
+
+// the line after `i`, comments aside
+static size_t next(const MInstList &code, size_t i)
+{
+  for (++i; i < code.size() && code[i].m_op == MO_NOTE; ++i) {
+  }
+  return i;
+}
+
+// whether `reg` may be read after the instruction at `i`
+static bool live(const MInstList &code, size_t i, Gpr reg)
+{
+  if (code[i].IsJump()) {
+    return !isscratch(reg);
+  }
+  for (i = next(code, i); i < code.size(); i = next(code, i)) {
+    auto &inst = code[i];
+    if (!inst.IsInst()) {
+      return !isscratch(reg);
+    }
+    if (inst.Reads(reg) || inst.Addresses(reg)) {
+      return true;
+    }
+    if (inst.Def() == reg) {
+      return false;
+    }
+    if (inst.IsJump()) {
+      return !isscratch(reg);
+    }
+  }
+  return !isscratch(reg);
+}
+
+// move $r, $r
+static bool selfmove(MInstList &code, size_t i)
+{
+  auto &inst = code[i];
+  if (inst.m_op != MO_MOVE || inst.m_rd != inst.m_rs) {
+    return false;
+  }
+  code.erase(code.begin() + i);
+  return true;
+}
+
+// sw $r, addr; lw $s, addr  =>  sw $r, addr; move $s, $r
+static bool storeload(MInstList &code, size_t i)
+{
+  auto &store = code[i];
+  auto j = next(code, i);
+  if (store.m_op != MO_SW || j == code.size()) {
+    return false;
+  }
+  auto &load = code[j];
+  if (load.m_op != MO_LW || load.m_rs != store.m_rs ||
+      load.m_imm != store.m_imm || load.m_label != store.m_label) {
+    return false;
+  }
+  if (load.m_rt == store.m_rt) {
+    code.erase(code.begin() + j);
+  }
+  else {
+    load = MInst(MO_MOVE, {load.m_rt, store.m_rt});
+  }
+  return true;
+}
+
+// j L; L:  =>  L:, the same for branches
+static bool jumpnext(MInstList &code, size_t i)
+{
+  auto &jump = code[i];
+  if (jump.m_op != MO_J && !jump.IsBranch()) {
+    return false;
+  }
+  for (auto j = next(code, i); j < code.size() && code[j].m_op == MO_LABEL;
+       j = next(code, j)) {
+    if (code[j].m_label == jump.m_label) {
+      code.erase(code.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// li $r, 0; op ..., $r, ...  =>  op ..., $zero, ... with $r dead after
+static bool zeroliteral(MInstList &code, size_t i)
+{
+  auto &li = code[i];
+  if (li.m_op != MO_LI || li.m_imm != 0) {
+    return false;
+  }
+  auto reg = li.m_rd;
+  auto j = next(code, i);
+  for (; j < code.size() && code[j].IsInst(); j = next(code, j)) {
+    auto &inst = code[j];
+    if (inst.Addresses(reg)) {
+      return false;
+    }
+    if (inst.Reads(reg)) {
+      break;
+    }
+    if (inst.Def() == reg) {
+      // not read at all
+      code.erase(code.begin() + i);
+      return true;
+    }
+    if (inst.IsJump()) {
+      return false;
+    }
+  }
+  if (j == code.size() || !code[j].IsInst() || code[j].m_op == MO_SYSCALL ||
+      (code[j].Def() != reg && live(code, j, reg))) {
+    return false;
+  }
+  for (auto operand : code[j].Operands()) {
+    if (*operand == reg) {
+      *operand = zero;
+    }
+  }
+  code.erase(code.begin() + i);
+  return true;
+}
+
+// syscalls printing leave $v0 as it was
+static bool prints(long service_no)
+{
+  return service_no == SC_PRINT_INT || service_no == SC_PRINT_STR ||
+         service_no == SC_PRINT_CHAR;
+}
+
+// li/la/move $r, x  =>  nothing, with $r holding x since earlier in the block
+static bool reload(MInstList &code, size_t i)
+{
+  auto &inst = code[i];
+  if (inst.m_op != MO_LI && inst.m_op != MO_LA && inst.m_op != MO_MOVE) {
+    return false;
+  }
+  auto reg = inst.m_rd;
+  bool syscall = false;
+  for (auto j = i; j-- > 0;) {
+    auto &prev = code[j];
+    if (prev.m_op == MO_NOTE) {
+      continue;
+    }
+    if (!prev.IsInst() || prev.m_op == MO_JAL) {
+      return false;
+    }
+    if (prev.m_op == MO_SYSCALL) {
+      // $v0 as set before it, unless read to
+      if (inst.m_op == MO_MOVE && inst.m_rs == v0) {
+        return false;
+      }
+      syscall = true;
+      continue;
+    }
+    if (inst.m_op == MO_MOVE && prev.Def() == inst.m_rs) {
+      return false;
+    }
+    if (prev.Def() != reg) {
+      continue;
+    }
+    if (prev.m_op != inst.m_op || prev.m_rs != inst.m_rs ||
+        prev.m_imm != inst.m_imm || prev.m_label != inst.m_label ||
+        (syscall && reg == v0 && (inst.m_op != MO_LI || !prints(inst.m_imm)))) {
+      return false;
+    }
+    code.erase(code.begin() + i);
+    return true;
+  }
+  return false;
+}
+
+namespace {
+
+struct Rule {
+  const char *name;
+  // rewrites the code at an instruction, returning whether it did
+  bool (*apply)(MInstList &code, size_t i);
+};
+
+const Rule rules[] = {
+  {"self-move", selfmove},
+  {"store-load", storeload},
+  {"jump-to-next", jumpnext},
+  {"zero-literal", zeroliteral},
+  {"reload", reload},
+};
+
+}  // namespace
+
+void Peephole(MInstList &code, std::map<std::string, int> &removed)
+{
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = 0; i < code.size(); ++i) {
+      if (!code[i].IsInst()) {
+        continue;
+      }
+      for (auto &rule : rules) {
+        if (rule.apply(code, i)) {
+          // a load made a move counts as removed too
+          ++removed[rule.name];
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+}
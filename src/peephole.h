@@ -0,0 +1,21 @@
+#ifndef C0C_PEEPHOLE_H
+#define C0C_PEEPHOLE_H
+
+#include "mips_isa.h"
+
+#include <map>
+#include <string>
+
+/**
+ * Peephole optimization over the assembly of a function, by a table of
+ * rules each matching a few instructions in a row, comments aside:
+ * moves to the register moved, loads right after a store to the same
+ * address, jumps and branches to the next label, literal zeros loaded
+ * to be read once instead of $zero, and values set again in a register
+ * already holding them, such as $v0 and $a0 between print syscalls. The
+ * rules are applied until none does, the instructions each removed
+ * counted in `removed`, by name.
+ */
+void Peephole(MInstList &code, std::map<std::string, int> &removed);
+
+#endif  // !C0C_PEEPHOLE_H
@@ -1,8 +1,16 @@
 #include "quad_generator.h"
+#include "cfg.h"
 #include "debug.h"
 #include "generator.h"
+#include "inliner.h"
 #include "mips_isa.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "regalloc.h"
+#include "ssa.h"
+
+#include <algorithm>
+#include <set>
 
 class Quadruple;
 class QuadAddr;
@@ -84,6 +92,25 @@ QuadAddr *QuadAddr::New(AddrType type, FunctionDecl *data)
   return ret;
 }
 
+QuadAddr *QuadAddr::New(QuadAddr *var, int version, unsigned off)
+{
+  auto ret = new (quadAddrPool.Alloc()) QuadAddr(*var);
+  ret->m_pool = &quadAddrPool;
+  ret->m_origin = var->Origin();
+  ret->m_version = version;
+  ret->m_offset = off;
+  ret->m_bind = Gpr::zero;
+  ret->m_resolved = false;
+  return ret;
+}
+
+QuadAddr *QuadAddr::New(const QuadAddr &other)
+{
+  auto ret = new (quadAddrPool.Alloc()) QuadAddr(other);
+  ret->m_pool = &quadAddrPool;
+  return ret;
+}
+
 Quadruple *
 Quadruple::New(QuadOp op, QuadAddr *dst, QuadAddr *arg1, QuadAddr *arg2)
 {
@@ -120,6 +147,48 @@ QuadAddr *FuncInfo::Find(Identifier *ident)
   return nullptr;
 }
 
+QuadAddr *FuncInfo::NewLabel()
+{
+  auto name = "$func_" + Name() + "_L" + std::to_string(m_nlabels++);
+  return QuadAddr::New(QuadAddr::AT_LABEL, LabelStmt::New(name));
+}
+
+StringLiteral *FuncInfo::NewString(const std::string &val)
+{
+  auto label = "strlabel_" + Name() + "_S" + std::to_string(m_nstrings++);
+  return StringLiteral::New(val, label);
+}
+
+unsigned FuncInfo::NewSlot(unsigned width)
+{
+  auto top = m_slots.empty() ? 0 : m_slots.rbegin()->first;
+  m_slots[top + width] = width;
+  return top + width;
+}
+
+QuadAddr *FuncInfo::NewTemp()
+{
+  return QuadAddr::New(QuadAddr::AT_TMP, long(++m_ntemps), NewSlot(4));
+}
+
+void FuncInfo::Recount()
+{
+  // the word $ra takes goes with the last call, arguments take their area
+  int nleft = 0;
+  m_argbuildsz = 0;
+  for (auto quad : m_quads) {
+    nleft += quad->m_op == QO_CALL;
+    if (quad->m_op == QO_PUSH) {
+      m_argbuildsz = std::max<unsigned>(m_argbuildsz, quad->m_arg1->m_data + 4);
+    }
+  }
+  m_isleaf = nleft == 0;
+  if (m_isleaf && (m_frame.mask & 0x80000000)) {
+    m_frame.mask &= ~0x80000000;
+    m_frame.size -= 4;
+  }
+}
+
 std::string FuncInfo::Name()
 {
   if (m_func) {
@@ -299,10 +368,12 @@ void QuadGenerator::VisitCallExpr(CallExpr *funcCall)
   debug("Visiting CallExpr\n");
   EmitComment("Visiting CallExpr\n");
 
-  // set isleaf false
+  // set isleaf false, $ra saved once for all the calls
   m_curfunc->m_isleaf = false;
-  m_curfunc->m_frame.mask |= 0x80000000;
-  m_curfunc->m_frame.size += 4;
+  if (!(m_curfunc->m_frame.mask & 0x80000000)) {
+    m_curfunc->m_frame.mask |= 0x80000000;
+    m_curfunc->m_frame.size += 4;
+  }
 
   // build args
   int args_build_offset = 0;
@@ -415,7 +486,7 @@ void QuadGenerator::VisitPrintStmt(PrintStmt *printStmt)
     // calculate expr first
     NewQuad(QO_PRINT, exp_qa);
 
-    auto lf = StringLiteral::New("\\n");
+    auto lf = m_curfunc->NewString("\\n");
     auto qa = QuadAddr::New(QuadAddr::AT_STR, lf);
     NewQuad(QO_PRINT, qa);  // builtin line feed
   }
@@ -602,18 +673,167 @@ void QuadGenerator::VisitCompoundStmt(CompoundStmt *compStmt)
   }
 }
 
-static void mapoffset(QuadAddr *qa, int frame_size, int save_size)
+static void mapoffset(QuadAddr *qa,
+                      int frame_size,
+                      int save_size,
+                      const std::map<unsigned, unsigned> &remap)
 {
   if (!qa) {
     debug("warning: mapping nullptr!\n");
     return;
   }
   if (qa->m_resolved == false) {
+    auto it = remap.find(qa->m_offset);
+    if (it != remap.end()) {
+      qa->m_offset = it->second;
+    }
     qa->m_offset = frame_size - save_size - qa->m_offset;
     qa->m_resolved = true;
   }
 }
 
+#ifdef SLOT_COLORING
+/**
+ * @brief Colors the word slots in `slots` by liveness, slots never live
+ *   at once taking the same color: `colors` takes a slot to its color.
+ *   A slot read before it is written may be read as the function found
+ *   it, and is left out to keep a slot of its own.
+ */
+static void colorslots(FuncInfo *func,
+                       const std::map<QuadAddr *, unsigned> &slots,
+                       std::map<unsigned, int> &colors)
+{
+  std::map<unsigned, int> index;
+  std::vector<unsigned> offsets;
+  for (auto &entry : slots) {
+    if (index.emplace(entry.second, offsets.size()).second) {
+      offsets.push_back(entry.second);
+    }
+  }
+  std::map<QuadAddr *, int> ids;
+  for (auto &entry : slots) {
+    ids[entry.first] = index[entry.second];
+  }
+
+  auto cfg = func->m_cfg;
+  Liveness live(cfg, ids);
+  std::vector<std::set<int>> edges(offsets.size());
+  for (auto bb : cfg->m_blocks) {
+    live.EachQuad(bb, [&](Quadruple *quad, const BitSet &after) {
+      auto it = ids.find(quad->Def());
+      if (it == ids.end()) {
+        return;
+      }
+      after.Each([&](int other) {
+        if (other != it->second) {
+          edges[it->second].insert(other);
+          edges[other].insert(it->second);
+        }
+      });
+    });
+  }
+  BitSet own(offsets.size());
+  if (!cfg->m_blocks.empty()) {
+    own = live.m_in[cfg->Entry()->m_id];
+  }
+
+  std::vector<int> color(offsets.size(), -1);
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    if (own.Test(i)) {
+      continue;
+    }
+    std::set<int> taken;
+    for (auto other : edges[i]) {
+      taken.insert(color[other]);
+    }
+    int c = 0;
+    while (taken.count(c)) {
+      ++c;
+    }
+    color[i] = c;
+    colors[offsets[i]] = c;
+  }
+}
+#endif  // SLOT_COLORING
+
+/**
+ * @brief Packs the stack slots still needed once registers are allocated,
+ *   in declaration order: `remap` takes the offset a local or temporary
+ *   was given to its packed one. Returns the size of the locals area.
+ *   With SLOT_COLORING, words never live at once share a slot.
+ */
+static unsigned packslots(FuncInfo *func, std::map<unsigned, unsigned> &remap)
+{
+  std::set<unsigned> used;
+  std::set<QuadAddr *> params;
+  std::map<QuadAddr *, unsigned> scalars;  // offset of each local in memory
+  auto mark = [&](QuadAddr *qa) {
+    if (qa && qa->m_bind == Gpr::zero && !qa->m_isglb &&
+        (qa->IsLocal() || qa->m_type == QuadAddr::AT_ARRAY)) {
+      used.insert(qa->m_offset);
+      if (qa->IsLocal() && !params.count(qa)) {
+        scalars[qa] = qa->m_offset;
+      }
+    }
+  };
+  for (auto quad : func->m_quads) {
+    if (quad->m_op == QO_PARAM) {
+      params.insert(quad->m_dst);
+      continue;
+    }
+    for (auto qa : {quad->m_dst, quad->m_arg1, quad->m_arg2}) {
+      mark(qa);
+      if (qa && qa->m_type == QuadAddr::AT_ARRAY) {
+        mark(qa->m_minion);
+      }
+    }
+  }
+
+  std::map<unsigned, int> colors;  // of the word slots of scalars only
+#ifdef SLOT_COLORING
+  std::set<unsigned> arrays;
+  for (auto quad : func->m_quads) {
+    for (auto qa : {quad->m_dst, quad->m_arg1, quad->m_arg2}) {
+      if (qa && qa->m_type == QuadAddr::AT_ARRAY) {
+        arrays.insert(qa->m_offset);
+      }
+    }
+  }
+  for (auto it = scalars.begin(); it != scalars.end();) {
+    auto slot = func->m_slots.find(it->second);
+    if (arrays.count(it->second) || slot == func->m_slots.end() ||
+        slot->second != 4) {
+      it = scalars.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  colorslots(func, scalars, colors);
+#endif  // SLOT_COLORING
+
+  unsigned size = 0;
+  std::map<int, unsigned> placed;  // offset of each color
+  for (auto &slot : func->m_slots) {
+    if (!used.count(slot.first)) {
+      continue;
+    }
+    auto color = colors.find(slot.first);
+    if (color == colors.end()) {
+      size += slot.second;
+      remap[slot.first] = size;
+      continue;
+    }
+    auto &offset = placed[color->second];
+    if (!offset) {
+      size += 4;
+      offset = size;
+    }
+    remap[slot.first] = offset;
+  }
+  return size;
+}
+
 void QuadGenerator::VisitFunctionDecl(FunctionDecl *funcDecl)
 {
   debug("Visiting Function Decl %s\n", funcDecl->Name().c_str());
@@ -631,54 +851,114 @@ void QuadGenerator::VisitFunctionDecl(FunctionDecl *funcDecl)
 
   assert(funcDecl->Body());
   Visit(funcDecl->Body());
+  m_curfunc->m_ntemps = m_tempid;
+#ifdef TAIL_CALLS
+  // before the quads are kept, for the loop to be inlined
+  EliminateTailRecursion(m_curfunc);
+#endif  // TAIL_CALLS
+#ifdef INLINE_FUNCTIONS
+  m_curfunc->m_body = KeepBody(m_curfunc);
+#endif  // INLINE_FUNCTIONS
+}
+
+/**
+ * @brief Run the passes over the quads of m_curfunc, allocate registers
+ *   and lay out its frame, then add it to m_funcs.
+ */
+void QuadGenerator::Optimize()
+{
+#ifdef INLINE_FUNCTIONS
+  std::map<std::string, int> inlined;
+  InlineCalls(m_curfunc, m_bodies, inlined);
+  for (auto &callee : inlined) {
+    EmitComment("inlined %s at %d call%s", callee.first.c_str(), callee.second,
+                callee.second > 1 ? "s" : "");
+  }
+#endif  // INLINE_FUNCTIONS
+
+  auto cfg = new FlowGraph(m_curfunc);
+  // a pass changing the quads leaves the graph to be built again
+  auto rebuild = [this, &cfg]() {
+    cfg->Flatten();
+    delete cfg;
+    cfg = new FlowGraph(m_curfunc);
+  };
+#ifdef CONST_PROPAGATION
+  if (PropagateConstants(cfg)) {
+    rebuild();
+  }
+#endif  // CONST_PROPAGATION
+#ifdef DEAD_CODE_ELIMINATION
+  if (EliminateDeadCode(cfg)) {
+    rebuild();
+  }
+#endif  // DEAD_CODE_ELIMINATION
+#ifdef SSA_FORM
+#ifdef LOOP_OPTIMIZATION
+  if (InsertPreheaders(cfg)) {
+    rebuild();
+  }
+#endif  // LOOP_OPTIMIZATION
+  ToSSA(cfg);
+  PropagateCopies(cfg);
+#ifdef VALUE_NUMBERING
+  if (NumberValues(cfg)) {
+    PropagateCopies(cfg);
+  }
+#endif  // VALUE_NUMBERING
+#ifdef LOOP_OPTIMIZATION
+  if (HoistInvariants(cfg) | ReduceStrength(cfg)) {
+    PropagateCopies(cfg);
+  }
+#endif  // LOOP_OPTIMIZATION
+  FromSSA(cfg);
+  delete cfg;
+  cfg = new FlowGraph(m_curfunc);
+#endif  // SSA_FORM
+#ifdef BLOCK_LAYOUT
+  if (LayoutBlocks(cfg)) {
+    rebuild();
+  }
+#endif  // BLOCK_LAYOUT
+  m_curfunc->m_cfg = cfg;
+  RegAllocator(m_curfunc->m_cfg).Run();
 
+  // locals and temporaries held in registers take no slot
+  std::map<unsigned, unsigned> remap;
+  auto locals_size = packslots(m_curfunc, remap);
   auto save_size = m_curfunc->m_frame.size;
-  m_curfunc->m_frame.size += m_curoffset + m_curfunc->m_argbuildsz;  // opt
+  m_curfunc->m_frame.size += locals_size + m_curfunc->m_argbuildsz;  // opt
 
   Emit("}", 0);
   Emit(".frame " + std::to_string(m_curfunc->m_frame.size));
-  debug(".frame %d (40 + %d + %d)\n", m_curfunc->m_frame.size, m_curoffset,
-        m_curfunc->m_argbuildsz);
+  debug(".frame %d (%d + %d + %d)\n", m_curfunc->m_frame.size, save_size,
+        locals_size, m_curfunc->m_argbuildsz);
 
   // resolve curfunc temp & local vars offset
+  auto frame_size = m_curfunc->m_frame.size;
   for (auto slot : m_curfunc->m_quads) {
     if (slot->m_op == QO_PARAM) {
       if (slot->m_dst->m_resolved == false) {
-        slot->m_dst->m_offset = m_curfunc->m_frame.size + slot->m_dst->m_offset;
+        slot->m_dst->m_offset = frame_size + slot->m_dst->m_offset;
         slot->m_dst->m_resolved = true;
       }
       continue;
     }
-    if (slot->m_dst) {
-      if (slot->m_dst->m_type == QuadAddr::AT_ARRAY) {
-        // if (slot->m_dst->m_minion->m_type )
-        mapoffset(slot->m_dst->m_minion, m_curfunc->m_frame.size, save_size);
+    for (auto qa : {slot->m_dst, slot->m_arg1, slot->m_arg2}) {
+      if (!qa) {
+        continue;
       }
-      if (slot->m_dst->m_resolved == false) {
-        slot->m_dst->m_offset =
-          m_curfunc->m_frame.size - save_size - slot->m_dst->m_offset;
-        slot->m_dst->m_resolved = true;
-      }
-    }
-    if (slot->m_arg1) {
-      if (slot->m_arg1->m_type == QuadAddr::AT_ARRAY) {
-        mapoffset(slot->m_arg1->m_minion, m_curfunc->m_frame.size, save_size);
-      }
-      if (slot->m_arg1->m_resolved == false) {
-        slot->m_arg1->m_offset =
-          m_curfunc->m_frame.size - save_size - slot->m_arg1->m_offset;
-        slot->m_arg1->m_resolved = true;
-      }
-    }
-    if (slot->m_arg2) {
-      if (slot->m_arg2->m_resolved == false) {
-        slot->m_arg2->m_offset =
-          m_curfunc->m_frame.size - save_size - slot->m_arg2->m_offset;
-        slot->m_arg2->m_resolved = true;
+      if (qa->m_type == QuadAddr::AT_ARRAY) {
+        mapoffset(qa->m_minion, frame_size, save_size, remap);
       }
+      mapoffset(qa, frame_size, save_size, remap);
     }
   }
 
+  for (auto bb : m_curfunc->m_cfg->m_blocks) {
+    Emit(m_curfunc->m_cfg->Str(bb));
+  }
+
   m_funcs.push_back(m_curfunc);
 }
 
@@ -689,11 +969,10 @@ void QuadGenerator::VisitVarDecl(VarDecl *varDecl)
 
   if (m_curfunc) {
     m_curoffset += varDecl->Width();
+    m_curfunc->m_slots[m_curoffset] = varDecl->Width();
     auto qa =
       QuadAddr::New(QuadAddr::AT_IDENT, varDecl->m_name, false, m_curoffset);
     m_curfunc->m_qamap[varDecl->m_name] = qa;
-    auto reg = m_curfunc->AllocReg(qa);
-    debug("%s get reg %s", qa->Str().c_str(), regs[reg]);
 
     // m_curfunc->m_frame.size += varDecl->Width();
     Emit(varDecl->QuadStr() + "(" + std::to_string(qa->m_offset) + ")");
@@ -719,8 +998,6 @@ void QuadGenerator::VisitParmVarDecl(ParmVarDecl *parmVarDecl)
 
   m_curqa =
     QuadAddr::New(QuadAddr::AT_IDENT, parmVarDecl->m_name, false, m_curoffset);
-  auto reg = m_curfunc->AllocReg(m_curqa);
-  debug("%s get reg %s", m_curqa->Str().c_str(), regs[reg]);
 
   NewQuad(QO_PARAM, m_curqa);
   // Emit(parmVarDecl->QuadStr() + "(" + std::to_string(qa->m_offset) + ")");
@@ -731,21 +1008,29 @@ void QuadGenerator::VisitParmVarDecl(ParmVarDecl *parmVarDecl)
   }
 }
 
-void QuadGenerator::VisitTranslationUnitDecl(TranslationUnitDecl *unit)
+void QuadGenerator::VisitGlobalVars(TranslationUnitDecl *unit)
 {
-  debug("visiting tu, total decls: %d\n", unit->ExtDecls().size());
-
   for (auto var : unit->VarDecls()) {
     // global var don't need `offset`
     auto qa = QuadAddr::New(QuadAddr::AT_IDENT, var->m_name, true);
+    qa->m_resolved = true;  // shared by all functions, never mapped
     m_glb_identtab[var->m_name] = qa;
 
     assert(m_curfunc == nullptr);
     Visit(var);
   }
+}
+
+void QuadGenerator::VisitTranslationUnitDecl(TranslationUnitDecl *unit)
+{
+  debug("visiting tu, total decls: %d\n", unit->ExtDecls().size());
+
+  VisitGlobalVars(unit);
   assert(m_curoffset == 0);
   for (auto extDecl : unit->ExtDecls()) {
     Visit(extDecl);
+    m_bodies[m_curfunc->Name()] = m_curfunc->m_body;
+    Optimize();
     m_curoffset = 0;
     // m_curqa = nullptr;
   }
@@ -757,6 +1042,38 @@ void QuadGenerator::Gen()
   VisitTranslationUnitDecl(m_parser->Unit());
 }
 
+void QuadGenerator::GenGlobals()
+{
+  Emit("########## C0 Intermediate Code generated by c0c ##########", 0);
+  VisitGlobalVars(m_parser->Unit());
+}
+
+/**
+ * @brief Generate the quads of one function, printing them to `out`.
+ *   Only the global tables are read, so functions can be generated on
+ *   several threads at once. The passes are left to OptimizeFunction().
+ */
+FuncInfo *QuadGenerator::GenFunction(FunctionDecl *funcDecl, FILE *out)
+{
+  QuadGenerator qg(m_parser, out);
+  qg.m_glb_identtab = m_glb_identtab;
+  qg.Visit(funcDecl);
+  return qg.m_curfunc;
+}
+
+/**
+ * @brief Run the passes over a function made by GenFunction(), printing
+ *   the rest of its quads to `out`. Only m_bodies is read, to be complete
+ *   by then. The result is not added to m_funcs.
+ */
+void QuadGenerator::OptimizeFunction(FuncInfo *func, FILE *out)
+{
+  QuadGenerator qg(m_parser, out);
+  qg.m_bodies = m_bodies;
+  qg.m_curfunc = func;
+  qg.Optimize();
+}
+
 Quadruple *
 QuadGenerator::NewQuad(QuadOp op, QuadAddr *dst, QuadAddr *arg1, QuadAddr *arg2)
 {
@@ -769,20 +1086,34 @@ QuadGenerator::NewQuad(QuadOp op, QuadAddr *dst, QuadAddr *arg1, QuadAddr *arg2)
 QuadAddr *QuadGenerator::NewTemp()
 {
   m_curoffset += 4;
+  m_curfunc->m_slots[m_curoffset] = 4;
   auto qa = QuadAddr::New(QuadAddr::AT_TMP, NextTemp(), m_curoffset);
   return qa;
 }
 QuadAddr *QuadGenerator::NewTempChar()
 {
   m_curoffset += 4;
+  m_curfunc->m_slots[m_curoffset] = 4;
   auto qa = QuadAddr::New(QuadAddr::AT_TMPCH, NextTemp(), m_curoffset);
   return qa;
 }
 
 QuadAddr *QuadGenerator::NewLabel()
 {
-  auto qa = QuadAddr::New(QuadAddr::AT_LABEL, LabelStmt::New());
-  return qa;
+  return m_curfunc->NewLabel();
+}
+
+bool QuadAddr::IsChar() const
+{
+  switch (m_type) {
+  case AT_TMPCH:
+  case AT_CHARL:
+    return true;
+  case AT_IDENT:
+    return reinterpret_cast<Identifier *>(m_data)->IsChar();
+  default:
+    return false;
+  }
 }
 
 std::string QuadAddr::Str()
@@ -821,13 +1152,17 @@ std::string QuadAddr::Str()
   case AT_ARRAY: {
     auto cast = reinterpret_cast<Identifier *>(m_data);
     auto lr = m_islval ? "l" : "r";
-    ret = cast->Name() + "[" + m_minion->Str() + "] " + lr + "value";
+    auto index = m_minion->Str() + (m_scaled ? "/4" : "");
+    ret = cast->Name() + "[" + index + "] " + lr + "value";
     break;
   }
   default:
     assert(0);
     break;
   }
+  if (m_version) {
+    ret += "." + std::to_string(m_version);
+  }
   return ret;
 }
 
@@ -908,25 +1243,105 @@ std::string Quadruple::Str()
   case QO_BNE:
     ret = "bne " + m_dst->Str() + ", " + m_arg1->Str() + ", " + m_arg2->Str();
     break;
+  case QO_PHI:
+    ret = "phi " + m_dst->Str() + " = phi(";
+    for (size_t i = 0; i < m_phiargs.size(); ++i) {
+      ret += (i ? ", " : "") + m_phiargs[i]->Str();
+    }
+    ret += ")";
+    break;
   default:
     break;
   }
   return ret;
 }
 
-Gpr FuncInfo::AllocReg(QuadAddr *qa)
+QuadAddr *Quadruple::Def() const
+{
+  switch (m_op) {
+  case QO_PARAM:
+  case QO_SCAN:
+  case QO_PLUS:
+  case QO_MINU:
+  case QO_MULT:
+  case QO_DIV:
+  case QO_INDEX_ARG:
+  case QO_CALL:
+  case QO_PHI:
+    return m_dst;
+  case QO_ASSIGN:
+    return m_dst->m_type == QuadAddr::AT_ARRAY ? nullptr : m_dst;
+  default:
+    return nullptr;
+  }
+}
+
+// calls `func` on the slot of each operand read, array elements included
+template <typename Func>
+void Quadruple::EachUse(Func func)
 {
-  for (auto i = 0; i < 8; ++i) {
-    if (m_regpool[i].m_bind == nullptr) {
-      m_regpool[i].m_bind = qa;
-      qa->m_bind = m_regpool[i].m_name;
-      return m_regpool[i].m_name;
+  switch (m_op) {
+  case QO_BEQ:
+  case QO_BNE:
+  case QO_BGE:
+  case QO_BLT:
+  case QO_BGT:
+  case QO_BLE:
+  case QO_PLUS:
+  case QO_MINU:
+  case QO_MULT:
+  case QO_DIV:
+  case QO_INDEX_ARG:
+    func(m_arg1);
+    func(m_arg2);
+    break;
+  case QO_BZ:
+  case QO_BNZ:
+    func(m_arg1);
+    break;
+  case QO_ASSIGN:
+    func(m_arg1);
+    if (m_dst->m_type == QuadAddr::AT_ARRAY) {
+      func(m_dst);
+    }
+    break;
+  case QO_PRINT:
+  case QO_PUSH:
+    func(m_dst);
+    break;
+  case QO_RETURN:
+    if (m_dst) {
+      func(m_dst);
+    }
+    break;
+  case QO_PHI:
+    for (auto &arg : m_phiargs) {
+      func(arg);
     }
+    break;
+  default:
+    break;
   }
-  return Gpr::zero;
 }
 
-void FuncInfo::FreeReg(Gpr name)
+void Quadruple::Uses(std::vector<QuadAddr *> &uses) const
 {
-  m_regpool[name - Gpr::t0].m_bind = nullptr;
+  const_cast<Quadruple *>(this)->EachUse([&uses](QuadAddr *qa) {
+    uses.push_back(qa->m_type == QuadAddr::AT_ARRAY ? qa->m_minion : qa);
+  });
+}
+
+void Quadruple::RewriteUses(const std::function<QuadAddr *(QuadAddr *)> &func)
+{
+  EachUse([&func](QuadAddr *&qa) {
+    if (qa->m_type != QuadAddr::AT_ARRAY) {
+      qa = func(qa);
+      return;
+    }
+    // the element of another index, the array stays
+    auto minion = func(qa->m_minion);
+    if (minion != qa->m_minion) {
+      qa = QuadAddr::New(QuadAddr::AT_ARRAY, qa, minion, qa->m_islval);
+    }
+  });
 }
@@ -4,12 +4,16 @@
 #include "generator.h"
 
 #include <cassert>
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
 
 using IdentTab = std::map<Identifier *, QuadAddr *>;
 
+class FlowGraph;
+struct InlineBody;
+
 enum QuadOp {
   QO_LABEL = 0,  // just label (must be global)
   QO_BEQ = 1,    // beq %1, %2, label
@@ -35,6 +39,7 @@ enum QuadOp {
   QO_RETURN,  // ret [i32/c8]
   QO_PUSH,    // push param
   QO_CALL,    // ret(dst) = call func(arg1)
+  QO_PHI,     // dst = phi(phiargs), in SSA form only
 
 };
 
@@ -62,6 +67,10 @@ public:
   static QuadAddr *New(AddrType type, StringLiteral *str, unsigned off = 0);
   static QuadAddr *New(AddrType type, LabelStmt *data);
   static QuadAddr *New(AddrType type, FunctionDecl *data);
+  // version `version` of a local, in a slot at `off`
+  static QuadAddr *New(QuadAddr *var, int version, unsigned off);
+  // copy of `other`, to be changed apart from it
+  static QuadAddr *New(const QuadAddr &other);
 
   QuadAddr() {}
   QuadAddr(AddrType type, long data, unsigned off = 0)
@@ -76,7 +85,7 @@ public:
   QuadAddr(AddrType type, QuadAddr *master, QuadAddr *minion, bool islval)
     : m_data(master->m_data), m_minion(minion), m_type(type),
       m_offset(master->m_offset), m_isglb(master->m_isglb), m_islval(islval),
-      m_resolved(false)
+      m_scaled(master->m_scaled), m_resolved(false)
   {
   }
   QuadAddr(AddrType type, StringLiteral *str, unsigned off = 0)
@@ -96,19 +105,31 @@ public:
   {
   }
 
-  bool IsChar() const
+  bool IsChar() const;
+  // local scalar or temporary, which may be kept in a register
+  bool IsLocal() const
+  {
+    return m_type == AT_TMP || m_type == AT_TMPCH ||
+           (m_type == AT_IDENT && !m_isglb);
+  }
+
+  // the local an SSA version stands for, itself if not a version
+  QuadAddr *Origin()
   {
-    return m_type == AT_TMPCH || m_type == AT_CHARL;
+    return m_origin ? m_origin : this;
   }
 
   intptr_t m_data;
   QuadAddr *m_minion{nullptr};
+  QuadAddr *m_origin{nullptr};
+  int m_version{0};
   AddrType m_type;
   unsigned m_offset;  // can't be static, That'd be unsafe!
-  Gpr m_bind;
+  Gpr m_bind{Gpr::zero};  // register holding it, zero if kept in memory
   MemoryPool *m_pool{nullptr};
-  bool m_isglb;
+  bool m_isglb{false};
   bool m_islval{false};
+  bool m_scaled{false};  // array index already in bytes
   bool m_resolved;
 };
 
@@ -120,6 +141,13 @@ public:
                         QuadAddr *arg2 = nullptr);
   std::string Str();
 
+  // scalar the quad writes, nullptr if none or an array element
+  QuadAddr *Def() const;
+  // operands the quad reads, array indexes included
+  void Uses(std::vector<QuadAddr *> &uses) const;
+  // replace each operand read by what `func` returns for it
+  void RewriteUses(const std::function<QuadAddr *(QuadAddr *)> &func);
+
   Quadruple() {}
   Quadruple(QuadOp bop,
             QuadAddr *dst = nullptr,
@@ -134,7 +162,12 @@ public:
   QuadAddr *m_arg1;
   QuadAddr *m_arg2;
   QuadOp m_op;
+  std::vector<QuadAddr *> m_phiargs;  // of a phi, by predecessor
   MemoryPool *m_pool{nullptr};
+
+private:
+  template <typename Func>
+  void EachUse(Func func);
 };
 
 /* Stack Frame Layout
@@ -187,26 +220,34 @@ public:
   std::string Name();
   void Add(Quadruple *quad);
   QuadAddr *Find(Identifier *ident);
-
-  Gpr AllocReg(QuadAddr *qa);
-
-  void FreeReg(Gpr name);
+  // label `$func_<name>_L<n>`, numbered in the order they are made
+  QuadAddr *NewLabel();
+  // string `strlabel_<name>_S<n>` made up for the quads
+  StringLiteral *NewString(const std::string &val);
+  // stack slot of `width` bytes, its offset before the slots are packed
+  unsigned NewSlot(unsigned width);
+  // int temporary made up after the quads, with a slot of its own
+  QuadAddr *NewTemp();
+  // frame, argument area and leaf flag over again, after calls went away
+  void Recount();
 
 public:
-  struct Reg m_regpool[8] = {{Gpr::s0, 0, nullptr}, {Gpr::s1, 0, nullptr},
-                             {Gpr::s2, 0, nullptr}, {Gpr::s3, 0, nullptr},
-                             {Gpr::s4, 0, nullptr}, {Gpr::s5, 0, nullptr},
-                             {Gpr::s6, 0, nullptr}, {Gpr::s7, 0, nullptr}};
   // mask + a0~a3 + outgoing args + local var
   Frame m_frame;
   QuadList m_quads;
+  FlowGraph *m_cfg{nullptr};  // built once the quads are complete
+  InlineBody *m_body{nullptr};  // quads as generated, if worth inlining
   IdentTab m_qamap;
+  std::map<unsigned, unsigned> m_slots;  // width of each local, by offset
   FunctionDecl *m_func;
   int m_parmnum{0};
   std::string m_entry_label;  // not neccessary
   std::string m_exit_label;   // not neccessary
 
   unsigned m_argbuildsz = 0;
+  int m_nlabels{0};
+  int m_nstrings{0};
+  size_t m_ntemps{0};  // temporaries numbered so far
   bool m_isleaf{true};
 };
 
@@ -273,6 +314,10 @@ public:
   QuadAddr *NewLabel();
 
   void Gen();
+  // global data only, functions are left to GenFunction()
+  void GenGlobals();
+  FuncInfo *GenFunction(FunctionDecl *funcDecl, FILE *out);
+  void OptimizeFunction(FuncInfo *func, FILE *out);
 
   void EmitQuad(Quadruple *quad)
   {
@@ -303,8 +348,12 @@ public:
   FuncInfoList m_funcs;
   IdentTab m_glb_identtab;
   DataSegTab m_data_entries;
+  std::map<std::string, InlineBody *> m_bodies;  // by function name
 
 protected:
+  void VisitGlobalVars(TranslationUnitDecl *unit);
+  void Optimize();
+
   size_t m_tempid = 0;
   FuncInfo *m_curfunc;
   unsigned m_curoffset = 0;
@@ -0,0 +1,363 @@
+#include "regalloc.h"
+#include "debug.h"
+
+#include <algorithm>
+
+static RegAllocKind regalloc_kind = RA_LINEAR_SCAN;
+
+static const Gpr allocatable[] = {Gpr::s0, Gpr::s1, Gpr::s2, Gpr::s3,
+                                  Gpr::s4, Gpr::s5, Gpr::s6, Gpr::s7};
+static const int NREGS = sizeof(allocatable) / sizeof(allocatable[0]);
+
+static const Gpr scratch[] = {Gpr::t0, Gpr::t1, Gpr::t2, Gpr::t3,
+                              Gpr::t4, Gpr::t5, Gpr::t6, Gpr::t7};
+static const int NSCRATCH = sizeof(scratch) / sizeof(scratch[0]);
+
+void SetRegAlloc(RegAllocKind kind)
+{
+  regalloc_kind = kind;
+}
+
+void RegAllocator::Run()
+{
+#ifdef REG_ARGS
+  BindParams();
+#endif  // REG_ARGS
+  BindTemps();
+  Number();
+  if (m_vregs.empty()) {
+    return;
+  }
+  SolveLiveness();
+  m_color.assign(m_vregs.size(), -1);
+  if (regalloc_kind == RA_GRAPH_COLORING) {
+    Color();
+  }
+  else {
+    LinearScan();
+  }
+  Commit();
+}
+
+int RegAllocator::Id(QuadAddr *qa)
+{
+  auto it = m_ids.find(qa);
+  return it == m_ids.end() ? -1 : it->second;
+}
+
+/**
+ * @brief With no call to clobber them, parameters stay in $a0~$a3, $a0
+ *   unless something is printed, which goes through it.
+ */
+void RegAllocator::BindParams()
+{
+  if (!m_cfg->m_func->m_isleaf) {
+    return;
+  }
+  bool prints = false;
+  std::vector<QuadAddr *> params;
+  for (auto bb : m_cfg->m_blocks) {
+    for (auto quad : bb->m_quads) {
+      prints |= quad->m_op == QO_PRINT;
+      if (quad->m_op == QO_PARAM) {
+        params.push_back(quad->m_dst);
+      }
+    }
+  }
+  for (size_t i = prints ? 1 : 0; i < params.size() && i < 4; ++i) {
+    params[i]->m_bind = (Gpr)(Gpr::a0 + i);
+  }
+}
+
+/**
+ * @brief Expression temporaries mostly die where they are born: written
+ *   once and read by a later quad of the same block. Those not crossing a
+ *   call take a $t register, freed by the read, while one is left.
+ */
+void RegAllocator::BindTemps()
+{
+  struct Count {
+    int defs;
+    int uses;
+    BasicBlock *bb;
+  };
+  std::map<QuadAddr *, Count> counts;
+  std::vector<QuadAddr *> uses;
+  auto istemp = [](QuadAddr *qa) {
+    return qa && (qa->m_type == QuadAddr::AT_TMP ||
+                  qa->m_type == QuadAddr::AT_TMPCH);
+  };
+  for (auto bb : m_cfg->m_blocks) {
+    for (auto quad : bb->m_quads) {
+      uses.clear();
+      quad->Uses(uses);
+      for (auto qa : uses) {
+        if (istemp(qa)) {
+          auto &count = counts[qa];
+          ++count.uses;
+          count.bb = count.bb == bb || !count.bb ? bb : nullptr;
+        }
+      }
+      if (istemp(quad->Def())) {
+        auto &count = counts[quad->Def()];
+        ++count.defs;
+        count.bb = count.bb == bb || !count.bb ? bb : nullptr;
+      }
+    }
+  }
+
+  for (auto bb : m_cfg->m_blocks) {
+    std::map<QuadAddr *, int> held;  // by the temporaries defined so far
+    bool busy[NSCRATCH] = {false};
+    for (auto quad : bb->m_quads) {
+      uses.clear();
+      quad->Uses(uses);
+      for (auto qa : uses) {
+        auto it = held.find(qa);
+        if (it != held.end()) {
+          busy[it->second] = false;
+          held.erase(it);
+        }
+      }
+      // the caller-saved ones do not survive it
+      if (quad->m_op == QO_CALL) {
+        for (auto &entry : held) {
+          entry.first->m_bind = Gpr::zero;
+          busy[entry.second] = false;
+        }
+        held.clear();
+      }
+      auto def = quad->Def();
+      if (!istemp(def)) {
+        continue;
+      }
+      auto &count = counts[def];
+      auto reg = std::find(busy, busy + NSCRATCH, false) - busy;
+      if (count.defs == 1 && count.uses == 1 && count.bb == bb &&
+          reg < NSCRATCH) {
+        busy[reg] = true;
+        held[def] = reg;
+        def->m_bind = scratch[reg];
+      }
+    }
+    // defined but never read in the block
+    for (auto &entry : held) {
+      entry.first->m_bind = Gpr::zero;
+    }
+  }
+}
+
+// number the locals in order of appearance, weighing every access
+void RegAllocator::Number()
+{
+  std::vector<QuadAddr *> uses;
+  for (auto bb : m_cfg->m_blocks) {
+    double weight = 1;
+    for (int i = std::min(m_cfg->LoopDepth(bb), 4); i > 0; --i) {
+      weight *= 10;
+    }
+    for (auto quad : bb->m_quads) {
+      uses.clear();
+      quad->Uses(uses);
+      uses.push_back(quad->Def());
+      for (auto qa : uses) {
+        if (!qa || !qa->IsLocal() || qa->m_bind != Gpr::zero) {
+          continue;
+        }
+        auto id = Id(qa);
+        if (id < 0) {
+          id = m_vregs.size();
+          m_ids[qa] = id;
+          m_vregs.push_back(qa);
+          m_cost.push_back(0);
+        }
+        m_cost[id] += weight;
+      }
+    }
+  }
+}
+
+void RegAllocator::SolveLiveness()
+{
+  Liveness live(m_cfg, m_ids);
+  m_livein = live.m_in;
+  m_liveout = live.m_out;
+}
+
+/**
+ * @brief Poletto and Sarkar's linear scan over conservative intervals:
+ *   from the first to the last quad a local is live at, in block order.
+ */
+void RegAllocator::LinearScan()
+{
+  std::vector<Interval> intervals(m_vregs.size());
+  for (size_t i = 0; i < intervals.size(); ++i) {
+    intervals[i] = {int(i), -1, -1};
+  }
+  auto extend = [&intervals](int id, int pos) {
+    auto &range = intervals[id];
+    if (range.start < 0 || pos < range.start) {
+      range.start = pos;
+    }
+    if (pos > range.end) {
+      range.end = pos;
+    }
+  };
+
+  int pos = 0;
+  std::vector<QuadAddr *> uses;
+  for (auto bb : m_cfg->m_blocks) {
+    if (bb->m_quads.empty()) {
+      continue;
+    }
+    m_livein[bb->m_id].Each([&](int id) { extend(id, pos); });
+    for (auto quad : bb->m_quads) {
+      uses.clear();
+      quad->Uses(uses);
+      uses.push_back(quad->Def());
+      for (auto qa : uses) {
+        auto id = Id(qa);
+        if (id >= 0) {
+          extend(id, pos);
+        }
+      }
+      ++pos;
+    }
+    m_liveout[bb->m_id].Each([&](int id) { extend(id, pos - 1); });
+  }
+
+  std::sort(intervals.begin(), intervals.end(),
+            [](const Interval &a, const Interval &b) {
+              return a.start != b.start ? a.start < b.start : a.vreg < b.vreg;
+            });
+  std::vector<Interval *> active;
+  bool busy[NREGS] = {false};
+  for (auto &cur : intervals) {
+    // a register read by the last quad of an interval may be written by it
+    for (auto it = active.begin(); it != active.end();) {
+      if ((*it)->end <= cur.start) {
+        busy[m_color[(*it)->vreg]] = false;
+        it = active.erase(it);
+      }
+      else {
+        ++it;
+      }
+    }
+
+    auto reg = std::find(busy, busy + NREGS, false) - busy;
+    if (reg < NREGS) {
+      busy[reg] = true;
+      m_color[cur.vreg] = reg;
+      active.push_back(&cur);
+      continue;
+    }
+    // out of registers: the cheapest one stays in memory
+    auto victim = &cur;
+    for (auto other : active) {
+      auto ca = m_cost[other->vreg], cb = m_cost[victim->vreg];
+      if (ca < cb || (ca == cb && other->end > victim->end)) {
+        victim = other;
+      }
+    }
+    if (victim != &cur) {
+      m_color[cur.vreg] = m_color[victim->vreg];
+      m_color[victim->vreg] = -1;
+      *std::find(active.begin(), active.end(), victim) = &cur;
+    }
+  }
+}
+
+/**
+ * @brief Chaitin's graph coloring with Briggs' optimistic spilling: locals
+ *   live at the same time interfere, nodes of fewer neighbours than
+ *   registers are removed first, then the cheapest per neighbour.
+ */
+void RegAllocator::Color()
+{
+  auto n = m_vregs.size();
+  std::vector<std::vector<int>> adj(n);
+  std::vector<QuadAddr *> uses;
+  for (auto bb : m_cfg->m_blocks) {
+    auto live = m_liveout[bb->m_id];
+    for (auto it = bb->m_quads.rbegin(); it != bb->m_quads.rend(); ++it) {
+      auto def = Id((*it)->Def());
+      if (def >= 0) {
+        live.Each([&](int id) {
+          if (id != def) {
+            adj[def].push_back(id);
+            adj[id].push_back(def);
+          }
+        });
+        live.Set(def, false);
+      }
+      uses.clear();
+      (*it)->Uses(uses);
+      for (auto qa : uses) {
+        auto id = Id(qa);
+        if (id >= 0) {
+          live.Set(id);
+        }
+      }
+    }
+  }
+  std::vector<int> degree(n);
+  for (size_t i = 0; i < n; ++i) {
+    std::sort(adj[i].begin(), adj[i].end());
+    adj[i].erase(std::unique(adj[i].begin(), adj[i].end()), adj[i].end());
+    degree[i] = adj[i].size();
+  }
+
+  std::vector<int> stack;
+  std::vector<bool> removed(n);
+  while (stack.size() < n) {
+    int pick = -1;
+    for (size_t i = 0; i < n && pick < 0; ++i) {
+      if (!removed[i] && degree[i] < NREGS) {
+        pick = i;
+      }
+    }
+    // all of NREGS neighbours or more: the cheapest per neighbour
+    for (size_t i = 0; i < n && (pick < 0 || degree[pick] >= NREGS); ++i) {
+      if (!removed[i] && (pick < 0 || m_cost[i] * degree[pick] <
+                                        m_cost[pick] * degree[i])) {
+        pick = i;
+      }
+    }
+    removed[pick] = true;
+    stack.push_back(pick);
+    for (auto other : adj[pick]) {
+      --degree[other];
+    }
+  }
+
+  while (!stack.empty()) {
+    auto id = stack.back();
+    stack.pop_back();
+    bool taken[NREGS] = {false};
+    for (auto other : adj[id]) {
+      if (m_color[other] >= 0) {
+        taken[m_color[other]] = true;
+      }
+    }
+    auto reg = std::find(taken, taken + NREGS, false) - taken;
+    m_color[id] = reg < NREGS ? reg : -1;
+  }
+}
+
+void RegAllocator::Commit()
+{
+  uint32_t used = 0;
+  for (size_t i = 0; i < m_vregs.size(); ++i) {
+    if (m_color[i] >= 0) {
+      m_vregs[i]->m_bind = allocatable[m_color[i]];
+      used |= 1u << allocatable[m_color[i]];
+    }
+  }
+  auto &frame = m_cfg->m_func->m_frame;
+  for (auto reg : allocatable) {
+    if ((used >> reg) & 1) {
+      frame.mask |= 1u << reg;
+      frame.size += 4;
+    }
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef C0C_REGALLOC_H
+#define C0C_REGALLOC_H
+
+#include "cfg.h"
+#include "dataflow.h"
+
+#include <map>
+#include <vector>
+
+enum RegAllocKind {
+  RA_LINEAR_SCAN,
+  RA_GRAPH_COLORING,
+};
+
+// linear scan unless set otherwise
+void SetRegAlloc(RegAllocKind kind);
+
+/**
+ * Keeps local variables, parameters and temporaries of a function in
+ * registers, as far as they go: QuadAddr::m_bind is set for those, the
+ * others stay in their stack slots.
+ *
+ * A leaf function keeps its first parameters in the $a registers they
+ * are passed in. A temporary written and read once in the same block,
+ * with no call in between, gets one of the caller-saved $t0~$t7 while one
+ * is free. The rest compete for the callee-saved $s0~$s7, which are added
+ * to the frame mask, so that the prologue saves them.
+ *
+ * Liveness is solved over the flow graph. Linear scan walks the live
+ * intervals in order and, out of registers, spills the cheapest one:
+ * the fewest uses, weighted by loop depth. Graph coloring simplifies the
+ * interference graph, spilling optimistically the same way.
+ */
+class RegAllocator {
+public:
+  explicit RegAllocator(FlowGraph *cfg) : m_cfg(cfg) {}
+
+  void Run();
+
+private:
+  struct Interval {
+    int vreg;
+    int start;
+    int end;
+  };
+
+  int Id(QuadAddr *qa);
+  void BindParams();
+  void BindTemps();
+  void Number();
+  void SolveLiveness();
+  void LinearScan();
+  void Color();
+  void Commit();
+
+  FlowGraph *m_cfg;
+  std::vector<QuadAddr *> m_vregs;
+  std::map<QuadAddr *, int> m_ids;
+  std::vector<double> m_cost;  // of keeping each in memory
+  std::vector<BitSet> m_livein;
+  std::vector<BitSet> m_liveout;
+  std::vector<int> m_color;  // index into the registers, -1 if spilled
+};
+
+#endif  // !C0C_REGALLOC_H
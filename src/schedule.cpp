@@ -0,0 +1,243 @@
+#include "schedule.h"
+#include "debug.h"
+
+#include <algorithm>
+
+static bool delay_slots = false;
+
+void SetDelaySlots(bool on)
+{
+  delay_slots = on;
+}
+
+bool DelaySlots()
+{
+  return delay_slots;
+}
+
+// registers written, $hi and $lo by div and mult
+static std::vector<Gpr> defs(const MInst &inst)
+{
+  if (inst.m_op == MO_DIV || inst.m_op == MO_MULT) {
+    return {hi, lo};
+  }
+  auto def = inst.Def();
+  if (def == zero) {
+    return {};
+  }
+  return {def};
+}
+
+static bool uses(const MInst &inst, Gpr reg)
+{
+  if (inst.m_op == MO_MFHI || inst.m_op == MO_MFLO) {
+    return reg == (inst.m_op == MO_MFHI ? hi : lo);
+  }
+  return inst.Reads(reg) || inst.Addresses(reg);
+}
+
+static bool ismem(const MInst &inst)
+{
+  return inst.m_op == MO_LW || inst.m_op == MO_SW;
+}
+
+// whether `later` has to stay after `earlier`
+static bool depends(const MInst &earlier, const MInst &later)
+{
+  for (auto reg : defs(earlier)) {
+    if (uses(later, reg)) {
+      return true;
+    }
+    for (auto def : defs(later)) {
+      if (def == reg) {
+        return true;
+      }
+    }
+  }
+  for (auto reg : defs(later)) {
+    if (uses(earlier, reg)) {
+      return true;
+    }
+  }
+  // any two may be the same word
+  return ismem(earlier) && ismem(later) &&
+         (earlier.m_op == MO_SW || later.m_op == MO_SW);
+}
+
+// whether `inst` right after `load` waits for the register loaded
+static bool stalls(const MInst &load, const MInst &inst)
+{
+  return load.m_op == MO_LW && uses(inst, load.m_rt);
+}
+
+// the stalls in code[begin, end), comments aside
+static int countstalls(const MInstList &code, size_t begin, size_t end)
+{
+  int ret = 0;
+  const MInst *prev = nullptr;
+  for (auto i = begin; i < end; ++i) {
+    if (code[i].m_op == MO_NOTE) {
+      continue;
+    }
+    if (prev && stalls(*prev, code[i])) {
+      ++ret;
+    }
+    prev = &code[i];
+  }
+  return ret;
+}
+
+// block ends, kept last in their block
+static bool isend(const MInst &inst)
+{
+  return inst.IsJump() || inst.m_op == MO_SYSCALL;
+}
+
+// schedules the block in code[begin, end), if that avoids stalls
+static void schedule(MInstList &code, size_t begin, size_t end)
+{
+  // an instruction with the comments right before it
+  struct Unit {
+    size_t first;
+    size_t inst;
+  };
+  std::vector<Unit> units;
+  auto first = begin;
+  for (auto i = begin; i < end; ++i) {
+    if (code[i].IsInst()) {
+      units.push_back({first, i});
+      first = i + 1;
+    }
+  }
+  auto n = units.size();
+  if (n < 3) {
+    return;
+  }
+  std::vector<std::vector<size_t>> preds(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto &inst = code[units[i].inst];
+    for (size_t j = 0; j < i; ++j) {
+      if (isend(inst) || depends(code[units[j].inst], inst)) {
+        preds[i].push_back(j);
+      }
+    }
+  }
+
+  // in order, but for what would stall right after a load
+  std::vector<bool> done(n);
+  std::vector<size_t> order;
+  const MInst *prev = nullptr;
+  while (order.size() < n) {
+    auto pick = n, wait = n;
+    for (size_t i = 0; i < n && pick == n; ++i) {
+      if (done[i]) {
+        continue;
+      }
+      auto ready = true;
+      for (auto pred : preds[i]) {
+        ready = ready && done[pred];
+      }
+      if (!ready) {
+        continue;
+      }
+      if (!prev || !stalls(*prev, code[units[i].inst])) {
+        pick = i;
+      }
+      else if (wait == n) {
+        wait = i;
+      }
+    }
+    if (pick == n) {
+      pick = wait;
+    }
+    done[pick] = true;
+    order.push_back(pick);
+    prev = &code[units[pick].inst];
+  }
+
+  MInstList block;
+  for (auto i : order) {
+    block.insert(block.end(), code.begin() + units[i].first,
+                 code.begin() + units[i].inst + 1);
+  }
+  block.insert(block.end(), code.begin() + first, code.begin() + end);
+  if (countstalls(block, 0, block.size()) < countstalls(code, begin, end)) {
+    std::copy(block.begin(), block.end(), code.begin() + begin);
+  }
+}
+
+int ScheduleLoads(MInstList &code)
+{
+  auto before = countstalls(code, 0, code.size());
+  size_t begin = 0;
+  for (size_t i = 0; i < code.size(); ++i) {
+    if (code[i].m_op == MO_LABEL || code[i].m_op == MO_TEXT) {
+      schedule(code, begin, i);
+      begin = i + 1;
+    }
+    else if (isend(code[i])) {
+      schedule(code, begin, i + 1);
+      begin = i + 1;
+    }
+  }
+  schedule(code, begin, code.size());
+  return before - countstalls(code, 0, code.size());
+}
+
+// whether code[k] is between a load, from `start` on, and a use of it
+static bool separates(const MInstList &code, size_t start, size_t k)
+{
+  auto prev = k, next = k + 1;
+  while (prev-- > start && code[prev].m_op == MO_NOTE) {
+  }
+  while (next < code.size() && code[next].m_op == MO_NOTE) {
+    ++next;
+  }
+  return prev + 1 > start && next < code.size() &&
+         stalls(code[prev], code[next]);
+}
+
+int FillDelaySlots(MInstList &code, int &nops)
+{
+  int filled = 0;
+  size_t start = 0;  // past the last slot filled
+  for (size_t i = 0; i < code.size(); ++i) {
+    if (!code[i].IsJump()) {
+      continue;
+    }
+    // the last instruction of the block free to go after the jump
+    auto slot = i;
+    for (auto k = i; k-- > start && slot == i;) {
+      auto &inst = code[k];
+      if (inst.m_op == MO_NOTE) {
+        continue;
+      }
+      if (!inst.IsInst() || isend(inst)) {
+        break;
+      }
+      // a load in the slot could stall the target, and one gone from
+      // between a load and its use would stall here
+      auto free = inst.Words() == 1 && inst.m_op != MO_LW &&
+                  !separates(code, start, k);
+      for (auto m = k + 1; m <= i && free; ++m) {
+        free = !code[m].IsInst() || !depends(inst, code[m]);
+      }
+      if (free) {
+        slot = k;
+      }
+    }
+    if (slot == i) {
+      code.insert(code.begin() + i + 1, MInst(MO_NOP, {}));
+      ++nops;
+      ++i;
+    }
+    else {
+      auto inst = code[slot];
+      code.erase(code.begin() + slot);
+      code.insert(code.begin() + i, inst);
+      ++filled;
+    }
+    start = i + 1;
+  }
+  return filled;
+}
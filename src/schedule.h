@@ -0,0 +1,28 @@
+#ifndef C0C_SCHEDULE_H
+#define C0C_SCHEDULE_H
+
+#include "mips_isa.h"
+
+// whether a branch or jump takes effect after the instruction following
+// it, as with MARS run with delayed branching; not unless set
+void SetDelaySlots(bool on);
+bool DelaySlots();
+
+/**
+ * List scheduling of the blocks of `code`, each run of instructions up to
+ * a label, a jump or a syscall. The instructions go in their order, but
+ * for one that would read a register right after it is loaded: the first
+ * one after it that depends on nothing pending goes in between instead.
+ * Returns how many such load-use stalls were avoided.
+ */
+int ScheduleLoads(MInstList &code);
+
+/**
+ * Fills the delay slot after each branch and jump of `code`, with the
+ * last instruction before it in its block that it does not depend on and
+ * that assembles into a single word, or with a nop. Returns the slots
+ * filled, the nops put counted in `nops`.
+ */
+int FillDelaySlots(MInstList &code, int &nops);
+
+#endif  // !C0C_SCHEDULE_H
@@ -1,5 +1,6 @@
 #include "scope.h"
 #include "ast.h"
+#include "token.h"
 
 #include <cassert>
 #include <iostream>
@@ -11,7 +12,15 @@ Identifier *Scope::Find(const std::string &name)
     return ident->second;
   if (m_type == S_FILE || m_parent == nullptr)
     return 0;
-  return m_parent->Find(name);
+  auto outer = m_parent->Find(name);
+  if (outer != nullptr && m_horizon != nullptr && outer->Tok() != nullptr) {
+    auto &loc = outer->Tok()->m_loc;
+    auto &end = m_horizon->m_loc;
+    if (loc.line > end.line ||
+        (loc.line == end.line && loc.column >= end.column))
+      return 0;
+  }
+  return outer;
 }
 
 Identifier *Scope::FindInCurScope(const std::string &name)
@@ -45,6 +45,14 @@ public:
   {
     return m_retflag;
   }
+  /*
+   * Hide names of enclosing scopes declared at or after `tok`, so that a
+   * function body parsed after all headers only sees what precedes it.
+   */
+  void SetHorizon(const Token *tok)
+  {
+    m_horizon = tok;
+  }
   bool IsFuncScope() const
   {
     return m_type & ScopeType::S_FUNC;
@@ -86,6 +94,7 @@ private:
   Scope *m_parent;
   enum ScopeType m_type;
   int m_retflag;
+  const Token *m_horizon{nullptr};
 };
 
 #endif  // !C0C_SCOPE_H
@@ -0,0 +1,516 @@
+#include "ssa.h"
+#include "dataflow.h"
+#include "debug.h"
+
+#include <algorithm>
+#include <set>
+
+using BlockList = BasicBlock::BlockList;
+using Copy = std::pair<QuadAddr *, QuadAddr *>;  // dst, src
+
+static int lookup(const std::map<QuadAddr *, int> &ids, QuadAddr *qa)
+{
+  auto it = ids.find(qa);
+  return it == ids.end() ? -1 : it->second;
+}
+
+// a copy between locals; a global is live where the liveness can't tell
+static bool iscopy(const Quadruple *quad)
+{
+  return quad->m_op == QO_ASSIGN && quad->Def() && quad->m_dst->IsLocal() &&
+         quad->m_arg1->IsLocal() &&
+         quad->m_dst->IsChar() == quad->m_arg1->IsChar();
+}
+
+/**
+ * @brief Dominance frontiers by block id, walking up from the predecessors
+ *   of each join to its immediate dominator (Cooper, Harvey and Kennedy).
+ */
+static std::vector<BlockList> frontiers(FlowGraph *cfg)
+{
+  std::vector<BlockList> df(cfg->m_blocks.size());
+  for (auto bb : cfg->m_blocks) {
+    if (!bb->IsReachable() || bb->m_preds.size() < 2) {
+      continue;
+    }
+    for (auto pred : bb->m_preds) {
+      if (!pred->IsReachable()) {
+        continue;
+      }
+      for (auto runner = pred; runner != bb->m_idom;
+           runner = runner->m_idom) {
+        auto &set = df[runner->m_id];
+        if (set.empty() || set.back() != bb) {
+          set.push_back(bb);
+        }
+      }
+    }
+  }
+  return df;
+}
+
+// first quad past the label and the phis of a block
+static FuncInfo::QuadList::iterator body(BasicBlock *bb)
+{
+  auto it = bb->m_quads.begin();
+  if (bb->Label()) {
+    ++it;
+  }
+  while (it != bb->m_quads.end() && (*it)->m_op == QO_PHI) {
+    ++it;
+  }
+  return it;
+}
+
+void ToSSA(FlowGraph *cfg)
+{
+  auto func = cfg->m_func;
+  auto nblocks = cfg->m_blocks.size();
+  for (auto bb : cfg->m_blocks) {
+    if (!bb->IsReachable()) {
+      bb->m_quads.clear();
+    }
+  }
+
+  std::map<QuadAddr *, int> ids;
+  NumberLocals(cfg, ids);
+  std::vector<QuadAddr *> vars(ids.size());
+  for (auto &entry : ids) {
+    vars[entry.second] = entry.first;
+  }
+  Liveness live(cfg, ids);
+  auto df = frontiers(cfg);
+
+  // a phi wherever the definitions of a live variable meet
+  std::vector<BlockList> defsites(vars.size());
+  for (auto bb : cfg->m_blocks) {
+    for (auto quad : bb->m_quads) {
+      auto id = lookup(ids, quad->Def());
+      if (id >= 0 && (defsites[id].empty() || defsites[id].back() != bb)) {
+        defsites[id].push_back(bb);
+      }
+    }
+  }
+  for (size_t v = 0; v < vars.size(); ++v) {
+    std::vector<bool> placed(nblocks), queued(nblocks);
+    auto work = defsites[v];
+    for (auto bb : work) {
+      queued[bb->m_id] = true;
+    }
+    while (!work.empty()) {
+      auto bb = work.back();
+      work.pop_back();
+      for (auto join : df[bb->m_id]) {
+        if (placed[join->m_id] || !live.m_in[join->m_id].Test(v)) {
+          continue;
+        }
+        placed[join->m_id] = true;
+        auto phi = Quadruple::New(QO_PHI, vars[v]);
+        phi->m_phiargs.assign(join->m_preds.size(), vars[v]);
+        join->m_quads.insert(body(join), phi);
+        if (!queued[join->m_id]) {
+          queued[join->m_id] = true;
+          work.push_back(join);
+        }
+      }
+    }
+  }
+
+  // rename in dominator tree preorder, a stack of versions per variable
+  std::vector<std::vector<QuadAddr *>> stacks(vars.size());
+  for (size_t v = 0; v < vars.size(); ++v) {
+    stacks[v].push_back(vars[v]);
+  }
+  std::vector<int> versions(vars.size());
+  auto current = [&](QuadAddr *qa) {
+    auto id = lookup(ids, qa);
+    return id < 0 ? qa : stacks[id].back();
+  };
+
+  struct Visit {
+    BasicBlock *bb;
+    size_t child;
+    std::vector<int> pushed;
+  };
+  std::vector<Visit> dfs{{cfg->Entry(), 0, {}}};
+  bool enter = true;
+  while (!dfs.empty()) {
+    auto &top = dfs.back();
+    if (enter) {
+      for (auto quad : top.bb->m_quads) {
+        if (quad->m_op != QO_PHI) {
+          quad->RewriteUses(current);
+        }
+        auto id = lookup(ids, quad->Def());
+        if (id < 0) {
+          continue;
+        }
+        // a parameter arrives in the variable itself
+        if (quad->m_op != QO_PARAM) {
+          quad->m_dst =
+            QuadAddr::New(vars[id], ++versions[id], func->NewSlot(4));
+        }
+        stacks[id].push_back(quad->m_dst);
+        top.pushed.push_back(id);
+      }
+      for (auto succ : top.bb->m_succs) {
+        if (succ == cfg->Exit()) {
+          continue;
+        }
+        auto &preds = succ->m_preds;
+        auto index = std::find(preds.begin(), preds.end(), top.bb) -
+                     preds.begin();
+        for (auto quad : succ->m_quads) {
+          if (quad->m_op == QO_PHI) {
+            auto id = lookup(ids, quad->m_dst->Origin());
+            quad->m_phiargs[index] = stacks[id].back();
+          }
+        }
+      }
+    }
+    auto &kids = top.bb->m_children;
+    if (top.child < kids.size()) {
+      auto child = kids[top.child++];
+      dfs.push_back({child, 0, {}});
+      enter = true;
+      continue;
+    }
+    for (auto id : top.pushed) {
+      stacks[id].pop_back();
+    }
+    dfs.pop_back();
+    enter = false;
+  }
+}
+
+bool PropagateCopies(FlowGraph *cfg)
+{
+  std::map<QuadAddr *, QuadAddr *> copies;
+  auto find = [&copies](QuadAddr *qa) {
+    for (auto it = copies.find(qa); it != copies.end(); it = copies.find(qa)) {
+      qa = it->second;
+    }
+    return qa;
+  };
+  auto forward = [&](QuadAddr *dst, QuadAddr *src) {
+    if (copies.count(dst) || find(src) == dst) {
+      return false;
+    }
+    copies[dst] = find(src);
+    return true;
+  };
+
+  // a phi may merge one value only once the copies into it are seen through
+  for (bool again = true; again;) {
+    again = false;
+    for (auto bb : cfg->m_blocks) {
+      for (auto quad : bb->m_quads) {
+        if (iscopy(quad) && quad->m_dst->m_origin) {
+          again |= forward(quad->m_dst, quad->m_arg1);
+        }
+        else if (quad->m_op == QO_PHI) {
+          std::set<QuadAddr *> vals;
+          for (auto arg : quad->m_phiargs) {
+            if (find(arg) != quad->m_dst) {
+              vals.insert(find(arg));
+            }
+          }
+          if (vals.size() == 1) {
+            again |= forward(quad->m_dst, *vals.begin());
+          }
+        }
+      }
+    }
+  }
+  if (copies.empty()) {
+    return false;
+  }
+
+  for (auto bb : cfg->m_blocks) {
+    auto &quads = bb->m_quads;
+    quads.erase(std::remove_if(quads.begin(), quads.end(),
+                               [&copies](Quadruple *quad) {
+                                 auto def = quad->Def();
+                                 return def && copies.count(def) > 0;
+                               }),
+                quads.end());
+    for (auto quad : quads) {
+      quad->RewriteUses(find);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Copies all reading before any writing, one at a time: a copy goes
+ *   once no other one still reads what it overwrites, and a cycle is broken
+ *   through a fresh version.
+ */
+static void sequentialize(FuncInfo *func,
+                          std::vector<Copy> copies,
+                          FuncInfo::QuadList &out)
+{
+  copies.erase(std::remove_if(copies.begin(), copies.end(),
+                              [](const Copy &copy) {
+                                return copy.first == copy.second;
+                              }),
+               copies.end());
+  while (!copies.empty()) {
+    auto ready = std::find_if(copies.begin(), copies.end(),
+                              [&copies](const Copy &copy) {
+                                for (auto &other : copies) {
+                                  if (other.second == copy.first) {
+                                    return false;
+                                  }
+                                }
+                                return true;
+                              });
+    if (ready != copies.end()) {
+      out.push_back(Quadruple::New(QO_ASSIGN, ready->first, ready->second));
+      copies.erase(ready);
+      continue;
+    }
+    auto dst = copies.front().first;
+    auto tmp = QuadAddr::New(dst, 0, func->NewSlot(4));
+    out.push_back(Quadruple::New(QO_ASSIGN, tmp, dst));
+    for (auto &copy : copies) {
+      if (copy.second == dst) {
+        copy.second = tmp;
+      }
+    }
+  }
+}
+
+/**
+ * @brief The versions copied into each other share a name wherever they do
+ *   not interfere, keeping a variable's own name when it is one of them.
+ *   Two variables are never merged. Returns whether any copy went away.
+ */
+static bool coalesce(FlowGraph *cfg)
+{
+  std::map<QuadAddr *, int> ids;
+  std::vector<std::pair<int, Quadruple *>> copies;  // loop depth, copy
+  for (auto bb : cfg->m_blocks) {
+    for (auto quad : bb->m_quads) {
+      if (!iscopy(quad)) {
+        continue;
+      }
+      copies.emplace_back(cfg->LoopDepth(bb), quad);
+      for (auto qa : {quad->m_dst, quad->m_arg1}) {
+        if (!ids.count(qa)) {
+          auto id = ids.size();
+          ids[qa] = id;
+        }
+      }
+    }
+  }
+  if (copies.empty()) {
+    return false;
+  }
+  std::vector<QuadAddr *> names(ids.size());
+  for (auto &entry : ids) {
+    names[entry.second] = entry.first;
+  }
+
+  // the source of a copy does not interfere with its destination
+  Liveness live(cfg, ids);
+  std::vector<BitSet> adj(names.size(), BitSet(names.size()));
+  for (auto bb : cfg->m_blocks) {
+    live.EachQuad(bb, [&](Quadruple *quad, const BitSet &after) {
+      auto def = lookup(ids, quad->Def());
+      if (def < 0) {
+        return;
+      }
+      auto src = iscopy(quad) ? lookup(ids, quad->m_arg1) : -1;
+      after.Each([&](int id) {
+        if (id != def && id != src) {
+          adj[def].Set(id);
+          adj[id].Set(def);
+        }
+      });
+    });
+  }
+
+  std::vector<int> root(names.size());
+  std::vector<BitSet> members(names.size(), BitSet(names.size()));
+  for (size_t i = 0; i < names.size(); ++i) {
+    root[i] = i;
+    members[i].Set(i);
+  }
+  auto find = [&root](int i) {
+    while (root[i] != i) {
+      i = root[i] = root[root[i]];
+    }
+    return i;
+  };
+  // a variable, not a version, its class is named after
+  std::vector<bool> pinned(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    pinned[i] = !names[i]->m_origin;
+  }
+
+  // the copies run most often first
+  std::stable_sort(copies.begin(), copies.end(),
+                   [](const std::pair<int, Quadruple *> &a,
+                      const std::pair<int, Quadruple *> &b) {
+                     return a.first > b.first;
+                   });
+  for (auto &entry : copies) {
+    auto a = find(ids[entry.second->m_dst]);
+    auto b = find(ids[entry.second->m_arg1]);
+    if (a == b || (pinned[a] && pinned[b]) ||
+        adj[a].Intersects(members[b])) {
+      continue;
+    }
+    if (pinned[b]) {
+      std::swap(a, b);
+    }
+    root[b] = a;
+    members[a].Union(members[b]);
+    adj[a].Union(adj[b]);
+  }
+
+  auto rename = [&](QuadAddr *qa) {
+    auto id = lookup(ids, qa);
+    return id < 0 ? qa : names[find(id)];
+  };
+  bool changed = false;
+  for (auto bb : cfg->m_blocks) {
+    FuncInfo::QuadList quads;
+    for (auto quad : bb->m_quads) {
+      quad->RewriteUses(rename);
+      if (quad->Def()) {
+        quad->m_dst = rename(quad->m_dst);
+      }
+      if (quad->m_op == QO_ASSIGN && quad->m_dst == quad->m_arg1) {
+        changed = true;
+        continue;
+      }
+      quads.push_back(quad);
+    }
+    bb->m_quads.swap(quads);
+  }
+  return changed;
+}
+
+/**
+ * @brief The edges split whose copies all went away are joined again: a
+ *   branch to a block left with its label and goto only goes where the
+ *   goto does, and a goto made for the splits to the quad after it goes.
+ */
+static void unsplit(FuncInfo *func,
+                    const std::map<LabelStmt *, QuadAddr *> &splits,
+                    const std::set<Quadruple *> &gotos)
+{
+  auto &quads = func->m_quads;
+  std::map<LabelStmt *, QuadAddr *> empty;
+  FuncInfo::QuadList kept;
+  for (size_t i = 0; i < quads.size(); ++i) {
+    auto quad = quads[i];
+    if (quad->m_op == QO_LABEL && splits.count(JumpTarget(quad)) &&
+        quads[i + 1]->m_op == QO_GOTO) {
+      empty[JumpTarget(quad)] = quads[++i]->m_dst;
+      continue;
+    }
+    kept.push_back(quad);
+  }
+  quads.clear();
+  for (size_t i = 0; i < kept.size(); ++i) {
+    auto quad = kept[i];
+    if (IsCondBranch(quad->m_op) && empty.count(JumpTarget(quad))) {
+      quad->m_dst = empty[JumpTarget(quad)];
+    }
+    if (gotos.count(quad) && i + 1 < kept.size() &&
+        kept[i + 1]->m_op == QO_LABEL &&
+        JumpTarget(kept[i + 1]) == JumpTarget(quad)) {
+      continue;
+    }
+    quads.push_back(quad);
+  }
+}
+
+void FromSSA(FlowGraph *cfg)
+{
+  auto func = cfg->m_func;
+  // quads to go after the last one of a block, by id
+  std::vector<FuncInfo::QuadList> tails(cfg->m_blocks.size());
+  std::map<LabelStmt *, QuadAddr *> made;  // label of a split, its target
+  std::set<Quadruple *> gotos;
+
+  for (auto bb : cfg->m_blocks) {
+    // copies may go into the block itself, at its end
+    size_t at = bb->Label() ? 1 : 0;
+    FuncInfo::QuadList phis(bb->m_quads.begin() + at, body(bb));
+    if (phis.empty()) {
+      continue;
+    }
+    assert(bb->Label() && bb->m_id > 0);
+    auto label = bb->m_quads.front()->m_dst;
+    auto layout = cfg->m_blocks[bb->m_id - 1];
+    // copies on the edge from the block laid out before, then the blocks
+    // of the edges split
+    FuncInfo::QuadList fallsplit, splits;
+    bool falls = false;
+
+    for (size_t j = 0; j < bb->m_preds.size(); ++j) {
+      auto pred = bb->m_preds[j];
+      if (!pred->IsReachable()) {
+        continue;
+      }
+      std::vector<Copy> copies;
+      for (auto phi : phis) {
+        copies.emplace_back(phi->m_dst, phi->m_phiargs[j]);
+      }
+      auto term = pred->Terminator();
+      if (term && IsCondBranch(term->m_op) && pred->m_succs.size() == 1) {
+        // taken or not, the branch goes here
+        pred->m_quads.pop_back();
+        term = nullptr;
+      }
+      if (!term || !IsCondBranch(term->m_op)) {
+        FuncInfo::QuadList seq;
+        sequentialize(func, copies, seq);
+        auto at = term ? pred->m_quads.end() - 1 : pred->m_quads.end();
+        pred->m_quads.insert(at, seq.begin(), seq.end());
+        falls |= pred == layout && !term;
+        continue;
+      }
+
+      // a critical edge gets a block of its own
+      if (cfg->Target(term) != bb) {
+        sequentialize(func, copies, fallsplit);
+        falls = true;
+        continue;
+      }
+      auto newlabel = func->NewLabel();
+      splits.push_back(Quadruple::New(QO_LABEL, newlabel));
+      term->m_dst = newlabel;
+      made[JumpTarget(splits.back())] = label;
+      sequentialize(func, copies, splits);
+      splits.push_back(Quadruple::New(QO_GOTO, label));
+      gotos.insert(splits.back());
+    }
+
+    auto &tail = tails[layout->m_id];
+    tail.insert(tail.end(), fallsplit.begin(), fallsplit.end());
+    if (falls && !splits.empty()) {
+      tail.push_back(Quadruple::New(QO_GOTO, label));
+      gotos.insert(tail.back());
+    }
+    tail.insert(tail.end(), splits.begin(), splits.end());
+    bb->m_quads.erase(bb->m_quads.begin() + at,
+                      bb->m_quads.begin() + at + phis.size());
+  }
+
+  for (auto bb : cfg->m_blocks) {
+    auto &tail = tails[bb->m_id];
+    bb->m_quads.insert(bb->m_quads.end(), tail.begin(), tail.end());
+  }
+  // once built again, the graph shows where the copies are
+  cfg->Flatten();
+  FlowGraph lowered(func);
+  if (coalesce(&lowered)) {
+    lowered.Flatten();
+  }
+  unsplit(func, made, gotos);
+}
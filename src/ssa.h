@@ -0,0 +1,31 @@
+#ifndef C0C_SSA_H
+#define C0C_SSA_H
+
+#include "cfg.h"
+
+/*
+ * Static single assignment form of the locals and temporaries of a
+ * function (Cytron et al.). Every quad writing one writes a version of
+ * its own instead, made by QuadAddr::New(var, version, off) with a stack
+ * slot of its own; the variable itself stands for the value it has on
+ * entry, parameters included. Phis, QO_PHI quads right after the label of
+ * a block, merge the versions reaching it, one per predecessor.
+ *
+ * Array elements and globals are left as they are.
+ */
+
+// place phis where a variable is live and merges, and rename
+void ToSSA(FlowGraph *cfg);
+
+// forward the source of copies and of phis merging one value only
+bool PropagateCopies(FlowGraph *cfg);
+
+/**
+ * Replaces the phis by copies at the end of the predecessors, splitting
+ * the edges from branches, then merges the versions copied into each
+ * other wherever they do not interfere. The quads are left flattened into
+ * the function, and the graph is to be built again.
+ */
+void FromSSA(FlowGraph *cfg);
+
+#endif  // !C0C_SSA_H
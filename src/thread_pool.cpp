@@ -0,0 +1,106 @@
+#include "thread_pool.h"
+
+thread_local ThreadPool *ThreadPool::t_pool = nullptr;
+thread_local unsigned ThreadPool::t_index = 0;
+
+ThreadPool::ThreadPool(unsigned jobs)
+{
+  for (unsigned i = 0; i < jobs; ++i) {
+    m_queues.emplace_back(new Queue);
+  }
+  for (unsigned i = 0; i < jobs; ++i) {
+    m_workers.emplace_back(&ThreadPool::Work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_ready.notify_all();
+  for (auto &worker : m_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Submit(Task task)
+{
+  unsigned index;
+  if (t_pool == this) {
+    index = t_index;
+  }
+  else {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    index = m_next++ % m_queues.size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+    m_queues[index]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_queued;
+    ++m_pending;
+  }
+  m_ready.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this] { return m_pending == 0; });
+}
+
+/**
+ * @brief Take a task already claimed by worker `index`:
+ *   the newest one of its own queue, else the oldest one of another.
+ */
+ThreadPool::Task ThreadPool::Take(unsigned index)
+{
+  auto n = m_queues.size();
+  for (;;) {
+    for (size_t i = 0; i < n; ++i) {
+      auto &queue = *m_queues[(index + i) % n];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty()) {
+        continue;
+      }
+      Task task;
+      if (i == 0) {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      }
+      else {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+      return task;
+    }
+    // others took the tasks seen, while new ones went behind us; retry
+    std::this_thread::yield();
+  }
+}
+
+void ThreadPool::Work(unsigned index)
+{
+  t_pool = this;
+  t_index = index;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_ready.wait(lock, [this] { return m_stop || m_queued > 0; });
+      if (m_queued == 0) {
+        return;  // stopping
+      }
+      --m_queued;
+    }
+    Take(index)();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_pending == 0) {
+      m_idle.notify_all();
+    }
+  }
+}
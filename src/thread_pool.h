@@ -0,0 +1,55 @@
+#ifndef C0C_THREAD_POOL_H
+#define C0C_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads running submitted tasks.
+ *
+ * Every worker owns a deque: tasks submitted by a worker go to its own
+ * deque and are taken back LIFO, an idle worker steals the oldest task
+ * of another one. Tasks submitted from outside are dealt round-robin.
+ */
+class ThreadPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit ThreadPool(unsigned jobs);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &other) = delete;
+  ThreadPool &operator=(const ThreadPool &other) = delete;
+
+  void Submit(Task task);
+  // block until every submitted task has finished
+  void Wait();
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void Work(unsigned index);
+  Task Take(unsigned index);
+
+  std::vector<std::thread> m_workers;
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::mutex m_mutex;
+  std::condition_variable m_ready;  // task queued, or stopping
+  std::condition_variable m_idle;   // no task pending any more
+  size_t m_queued{0};   // tasks sitting in the queues, not yet claimed
+  size_t m_pending{0};  // tasks not finished yet
+  unsigned m_next{0};   // queue for the next task from outside
+  bool m_stop{false};
+
+  static thread_local ThreadPool *t_pool;  // pool of the current worker
+  static thread_local unsigned t_index;    // its queue
+};
+
+#endif  // !C0C_THREAD_POOL_H
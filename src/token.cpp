@@ -1,4 +1,5 @@
 #include "token.h"
+#include "error.h"
 #include "lexer.h"
 #include "memory_pool.h"
 
@@ -150,12 +151,60 @@ void Token::Delete()
  */
 Token *TokenStream::At(size_t offset)
 {
-  auto it = begin() + offset;
+  while (m_td->size() <= offset) {
+    m_td->push_back(Next());
+  }
+  return (*m_td)[offset];
+}
+
+/**
+ * @brief Take all tokens left in the stream at once.
+ * @param lex_errors if given, receives the lexer errors of each token
+ *   lexed here instead of them being reported.
+ * @return remaining tokens, the trailing EOFTK included.
+ */
+TokenList TokenStream::Drain(ErrorBufferList *lex_errors)
+{
+  TokenList tokens(m_td->begin(), m_td->end());
+  m_td->clear();
+  if (lex_errors) {
+    lex_errors->resize(tokens.size());
+  }
+  while (tokens.empty() || tokens.back()->m_type != EOFTK) {
+    if (lex_errors) {
+      lex_errors->emplace_back();
+      SetErrorBuffer(&lex_errors->back());
+    }
+    tokens.push_back(Next());
+  }
+  if (lex_errors) {
+    SetErrorBuffer(nullptr);
+  }
+  return tokens;
+}
 
-  while (it == end()) {
-    m_td->push_back(m_lexer->GetToken());
+/**
+ * Pull one more token from the lexer, or from the replayed token range.
+ * A replayed range ends with an EOFTK located at its last token.
+ */
+Token *TokenStream::Next()
+{
+  if (m_lexer) {
+    return m_lexer->GetToken();
+  }
+  if (m_pos < m_end) {
+    if (m_lex_errors) {
+      ReplayErrors((*m_lex_errors)[m_pos]);
+    }
+    return (*m_tokens)[m_pos++];
   }
-  return *it;
+  if (m_eof == nullptr) {
+    m_eof = Token::New(EOFTK);
+    if (m_end > 0) {
+      m_eof->m_loc = (*m_tokens)[m_end - 1]->m_loc;
+    }
+  }
+  return m_eof;
 }
 
 /**
@@ -168,7 +217,9 @@ Token *TokenStream::PrintFront()
     return nullptr;
   }
 #ifdef PRINT_OUTPUT
-  outstream << *At(0);
+  if (m_echo) {
+    outstream << *At(0);
+  }
 #endif  // PRINT_OUTPUT
   return FlushFront();
 }
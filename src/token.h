@@ -6,6 +6,7 @@
 #include <deque>
 #include <fstream>
 #include <unordered_map>
+#include <vector>
 
 extern const char *tokenlist[];
 
@@ -178,7 +179,11 @@ public:
   static const TokenMap m_kwtab;
 };
 
+using TokenList = std::vector<Token *>;
+
 class Lexer;
+struct ErrorBuffer;
+using ErrorBufferList = std::vector<ErrorBuffer>;
 class TokenStream {
   using TokenDeque = std::deque<Token *>;
   using reference = Token *&;
@@ -190,6 +195,22 @@ class TokenStream {
 public:
   TokenStream(Lexer *lexer) : m_lexer(lexer), m_td(new TokenDeque()) {}
 
+  /**
+   * Replay tokens [begin, end) of an already lexed `tokens`, followed by
+   * an EOFTK sentinel (used when parsing a single function on its own).
+   * The lexer errors of a token, if given, are reported again as it is
+   * pulled, so that they are muted as they would have been then.
+   */
+  TokenStream(const TokenList *tokens,
+              size_t begin,
+              size_t end,
+              const ErrorBufferList *lex_errors = nullptr)
+    : m_lexer(nullptr), m_td(new TokenDeque()), m_tokens(tokens),
+      m_pos(begin), m_end(end), m_lex_errors(lex_errors)
+  {
+    m_prev = begin > 0 ? (*tokens)[begin - 1] : nullptr;
+  }
+
   ~TokenStream() {}
 
   Token *At(size_t offset);
@@ -221,6 +242,12 @@ public:
 
   Token *PrintFront();
   Token *FlushFront();
+  TokenList Drain(ErrorBufferList *lex_errors = nullptr);
+
+  void SetEcho(bool echo)
+  {
+    m_echo = echo;
+  }
 
   Token *prev() const noexcept
   {
@@ -255,6 +282,8 @@ public:
   Token *operator=(TokenStream &ts) = delete;
 
 private:
+  Token *Next();
+
   void pop_front()
   {
     m_prev = At(0);
@@ -269,6 +298,16 @@ private:
 
   // encapsulated token queue pointer
   TokenDeque *m_td;
+
+  // pre-lexed token provider, used when `m_lexer` is null
+  const TokenList *m_tokens{nullptr};
+  size_t m_pos{0};
+  size_t m_end{0};
+  Token *m_eof{nullptr};
+  const ErrorBufferList *m_lex_errors{nullptr};  // one per token
+
+  // echo tokens to `outstream` as they are printed
+  bool m_echo{true};
 };
 
 #endif  // !C0C_TOKEN_H
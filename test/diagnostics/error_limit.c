@@ -0,0 +1,9 @@
+int g;
+
+void main()
+{
+  g = a;
+  g = b;
+  g = c;
+  g = d;
+}
@@ -0,0 +1,7 @@
+void main()
+{
+  char c;
+  c = 'a';
+  printf("\\tab", zz);
+  c = 1 +;
+}
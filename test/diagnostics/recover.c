@@ -0,0 +1,19 @@
+int g;
+
+void main()
+{
+  int a, b[3];
+  a = 1
+  a = zz;
+  g = 2
+  scanf(yy);
+  printf(a + 1 < 5);
+  a = xx;
+  if (a < 1 {
+    a = ww;
+  }
+  b[1 = 2;
+  a = vv;
+  a = (1 + 2;
+  scanf(uu);
+}
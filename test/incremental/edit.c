@@ -0,0 +1,14 @@
+int g;
+
+int f(int a)
+{
+  int x;
+  x = a + 1;
+  return (x);
+}
+
+void main()
+{
+  g = f(2);
+  printf(g);
+}
@@ -0,0 +1,44 @@
+int grade(int s)
+{
+  if (s >= 90)
+    return (4);
+  else if (s >= 80)
+    return (3);
+  else if (s >= 70)
+    return (2);
+  else if (s >= 60)
+    return (1);
+  return (0);
+}
+
+void main()
+{
+  int i, j, n, s;
+  s = 0;
+  for (i = 0; i < 100; i = i + 7)
+    s = s + grade(i);
+  printf("grades ", s);
+  n = 0;
+  i = 0;
+  while (i < 6) {
+    j = 0;
+    while (j < i) {
+      if (j == 2) {
+        n = n + 10;
+      }
+      else {
+        if (j == 4)
+          n = n - 1;
+        else
+          n = n + 1;
+      }
+      j = j + 1;
+    }
+    i = i + 1;
+  }
+  printf("n ", n);
+  do
+    n = n - 9;
+  while (n > 0);
+  printf("n ", n);
+}
@@ -0,0 +1,59 @@
+int g1;
+
+void h(int x)
+{
+  int i;
+  i = 0;
+  while (i < x) {
+    printf("x ", i);
+    printf("x + g1 ", i + g1);
+    printf("x - g1 ", i - g1);
+    printf("x * g1 ", i * g1);
+    i = i + 1;
+  }
+  i = 0;
+  while (i < x) {
+    printf("x / 2 ", i / 2);
+    printf("x / 3 ", i / 3);
+    printf("g1 / 4 ", g1 / 4);
+    i = i + 1;
+  }
+  i = 0;
+  while (i < x) {
+    printf("x % 2 ", i - i / 2 * 2);
+    printf("x % 3 ", i - i / 3 * 3);
+    printf("x * x ", i * i);
+    printf("x + 7 ", i + 7);
+    printf("x - 7 ", i - 7);
+    printf("g1 * 3 ", g1 * 3);
+    printf("g1 + x ", g1 + i);
+    printf("g1 - x ", g1 - i);
+    i = i + 1;
+  }
+  printf("h ", g1);
+}
+
+void f(int a)
+{
+  int i;
+  if (a > 100) {
+    printf("big ", a);
+    printf(a * 2);
+    printf(a * 3);
+    printf(a * 4);
+  }
+  i = 0;
+  while (i < 3) {
+    printf(a * i);
+    h(a - 6);
+    g1 = a * i;
+    i = i + 1;
+  }
+}
+
+void main()
+{
+  g1 = 5;
+  f(6);
+  printf("g1 ", g1);
+}
@@ -0,0 +1,43 @@
+const int N = 10, ZERO = 0;
+int g;
+
+int f(int x)
+{
+  int a, b, c, dead;
+  a = 6;
+  b = a * 7;
+  if (b == 42)
+    c = b / 2;
+  else
+    c = x / ZERO;
+  dead = x * 1000;
+  while (0)
+    printf("never");
+  if (a > 100) {
+    printf("unreachable ", x / ZERO);
+  }
+  return (c + x);
+}
+
+void main()
+{
+  int i, k, s;
+  k = N / 2;
+  s = 0;
+  for (i = 0; i < k; i = i + 1) {
+    if (k == 5)
+      s = s + f(i);
+    else
+      s = s - 1;
+  }
+  printf("s ", s);
+  g = -2147483647 - 1;
+  printf("min ", g);
+  printf("wrap ", (2147483647 + 0) / -1);
+  i = 3;
+  i = i * i * i - 27;
+  if (i)
+    printf("i nonzero");
+  else
+    printf("i zero");
+}
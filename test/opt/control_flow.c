@@ -0,0 +1,56 @@
+int sign(int x)
+{
+  if (x > 0)
+    return (1);
+  if (x < 0)
+    return (-1);
+  return (0);
+}
+
+int collatz(int n)
+{
+  int steps;
+  steps = 0;
+  while (n != 1) {
+    if (n - n / 2 * 2 == 0)
+      n = n / 2;
+    else
+      n = 3 * n + 1;
+    steps = steps + 1;
+  }
+  return (steps);
+}
+
+void grid(int n)
+{
+  int i, j;
+  for (i = 0; i < n; i = i + 1) {
+    j = n;
+    do {
+      if (i == j)
+        printf("*");
+      else
+        printf(".");
+      j = j - 1;
+    } while (j > 0);
+    printf("|");
+  }
+}
+
+void main()
+{
+  int k;
+  printf("sign ", sign(-7));
+  printf("sign ", sign(0));
+  printf("sign ", sign(42));
+  for (k = 1; k <= 9; k = k + 4)
+    printf("collatz ", collatz(k));
+  grid(4);
+  k = 0;
+  while (k < 100) {
+    k = k + 7;
+    if (k > 50)
+      if (k < 60)
+        printf("k ", k);
+  }
+}
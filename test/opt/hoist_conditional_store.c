@@ -0,0 +1,41 @@
+const int K1 = 3;
+int g1, g2;
+
+void f(int p0)
+{
+  int i, l0, t;
+  l0 = 1;
+  i = 0;
+  while (i < 2) {
+    if (l0 < K1) {
+      printf("taken ", i);
+    }
+    else {
+      g1 = -p0 / 9 * 1;
+    }
+    i = i + 1;
+  }
+  i = 0;
+  while (i < 3) {
+    if (l0 < K1) {
+      t = i;
+    }
+    else {
+      t = p0;
+    }
+    if (i == p0) {
+      g2 = p0 * 7;
+    }
+    i = i + 1;
+  }
+}
+
+void main()
+{
+  g2 = 4;
+  f(20);
+  printf("g1 ", g1);
+  printf("g2 ", g2);
+  f(2);
+  printf("g2 ", g2);
+}
@@ -0,0 +1,33 @@
+const int BIG = 100000, NEG = -40000, EDGE = 32767, LOW = -32768;
+int g;
+
+void main()
+{
+  int a, b;
+  a = 5;
+  printf(a + 32767);
+  printf(a + 32768);
+  printf(a - 32768);
+  printf(a - 32769);
+  printf(a + BIG);
+  printf(a + NEG);
+  printf(a * 65536);
+  printf(a * EDGE);
+  printf(a + LOW);
+  b = 65535;
+  printf(b);
+  b = 65536;
+  printf(b);
+  b = -65536;
+  printf(b);
+  g = 2147483647;
+  printf(g);
+  if (a < 40000)
+    printf("lt big");
+  if (a > -40000)
+    printf("gt neg");
+  if (a < 32767)
+    printf("lt edge");
+  if (a >= -32768)
+    printf("ge low");
+}
@@ -0,0 +1,54 @@
+int g;
+
+int sq(int x)
+{
+  return (x * x);
+}
+
+int add3(int a, int b, int c)
+{
+  return (a + b + c);
+}
+
+void tick()
+{
+  g = g + 1;
+}
+
+int fact(int n)
+{
+  if (n <= 1)
+    return (1);
+  return (n * fact(n - 1));
+}
+
+int twice(int x)
+{
+  tick();
+  return (add3(x, x, 0));
+}
+
+int upper(char c)
+{
+  if (c - 'a' >= 0)
+    if ('z' - c >= 0)
+      return (c - 'a' + 'A');
+  return (c + 0);
+}
+
+void main()
+{
+  int i, s;
+  s = 0;
+  for (i = 0; i < 5; i = i + 1) {
+    s = s + sq(i) + twice(i);
+    tick();
+  }
+  printf("s ", s);
+  printf("g ", g);
+  printf("fact ", fact(10));
+  printf("nested ", sq(sq(add3(1, sq(1), 0))));
+  printf(upper('q'));
+  printf(upper('Q'));
+  printf(upper('_'));
+}
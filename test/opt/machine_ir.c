@@ -0,0 +1,35 @@
+char word[8];
+int vals[8];
+
+int classify(char ch)
+{
+  if (ch - '_' == 0)
+    return (0);
+  if (ch - '0' >= 0)
+    if ('9' - ch >= 0)
+      return (1);
+  return (2);
+}
+
+void main()
+{
+  int n, i, kinds;
+  char ch;
+  scanf(n, ch);
+  kinds = 0;
+  for (i = 0; i < 8; i = i + 1) {
+    if (i - i / 2 * 2 == 0)
+      word[i] = ch;
+    else if (i == 3)
+      word[i] = '_';
+    else
+      word[i] = '7';
+    vals[i] = n * i - i * i;
+    kinds = kinds * 3 + classify(word[i]);
+  }
+  for (i = 7; i >= 0; i = i - 1)
+    printf(word[i]);
+  printf(" kinds ", kinds);
+  printf("vals ", vals[3] + vals[7] - vals[0]);
+  printf("sum ", -n * 2 + n - (-n) + (+n));
+}
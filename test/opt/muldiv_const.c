@@ -0,0 +1,32 @@
+void show(int x)
+{
+  printf(x / 2);
+  printf(x / -2);
+  printf(x / 3);
+  printf(x / 7);
+  printf(x / -9);
+  printf(x / 16);
+  printf(x / 1000);
+  printf(x * 8);
+  printf(x * 10);
+  printf(x * -3);
+  printf(x * 255);
+  printf(x - x / 10 * 10);
+  printf(x / 1);
+  printf(x / -1);
+}
+
+void main()
+{
+  show(0);
+  show(1);
+  show(-1);
+  show(7);
+  show(-7);
+  show(123457);
+  show(-123457);
+  show(2147483);
+  printf((-2147483647 - 1) / 2);
+  printf((-2147483647 - 1) / 16);
+  printf((-2147483647 - 1) / 7);
+}
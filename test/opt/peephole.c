@@ -0,0 +1,32 @@
+int g, h;
+char c;
+
+void main()
+{
+  int a, b, i;
+  g = 5;
+  h = g;
+  g = h;
+  a = g + 0;
+  b = a * 1;
+  b = b - 0;
+  a = b;
+  b = a;
+  c = 'x';
+  printf(c);
+  i = 0;
+  while (i < 3) {
+    g = g + i;
+    h = g;
+    i = i + 1;
+  }
+  printf("a ", a);
+  printf("b ", b);
+  printf("g ", g);
+  printf("h ", h);
+  a = -a;
+  a = -a;
+  printf("neg ", a);
+  a = 0 - b + b;
+  printf("zero ", a);
+}
@@ -0,0 +1,20 @@
+char c;
+
+void main()
+{
+  int i;
+  c = 'k';
+  printf("a");
+  printf("b");
+  printf("c ", 1);
+  printf(" d");
+  printf(c);
+  printf(c);
+  printf('z');
+  for (i = 0; i < 3; i = i + 1) {
+    printf("[");
+    printf(i);
+    printf("]");
+  }
+  printf("end");
+}
@@ -0,0 +1,31 @@
+int wsum(int a, int b, int c, int d, int e, int f)
+{
+  return (a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f);
+}
+
+char pick(int i, char x, char y, char z)
+{
+  if (i == 0)
+    return (x);
+  if (i == 1)
+    return (y);
+  return (z);
+}
+
+int rotate(int a, int b, int c, int d, int n)
+{
+  if (n == 0)
+    return (a * 1000 + b * 100 + c * 10 + d);
+  return (rotate(b, c, d, a, n - 1));
+}
+
+void main()
+{
+  int i;
+  printf("wsum ", wsum(1, 2, 3, 4, 5, 6));
+  printf("nested ", wsum(wsum(1, 1, 1, 1, 1, 1), 2, wsum(0, 0, 0, 0, 0, 1), 4,
+                         rotate(1, 2, 3, 4, 1), 6));
+  for (i = 0; i < 3; i = i + 1)
+    printf(pick(i, 'x', 'y', 'z'));
+  printf(" rotate ", rotate(1, 2, 3, 4, 6));
+}
@@ -0,0 +1,60 @@
+int g;
+
+int mix(int a, int b, int c)
+{
+  int v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11;
+  v0 = a + 1;
+  v1 = b + 2;
+  v2 = c + 3;
+  v3 = v0 + v1 * 2;
+  v4 = v1 + v2 * 3;
+  v5 = v2 + v0 * 4;
+  v6 = v3 - v4;
+  v7 = v4 - v5;
+  v8 = v5 - v3;
+  v9 = a * 5 + v6;
+  v10 = b * 6 + v7;
+  v11 = c * 7 + v8;
+  g = g + 1;
+  return ((v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 +
+           v0 - v11 + v1 - v10 + v2 - v9 + v3 - v8 + v4 - v7 + v5 - v6) /
+          8);
+}
+
+void main()
+{
+  int i, s0, s1, s2, s3, s4, s5, s6, s7, s8, s9;
+  s0 = 1;
+  s1 = 2;
+  s2 = 3;
+  s3 = 4;
+  s4 = 5;
+  s5 = 6;
+  s6 = 7;
+  s7 = 8;
+  s8 = 9;
+  s9 = 10;
+  for (i = 0; i < 5; i = i + 1) {
+    s0 = s0 + mix(s1, s2, i);
+    s1 = s1 + s9 - s8;
+    s2 = s2 + 2 - s7;
+    s3 = s3 + s0 - s6;
+    s4 = s4 - s3 + s5;
+    s5 = s5 + mix(s4, i, s6);
+    s6 = s6 + s2;
+    s7 = s7 - s1;
+    s8 = s8 + s0 / 7;
+    s9 = s9 + i;
+  }
+  printf("s0 ", s0);
+  printf("s1 ", s1);
+  printf("s2 ", s2);
+  printf("s3 ", s3);
+  printf("s4 ", s4);
+  printf("s5 ", s5);
+  printf("s6 ", s6);
+  printf("s7 ", s7);
+  printf("s8 ", s8);
+  printf("s9 ", s9);
+  printf("g ", g);
+}
@@ -0,0 +1,36 @@
+int a[16], g;
+
+int dot(int n)
+{
+  int i, s;
+  s = 0;
+  for (i = 0; i < n; i = i + 1)
+    s = s + a[i] * a[n - 1 - i];
+  return (s);
+}
+
+int pick(int x)
+{
+  if (x > 3)
+    return (g + x);
+  return (g - x);
+}
+
+void main()
+{
+  int i;
+  g = 100;
+  for (i = 0; i < 16; i = i + 1)
+    a[i] = i * 3 - 7;
+  printf("dot ", dot(16));
+  printf("pick ", pick(2) + pick(5));
+  i = 0;
+  do {
+    g = a[i] + g;
+    i = i + 5;
+  } while (i < 16);
+  printf("g ", g);
+  if (a[2] < a[3])
+    if (a[4] > a[1])
+      printf("ordered");
+}
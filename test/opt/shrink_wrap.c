@@ -0,0 +1,35 @@
+int g;
+
+int work(int n)
+{
+  int a, b, c, d;
+  if (n < 0)
+    return (0);
+  a = n + 1;
+  b = a * 2;
+  c = g;
+  g = g + 1;
+  d = work(n - 1);
+  return (a + b + c + d);
+}
+
+void maybe(int n)
+{
+  int i, s;
+  if (n == 0)
+    return;
+  s = 0;
+  for (i = 0; i < n; i = i + 1)
+    s = s + work(i);
+  printf("maybe ", s);
+}
+
+void main()
+{
+  g = 1;
+  printf("work ", work(-1));
+  printf("work ", work(3));
+  maybe(0);
+  maybe(3);
+  printf("g ", g);
+}
@@ -0,0 +1,37 @@
+int sum(int n)
+{
+  int first[10], second[10], i, s;
+  s = 0;
+  for (i = 0; i < 10; i = i + 1)
+    first[i] = i * n;
+  for (i = 0; i < 10; i = i + 1)
+    s = s + first[i];
+  for (i = 0; i < 10; i = i + 1)
+    second[i] = s - i;
+  for (i = 0; i < 10; i = i + 1)
+    s = s + second[i];
+  return (s);
+}
+
+int depth(int n)
+{
+  int a, b, c, d, e, f, g, h;
+  a = n;
+  b = a + 1;
+  c = b + 1;
+  d = c + 1;
+  if (n > 0)
+    e = depth(n - 1);
+  else
+    e = 0;
+  f = e + a;
+  g = f + b;
+  h = g + c + d;
+  return (h);
+}
+
+void main()
+{
+  printf("sum ", sum(3));
+  printf("depth ", depth(5));
+}
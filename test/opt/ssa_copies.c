@@ -0,0 +1,52 @@
+void swaps(int n)
+{
+  int a, b, c, t;
+  a = 1;
+  b = 2;
+  c = 3;
+  while (n > 0) {
+    t = a;
+    a = b;
+    b = c;
+    c = t;
+    n = n - 1;
+  }
+  printf("a ", a);
+  printf("b ", b);
+  printf("c ", c);
+}
+
+int fib(int n)
+{
+  int x, y, z, i;
+  x = 0;
+  y = 1;
+  for (i = 0; i < n; i = i + 1) {
+    z = x + y;
+    x = y;
+    y = z;
+  }
+  return (x);
+}
+
+int lost(int n)
+{
+  int x, y;
+  x = 0;
+  y = 0;
+  while (n > 0) {
+    y = x;
+    x = x + n;
+    n = n - 1;
+  }
+  return (y * 100 + x);
+}
+
+void main()
+{
+  swaps(0);
+  swaps(1);
+  swaps(5);
+  printf("fib ", fib(20));
+  printf("lost ", lost(4));
+}
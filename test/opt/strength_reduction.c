@@ -0,0 +1,31 @@
+int tab[50];
+
+void main()
+{
+  int i, j, n, k, s;
+  n = 7;
+  k = 3;
+  for (i = 0; i < 50; i = i + 1)
+    tab[i] = i * k + n * n;
+  s = 0;
+  i = 0;
+  while (i < 10) {
+    s = s + tab[i * 4 + 2] - i * 6;
+    i = i + 1;
+  }
+  printf("s ", s);
+  for (i = 9; i >= 0; i = i - 3) {
+    j = 0;
+    while (j < 3) {
+      tab[i * 5 + j] = n * k + i * 5 + j;
+      j = j + 1;
+    }
+  }
+  printf("tab0 ", tab[0]);
+  printf("tab31 ", tab[31]);
+  printf("tab47 ", tab[47]);
+  s = 0;
+  for (i = 0; i < 8; i = i + 1)
+    s = s + (i + 1) * (i + 1) * 2;
+  printf("squares ", s);
+}
@@ -0,0 +1,19 @@
+void hello(int n)
+{
+  printf("hello ", n);
+  printf("shared");
+}
+
+void main()
+{
+  int i;
+  for (i = 0; i < 2; i = i + 1) {
+    hello(i);
+    printf("shared");
+    printf("hello ", -i);
+  }
+  printf("");
+  printf("tab and space");
+  printf("hello");
+  printf("lo ", 1);
+}
@@ -0,0 +1,37 @@
+int gcd(int a, int b)
+{
+  if (b == 0)
+    return (a);
+  return (gcd(b, a - a / b * b));
+}
+
+int count(int n, int acc)
+{
+  if (n == 0)
+    return (acc);
+  return (count(n - 1, acc + 1));
+}
+
+void down(int n)
+{
+  if (n > 0) {
+    if (n - n / 1000 * 1000 == 0)
+      printf("down ", n);
+    down(n - 1);
+  }
+}
+
+int sum(int a, int b, int c, int d, int e)
+{
+  if (e == 0)
+    return (a + b + c + d);
+  return (sum(b, c, d, a + e, e - 1));
+}
+
+void main()
+{
+  printf("gcd ", gcd(1071, 462));
+  printf("count ", count(200000, 0));
+  down(3000);
+  printf("sum ", sum(1, 2, 3, 4, 10));
+}
@@ -0,0 +1,26 @@
+int g;
+
+int inc(int x)
+{
+  g = g + x;
+  return (x + 1);
+}
+
+int poly(int x)
+{
+  return ((x + 1) * (x + 2) - (x + 3) * (x - 4) + (x - 5) * 2 - (x + 6) / 3);
+}
+
+void main()
+{
+  int a[4], i;
+  g = 0;
+  for (i = 0; i < 4; i = i + 1)
+    a[i] = poly(i) - inc(i) * (inc(i + 1) + g);
+  printf("a0 ", a[0]);
+  printf("a1 ", a[1]);
+  printf("a2 ", a[2]);
+  printf("a3 ", a[3]);
+  printf("nested ", inc(inc(inc(1) + g) * 2) - g + poly(g - 9));
+  printf("g ", g);
+}
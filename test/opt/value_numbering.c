@@ -0,0 +1,41 @@
+int g, arr[4];
+
+void bump()
+{
+  g = g + 1;
+  arr[1] = arr[1] + 10;
+}
+
+void main()
+{
+  int a, b, i, x, y, z, w;
+  a = 7;
+  b = 9;
+  g = 3;
+  arr[1] = 5;
+  i = 1;
+  x = a * b + g;
+  y = a * b + g;
+  printf("x ", x);
+  printf("y ", y);
+  g = g + 1;
+  z = a * b + g;
+  printf("z ", z);
+  x = arr[i] * 2;
+  arr[i] = 100;
+  y = arr[i] * 2;
+  printf("x ", x);
+  printf("y ", y);
+  x = arr[1] + g;
+  bump();
+  y = arr[1] + g;
+  printf("x ", x);
+  printf("y ", y);
+  if (a > b)
+    w = a - b;
+  else
+    w = b - a;
+  z = a - b;
+  printf("w ", w);
+  printf("z ", z + (b - a));
+}
@@ -0,0 +1,15 @@
+int sq(int a
+{
+  return (a * a);
+}
+
+int twice(int a)
+{
+  return (a + a);
+}
+
+void main()
+{
+  printf(sq(3));
+  printf(twice(zz));
+}
@@ -0,0 +1,10 @@
+int sq(int a)
+{
+  return (a * a);
+}
+
+void main()
+{
+  if (sq(2) > 3) {
+  printf(sq(3));
+}
@@ -0,0 +1,98 @@
+# Run one regression program, see CMakeLists.txt in this directory.
+#   cmake -DC0C=<c0c> -DSOURCE=<name>.c -DWORK=<dir> [-DFLAGS=<flags>]
+#         [-DMODE=parallel|session] [-DSIMULATOR=<command>] -P run_test.cmake
+
+get_filename_component(dir ${SOURCE} DIRECTORY)
+get_filename_component(name ${SOURCE} NAME_WE)
+set(base ${dir}/${name})
+separate_arguments(FLAGS)
+separate_arguments(SIMULATOR)
+
+set(input /dev/null)
+if(EXISTS ${base}.in)
+  set(input ${base}.in)
+endif()
+
+# c0c in a directory of its own, on a copy of the source so that the
+# diagnostics name the file the same way wherever the tree is
+function(compile work)
+  file(REMOVE_RECURSE ${work})
+  file(MAKE_DIRECTORY ${work})
+  configure_file(${SOURCE} ${work}/${name}.c COPYONLY)
+  execute_process(COMMAND ${C0C} -c ${name}.c -o out.txt ${ARGN}
+                  WORKING_DIRECTORY ${work}
+                  INPUT_FILE ${input}
+                  OUTPUT_FILE ${work}/stdout.txt
+                  ERROR_FILE ${work}/stderr.txt
+                  RESULT_VARIABLE rc)
+  if(NOT rc EQUAL 0)
+    message(FATAL_ERROR "c0c ${ARGN} exited with ${rc}")
+  endif()
+endfunction()
+
+function(expect file expected)
+  file(READ ${file} got)
+  file(READ ${expected} want)
+  if(NOT got STREQUAL want)
+    message(FATAL_ERROR "${file} differs from ${expected}:\n${got}")
+  endif()
+endfunction()
+
+function(expect_same a b)
+  file(READ ${a} got_a)
+  file(READ ${b} got_b)
+  if(NOT got_a STREQUAL got_b)
+    message(FATAL_ERROR "${a} differs from ${b}")
+  endif()
+endfunction()
+
+function(expect_empty file)
+  file(READ ${file} got)
+  if(NOT got STREQUAL "")
+    message(FATAL_ERROR "${file} is not empty:\n${got}")
+  endif()
+endfunction()
+
+if(MODE STREQUAL "session")
+  compile(${WORK} -i ${FLAGS})
+  expect(${WORK}/stdout.txt ${base}.out)
+  if(EXISTS ${base}.stderr)
+    expect(${WORK}/stderr.txt ${base}.stderr)
+  else()
+    expect_empty(${WORK}/stderr.txt)
+  endif()
+  return()
+endif()
+
+compile(${WORK} ${FLAGS})
+if(EXISTS ${base}.stderr)
+  expect(${WORK}/stderr.txt ${base}.stderr)
+endif()
+if(EXISTS ${base}.errors)
+  expect(${WORK}/error.txt ${base}.errors)
+endif()
+if(NOT EXISTS ${base}.stderr AND NOT EXISTS ${base}.errors)
+  expect_empty(${WORK}/stderr.txt)
+  expect_empty(${WORK}/error.txt)
+endif()
+
+if(MODE STREQUAL "parallel")
+  compile(${WORK}/j4 -j 4 ${FLAGS})
+  foreach(file stderr.txt error.txt quads.txt mips.txt)
+    if(EXISTS ${WORK}/${file})
+      expect_same(${WORK}/j4/${file} ${WORK}/${file})
+    endif()
+  endforeach()
+endif()
+
+if(EXISTS ${base}.out AND SIMULATOR)
+  execute_process(COMMAND ${SIMULATOR} mips.txt
+                  WORKING_DIRECTORY ${WORK}
+                  INPUT_FILE ${input}
+                  OUTPUT_FILE ${WORK}/run.txt
+                  RESULT_VARIABLE rc)
+  if(NOT rc EQUAL 0)
+    message(FATAL_ERROR "${SIMULATOR} exited with ${rc}")
+  endif()
+  expect(${WORK}/run.txt ${base}.out)
+endif()